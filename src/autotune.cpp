@@ -0,0 +1,178 @@
+//
+// Block size autotuning: find the block size with the best encoding speed for the given data+parity blocks,
+// checking sizes around the points where the library working set fits into L2 and L3 caches
+//
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include "common.h"
+
+
+// Cache sizes of the first CPU core
+struct CacheSizes
+{
+    uint64_t L1, L2, L3;
+};
+
+
+// Read data/unified cache sizes from sysfs, use typical values for unknown ones
+static CacheSizes read_cache_sizes()
+{
+    CacheSizes caches = {0, 0, 0};
+#ifdef __linux__
+    for (int index = 0; ; ++index)
+    {
+        char path[128], type[32] = "";
+        int level = 0;
+        unsigned long long size = 0;
+        char unit = 0;
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/level", index);
+        FILE* f = fopen(path, "r");
+        if (! f)
+            break;
+        if (fscanf(f, "%d", &level) != 1)
+            level = 0;
+        fclose(f);
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/type", index);
+        if ((f = fopen(path, "r"))) {
+            if (fscanf(f, "%31s", type) != 1)
+                type[0] = 0;
+            fclose(f);
+        }
+        if (strcmp(type, "Instruction") == 0)
+            continue;
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", index);
+        if ((f = fopen(path, "r"))) {
+            if (fscanf(f, "%llu%c", &size, &unit) < 1)
+                size = 0;
+            fclose(f);
+        }
+        if (unit == 'K')  size <<= 10;
+        if (unit == 'M')  size <<= 20;
+
+        if (level == 1)  caches.L1 = size;
+        if (level == 2)  caches.L2 = size;
+        if (level == 3)  caches.L3 = size;
+    }
+#endif
+    if (! caches.L1)  caches.L1 = 32 << 10;
+    if (! caches.L2)  caches.L2 = 256 << 10;
+    if (! caches.L3)  caches.L3 = std::max<uint64_t>(caches.L2, 8 << 20);
+    return caches;
+}
+
+
+// Largest block size (multiple of 64 bytes) whose working set fits into the given cache size, or 0 if none
+static int largest_block_fitting(ECC_bench_params params, size_t (*encode_working_set)(ECC_bench_params), uint64_t cache_size)
+{
+    // Working set grows monotonically with the block size, so binary search works
+    int lo = 0, hi = int(std::min<uint64_t>(cache_size / 64 + 1, 1 << 24));   // in units of 64 bytes
+    while (hi - lo > 1) {
+        int middle = (lo + hi) / 2;
+        params.BlockBytes = middle * 64;
+        if (encode_working_set(params) <= cache_size)
+            lo = middle;
+        else
+            hi = middle;
+    }
+    return lo * 64;
+}
+
+
+// Measure encoding speed with the given block size, return MB/s at the median time or 0 on failure
+static double autotune_measure(ECC_bench_params params, std::unique_ptr<StripeEncoder> (*create_stripe_encoder)(ECC_bench_params))
+{
+    std::unique_ptr<StripeEncoder> encoder = create_stripe_encoder(params);
+    if (! encoder)
+        return 0;
+
+    AlignedBuffer original(params.OriginalFileBytes()), recovery(params.RecoveryDataBytes());
+    for (size_t i = 0; i < params.OriginalFileBytes(); ++i) {
+        original.data()[i] = (uint8_t)((i*123456791) >> 13);
+    }
+
+    OperationTimer encode_time;
+    for (TrialLoop trial(params); trial.Next(); )
+    {
+        encode_time.BeginCall();
+        bool succeeded = encoder->Encode(original.data(), recovery.data());
+        encode_time.EndCall();
+        if (! succeeded)
+            return 0;
+    }
+    if (encode_time.Invocations == 0)
+        return 0;
+
+    TimingStats stats = encode_time.Stats();
+    double megabytes_per_second = params.OriginalFileBytes() / std::max(stats.MedianUsec, 1.0);
+    stats.MegabytesPerSecondAtMedian = megabytes_per_second;
+    write_to_logfile("autotune encode", int(encode_time.Invocations),
+        stats.MeanUsec, params.OriginalFileBytes() / stats.MeanUsec, &stats);
+    return megabytes_per_second;
+}
+
+
+// Find the block size with the best encoding speed and print results, return false if nothing was measured.
+// params are modified during measurements, so each result is logged with the block size used, and restored at the end
+bool autotune_main(ECC_bench_params& params, const char* name,
+                   size_t (*encode_working_set)(ECC_bench_params),
+                   std::unique_ptr<StripeEncoder> (*create_stripe_encoder)(ECC_bench_params))
+{
+    static CacheSizes caches = read_cache_sizes();
+    ECC_bench_params saved_params = params;
+
+    // Measure each candidate for 0.2 seconds by default
+    if (! params.TimeBudgetUsec)
+        params.TimeBudgetUsec = 200000;
+
+    printf("%s autotune (L2 %.0lf KB, L3 %.0lf KB):\n", name, caches.L2 / 1024.0, caches.L3 / 1024.0);
+
+    // Candidates: powers of 2 while the working set fits into twice the L3 size,
+    // and the largest sizes fitting into L2, half of L3 and L3 (the last level cache is shared with other cores)
+    int fit_L2 = largest_block_fitting(params, encode_working_set, caches.L2);
+    int fit_L3 = largest_block_fitting(params, encode_working_set, caches.L3);
+    int fit_half_L3 = largest_block_fitting(params, encode_working_set, caches.L3 / 2);
+    int limit = std::max(largest_block_fitting(params, encode_working_set, 2 * caches.L3), 1024);
+
+    std::vector<int> candidates;
+    for (int block_bytes = 1024; block_bytes <= limit; block_bytes *= 2)
+        candidates.push_back(block_bytes);
+    for (int block_bytes : {fit_L2, fit_half_L3, fit_L3})
+        if (block_bytes >= 64)
+            candidates.push_back(block_bytes);
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    int best_block_bytes = 0;
+    double best_speed = 0;
+    for (int block_bytes : candidates)
+    {
+        params.BlockBytes = block_bytes;
+        double speed = autotune_measure(params, create_stripe_encoder);
+        uint64_t bytes = encode_working_set(params);
+        printf("  chunk_size=%d: working set %.0lf KB (%s), %.0lf MB/s\n", block_bytes, bytes / 1024.0,
+            bytes <= caches.L2? "fits L2" : bytes <= caches.L3? "fits L3" : "exceeds L3", speed);
+        if (speed > best_speed) {
+            best_speed = speed;
+            best_block_bytes = block_bytes;
+        }
+    }
+
+    if (! best_block_bytes) {
+        printf("  no block size could be measured\n");
+        params = saved_params;
+        return false;
+    }
+
+    printf("  best: chunk_size=%d, %.0lf MB/s\n", best_block_bytes, best_speed);
+    params.BlockBytes = best_block_bytes;
+    write_to_logfile("autotune best", 1, params.OriginalFileBytes() / best_speed, best_speed);
+    params = saved_params;
+    return true;
+}
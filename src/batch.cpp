@@ -0,0 +1,91 @@
+//
+// Batched encoding: B independent small codewords encoded by a single call, so per-call overhead and table setup
+// are amortized over the batch, and the kernels process long contiguous blocks
+//
+
+#include <cstdio>
+#include <cstring>
+
+#include "common.h"
+
+
+// Batches whose data and parity exceed this size are skipped
+static const size_t MAX_BATCH_BYTES = size_t(1) << 30;
+
+
+// Encode batches of B codewords for each B in batches, print speeds and return false if anything failed.
+// Block j of codeword b is stored at (j*B+b)*BlockBytes, so block j of all codewords forms a contiguous block
+// of B*BlockBytes bytes. All benchmarked codes process each byte (word) position of blocks independently,
+// so encoding of B interleaved codewords is the encoding of a single codeword with B times larger blocks,
+// performed by a single encoder with the tables and workspace shared by the whole batch
+bool batch_benchmark_main(ECC_bench_params params, const std::vector<int>& batches, const char* name,
+                          std::unique_ptr<StripeEncoder> (*create_stripe_encoder)(ECC_bench_params))
+{
+    // Encoder of a single codeword, to check that the codewords of the batch are encoded independently
+    std::unique_ptr<StripeEncoder> single_encoder = create_stripe_encoder(params);
+    if (! single_encoder)   // library doesn't support these params
+        return false;
+
+    printf("%s batch:\n", name);
+
+    AlignedBuffer codeword(params.OriginalFileBytes()), codeword_recovery(params.RecoveryDataBytes());
+
+    for (int batch : batches)
+    {
+        // Sizes are checked in 64 bits, since the block size of a large batch doesn't fit into int
+        uint64_t batch_block_bytes = uint64_t(params.BlockBytes) * uint64_t(batch < 1? 0 : batch);
+        if (batch < 1  ||  batch_block_bytes * (params.OriginalCount + params.RecoveryCount) > MAX_BATCH_BYTES) {
+            printf("  batch %d: skipped, too large\n", batch);
+            continue;
+        }
+        ECC_bench_params batch_params = params;
+        batch_params.BlockBytes = int(batch_block_bytes);
+        std::unique_ptr<StripeEncoder> encoder = create_stripe_encoder(batch_params);
+        if (! encoder) {
+            printf("  batch %d: skipped, unsupported parameters\n", batch);
+            continue;
+        }
+
+        AlignedBuffer original(batch_params.OriginalFileBytes()), recovery(batch_params.RecoveryDataBytes());
+        for (size_t i = 0; i < batch_params.OriginalFileBytes(); ++i) {
+            original.data()[i] = (uint8_t)((i*123456791) >> 13);
+        }
+
+        OperationTimer encode_time;
+        for (TrialLoop trial(params); trial.Next(); )
+        {
+            encode_time.BeginCall();
+            bool succeeded = encoder->Encode(original.data(), recovery.data());
+            encode_time.EndCall();
+            if (! succeeded) {
+                printf("  batch %d: encoding failed\n", batch);
+                return false;
+            }
+        }
+
+        // Each codeword of the batch, encoded alone, should produce the same parity blocks
+        for (int b = 0; b < batch; ++b)
+        {
+            for (int j = 0; j < params.OriginalCount; ++j)
+                memcpy(codeword.data() + j * params.BlockBytes, original.data() + (size_t(j) * batch + b) * params.BlockBytes, params.BlockBytes);
+            if (! single_encoder->Encode(codeword.data(), codeword_recovery.data())) {
+                printf("  encoding of a single codeword failed\n");
+                return false;
+            }
+            for (int i = 0; i < params.RecoveryCount; ++i) {
+                if (memcmp(codeword_recovery.data() + i * params.BlockBytes,
+                           recovery.data() + (size_t(i) * batch + b) * params.BlockBytes, params.BlockBytes)) {
+                    printf("  batch %d: parity block %d of codeword %d doesn't match the codeword encoded alone\n", batch, i, b);
+                    return false;
+                }
+            }
+        }
+
+        // Speed in terms of original data of all codewords, so batches of different sizes can be compared directly
+        char operation[64];
+        snprintf(operation, sizeof(operation), "encode batch %d", batch);
+        encode_time.Print(operation, batch_params.OriginalFileBytes());
+    }
+
+    return true;
+}
@@ -3,11 +3,320 @@
 //
 
 #include <cstdio>
+#include <cstring>
+#include <list>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common.h"
 
 #include "../src/gf256.cpp"
+#include "../src/cm256.cpp"
 
-#include "common.h"
+ISA_BUILD_BEGIN
+
+
+// GF(2^8) limits the total number of blocks
+bool cm256_supports(ECC_bench_params params)
+{
+    return params.OriginalCount + params.RecoveryCount <= 256;
+}
+
+
+// Extra workspace used by the library on top of place required for original data:
+// recovery blocks plus blocks recovered by CM256CachedDecoder
+size_t cm256_extra_space(ECC_bench_params params)
+{
+    return 2 * params.RecoveryDataBytes();
+}
+
+
+// Encoder reads original blocks and writes recovery blocks, its matrix is computed on the fly
+size_t cm256_encode_working_set(ECC_bench_params params)
+{
+    return params.OriginalFileBytes() + params.RecoveryDataBytes();
+}
+
+// CM256 has scalar, SSSE3 and AVX2 code paths, the latter only if compiled with AVX2 support.
+// The AVX-512 build runs the AVX2 code path, with the rest of the library compiled for AVX-512
+bool cm256_has_isa(int isa)
+{
+    return isa == ISA_SCALAR
+#ifndef GF256_TARGET_MOBILE
+        ||  isa == ISA_SSSE3
+#  ifdef GF256_TRY_AVX2
+        ||  isa == ISA_AVX2
+#  endif
+#  if defined(GF256_TRY_AVX2) && defined(__AVX512BW__)
+        ||  isa == ISA_AVX512
+#  endif
+#endif
+        ;
+}
+
+
+// gf256_init() detects CPU features only on the first call, so we save them to restore later
+void gf256_limit_isa(int isa)
+{
+#ifndef GF256_TARGET_MOBILE
+#  ifdef GF256_TRY_AVX2
+    static const bool has_avx2 = CpuHasAVX2;
+    CpuHasAVX2 = has_avx2  &&  isa >= ISA_AVX2;
+#  endif
+    static const bool has_ssse3 = CpuHasSSSE3;
+    CpuHasSSSE3 = has_ssse3  &&  isa >= ISA_SSSE3;
+#endif
+}
+
+
+// Element of the CM256 encoding matrix: multiplier of original block y_j in recovery block x_i,
+// where x_0 = OriginalCount is the index of the first recovery block
+uint8_t cm256_matrix_element(int original_count, int x_i, int y_j)
+{
+    if (original_count == 1)   // single original block is just copied to all recovery blocks
+        return 1;
+    uint8_t x_0 = uint8_t(original_count);
+    return gf256_div(gf256_add(uint8_t(y_j), x_0), gf256_add(uint8_t(x_i), uint8_t(y_j)));
+}
+
+
+// Decoder that keeps recovery matrices for the most recently used erasure patterns.
+// cm256_decode() builds and inverts the Cauchy submatrix on every call, but in a storage rebuild
+// the same blocks are missing across millions of stripes, so we can compute the matrix once
+// per erasure pattern and then spend time only on the multiply-add of the stripe data itself.
+// Multiplication tables for all 256 multipliers are precomputed by gf256_init(),
+// so the matrix element selects the table used for each source block.
+class CM256CachedDecoder
+{
+public:
+    // Recovery matrix for a single erasure pattern
+    struct Matrix
+    {
+        std::vector<uint8_t> Lost;      // indexes of lost original blocks, in ascending order
+        std::vector<uint8_t> Sources;   // block indexes used for recovery: surviving originals, then recovery blocks
+        std::vector<uint8_t> Coef;      // Coef[r*Sources.size()+s]: multiplier of Sources[s] in the lost block Lost[r]
+    };
+
+    explicit CM256CachedDecoder(size_t capacity)  : Capacity(capacity)  {}
+
+    // Find matrix for the erasure pattern of blocks[] (OriginalCount blocks, as passed to cm256_decode),
+    // computing it on cache miss. Return nullptr if blocks[] can't be decoded
+    const Matrix* Lookup(cm256_encoder_params params, const cm256_block* blocks)
+    {
+        // Key is the set of original block indexes lost plus the set of recovery block indexes received
+        bool present[256] = {};
+        for (int i = 0; i < params.OriginalCount; ++i)
+            present[blocks[i].Index] = true;
+        std::string key(1, char(params.OriginalCount));
+        for (int i = 0; i < params.OriginalCount + params.RecoveryCount; ++i)
+            if (present[i] != (i < params.OriginalCount))
+                key += char(i);
+
+        auto it = Index.find(key);
+        if (it != Index.end()) {
+            ++Hits;
+            Lru.splice(Lru.begin(), Lru, it->second);   // move to the front of the list
+            return &it->second->second;
+        }
+
+        ++Misses;
+        Matrix matrix;
+        if (! Compute(params, present, matrix))
+            return nullptr;
+        if (Lru.size() >= Capacity) {
+            Index.erase(Lru.back().first);
+            Lru.pop_back();
+        }
+        Lru.emplace_front(key, std::move(matrix));
+        Index[key] = Lru.begin();
+        return &Lru.front().second;
+    }
+
+    // Recover lost original blocks of blocks[] into consecutive blocks of recoveredBlocks,
+    // in the order of matrix.Lost
+    void Apply(cm256_encoder_params params, const Matrix& matrix, const cm256_block* blocks, uint8_t* recoveredBlocks)
+    {
+        const void* block_by_index[256];
+        for (int i = 0; i < params.OriginalCount; ++i)
+            block_by_index[blocks[i].Index] = blocks[i].Block;
+
+        // Read each source block once and add it to all recovered blocks
+        size_t sources = matrix.Sources.size();
+        for (size_t s = 0; s < sources; ++s)
+        {
+            const void* source = block_by_index[matrix.Sources[s]];
+            for (size_t r = 0; r < matrix.Lost.size(); ++r)
+            {
+                uint8_t* recovered = recoveredBlocks + r * params.BlockBytes;
+                if (s == 0)
+                    gf256_mul_mem(recovered, source, matrix.Coef[r*sources+s], params.BlockBytes);
+                else
+                    gf256_muladd_mem(recovered, matrix.Coef[r*sources+s], source, params.BlockBytes);
+            }
+        }
+    }
+
+    // Recover lost original blocks, return false if blocks[] can't be decoded
+    bool Decode(cm256_encoder_params params, const cm256_block* blocks, uint8_t* recoveredBlocks)
+    {
+        const Matrix* matrix = Lookup(params, blocks);
+        if (! matrix)
+            return false;
+        Apply(params, *matrix, blocks, recoveredBlocks);
+        return true;
+    }
+
+    void Clear()
+    {
+        Lru.clear();
+        Index.clear();
+    }
+
+    uint64_t Hits = 0;
+    uint64_t Misses = 0;
+
+private:
+    // Compute the recovery matrix, return false if there are not enough blocks for recovery
+    static bool Compute(cm256_encoder_params params, const bool* present, Matrix& matrix)
+    {
+        std::vector<uint8_t> received;   // recovery blocks
+        for (int i = 0; i < params.OriginalCount; ++i) {
+            if (present[i])
+                matrix.Sources.push_back(uint8_t(i));
+            else
+                matrix.Lost.push_back(uint8_t(i));
+        }
+        for (int i = params.OriginalCount; i < params.OriginalCount + params.RecoveryCount; ++i)
+            if (present[i]  &&  received.size() < matrix.Lost.size())
+                received.push_back(uint8_t(i));
+
+        size_t lost = matrix.Lost.size(), known = matrix.Sources.size();
+        if (received.size() < lost)
+            return false;
+
+        // Invert the submatrix of recovery rows and lost columns with Gauss-Jordan elimination:
+        // a[] is transformed into the identity matrix, while inv[] becomes the inverse of the original a[]
+        std::vector<uint8_t> a(lost*lost), inv(lost*lost);
+        for (size_t i = 0; i < lost; ++i)
+            for (size_t j = 0; j < lost; ++j) {
+                a[i*lost+j] = cm256_matrix_element(params.OriginalCount, received[i], matrix.Lost[j]);
+                inv[i*lost+j] = (i==j);
+            }
+        for (size_t col = 0; col < lost; ++col)
+        {
+            size_t pivot = col;
+            while (pivot < lost  &&  a[pivot*lost+col] == 0)
+                ++pivot;
+            if (pivot == lost)
+                return false;
+            for (size_t j = 0; j < lost; ++j) {
+                std::swap(a[col*lost+j], a[pivot*lost+j]);
+                std::swap(inv[col*lost+j], inv[pivot*lost+j]);
+            }
+            uint8_t scale = gf256_inv(a[col*lost+col]);
+            for (size_t j = 0; j < lost; ++j) {
+                a[col*lost+j] = gf256_mul(a[col*lost+j], scale);
+                inv[col*lost+j] = gf256_mul(inv[col*lost+j], scale);
+            }
+            for (size_t i = 0; i < lost; ++i) {
+                uint8_t factor = a[i*lost+col];
+                if (i == col  ||  factor == 0)
+                    continue;
+                for (size_t j = 0; j < lost; ++j) {
+                    a[i*lost+j] = gf256_add(a[i*lost+j], gf256_mul(a[col*lost+j], factor));
+                    inv[i*lost+j] = gf256_add(inv[i*lost+j], gf256_mul(inv[col*lost+j], factor));
+                }
+            }
+        }
+
+        // Lost = inv * (received + known part of their encoding rows), since subtraction is addition in GF(2^8)
+        matrix.Sources.insert(matrix.Sources.end(), received.begin(), received.end());
+        size_t sources = matrix.Sources.size();
+        matrix.Coef.assign(lost * sources, 0);
+        for (size_t r = 0; r < lost; ++r)
+        {
+            for (size_t i = 0; i < lost; ++i)
+            {
+                uint8_t c = inv[r*lost+i];
+                matrix.Coef[r*sources + known + i] = c;
+                for (size_t s = 0; s < known; ++s) {
+                    uint8_t m = cm256_matrix_element(params.OriginalCount, received[i], matrix.Sources[s]);
+                    matrix.Coef[r*sources+s] = gf256_add(matrix.Coef[r*sources+s], gf256_mul(c, m));
+                }
+            }
+        }
+        return true;
+    }
+
+    size_t Capacity;
+    std::list<std::pair<std::string, Matrix>> Lru;   // most recently used matrices first
+    std::unordered_map<std::string, std::list<std::pair<std::string, Matrix>>::iterator> Index;
+};
+
+
+// Stripe encoder with the Cauchy matrix computed once for all stripes, and decoder employing cm256_decode()
+class CM256StripeCodec : public StripeCodec
+{
+public:
+    explicit CM256StripeCodec(ECC_bench_params params)
+        : Params(params), Matrix(params.RecoveryCount * params.OriginalCount)
+    {
+        for (int i = 0; i < params.RecoveryCount; ++i)
+            for (int j = 0; j < params.OriginalCount; ++j)
+                Matrix[i*params.OriginalCount + j] = cm256_matrix_element(params.OriginalCount, cm256_get_recovery_block_index(params, i), j);
+    }
+
+    bool Encode(uint8_t* original, uint8_t* recovery) override
+    {
+        for (int i = 0; i < Params.RecoveryCount; ++i)
+        {
+            uint8_t* block = recovery + i * Params.BlockBytes;
+            gf256_mul_mem(block, original, Matrix[i*Params.OriginalCount], Params.BlockBytes);
+            for (int j = 1; j < Params.OriginalCount; ++j)
+                gf256_muladd_mem(block, Matrix[i*Params.OriginalCount + j], original + j * Params.BlockBytes, Params.BlockBytes);
+        }
+        return true;
+    }
+
+    // cm256_decode() recovers the data in place of the substituted recovery blocks, so they are copied to their places
+    bool Decode(uint8_t* original, uint8_t* recovery, const std::vector<char>& lost) override
+    {
+        cm256_block blocks[256];
+        if (! cm256_lose_blocks(Params, original, recovery, lost, blocks))
+            return false;
+        if (cm256_decode(Params, blocks))
+            return false;
+        for (int i = 0; i < Params.OriginalCount; ++i) {
+            if (lost[i])
+                memcpy(original + i * Params.BlockBytes, blocks[i].Block, Params.BlockBytes);
+        }
+        return true;
+    }
+
+private:
+    ECC_bench_params Params;
+    std::vector<uint8_t> Matrix;   // Matrix[i*OriginalCount+j]: multiplier of original block j in recovery block i
+};
+
+
+std::unique_ptr<StripeCodec> cm256_create_stripe_codec(ECC_bench_params params)
+{
+    if (params.OriginalCount + params.RecoveryCount > 256)
+        return nullptr;
+    if (cm256_init()) {
+        printf("cm256_init failed\n");
+        return nullptr;
+    }
+    gf256_limit_isa(params.Isa);
+    return std::unique_ptr<StripeCodec>(new CM256StripeCodec(params));
+}
+
+std::unique_ptr<StripeEncoder> cm256_create_stripe_encoder(ECC_bench_params params)
+{
+    return cm256_create_stripe_codec(params);
+}
 
 
 // Perform single encoding operation, return false if it fails
@@ -37,16 +346,13 @@ bool cm256_benchmark_encode(
 }
 
 
-// Perform single operation decoding single lost block, return false if it fails
-bool cm256_benchmark_decode_one_block(
+// Fill blocks[] with the original blocks, except for a single lost block replaced with a recovery block
+void cm256_lose_one_block(
     ECC_bench_params params,
     uint8_t* originalFileData,
     uint8_t* recoveryBlocks,
-    OperationTimer& decode_time)
+    cm256_block* blocks)
 {
-    // Pointers to data
-    cm256_block blocks[256];
-
     // Initialize the indices
     for (int i = 0; i < params.OriginalCount; ++i)
     {
@@ -59,6 +365,70 @@ bool cm256_benchmark_decode_one_block(
     blocks[0].Block = recoveryBlocks + lostBlock * params.BlockBytes; // A recovery block
     blocks[0].Index = cm256_get_recovery_block_index(params, lostBlock); // A recovery block index
     //// Simulate loss of data, subsituting a recovery block in its place ////
+}
+
+
+// Fill blocks[] with the original blocks, except for as much lost blocks as possible replaced with recovery blocks
+void cm256_lose_all_blocks(
+    ECC_bench_params params,
+    uint8_t* originalFileData,
+    uint8_t* recoveryBlocks,
+    cm256_block* blocks)
+{
+    // Initialize the indices for recovery operation
+    for (int i = 0; i < params.OriginalCount; ++i)
+    {
+        if (i < params.RecoveryCount) {
+            // Simulate loss of data, subsituting a recovery block in its place
+            blocks[i].Block = recoveryBlocks + i * params.BlockBytes;       // recovery block
+            blocks[i].Index = cm256_get_recovery_block_index(params, i);    // recovery block index
+        } else {
+            blocks[i].Block = originalFileData + i * params.BlockBytes;     // data block
+            blocks[i].Index = cm256_get_original_block_index(params, i);    // data block index
+        }
+    }
+}
+
+
+// Fill blocks[] with the original blocks, replacing each lost original block with the next available recovery block
+// (lost[] as in StripeCodec::Decode). Return false if there are not enough recovery blocks
+bool cm256_lose_blocks(
+    ECC_bench_params params,
+    uint8_t* originalFileData,
+    uint8_t* recoveryBlocks,
+    const std::vector<char>& lost,
+    cm256_block* blocks)
+{
+    int recoveryBlock = 0;
+    for (int i = 0; i < params.OriginalCount; ++i)
+    {
+        blocks[i].Block = originalFileData + i * params.BlockBytes;
+        blocks[i].Index = cm256_get_original_block_index(params, i);
+        if (! lost[i])
+            continue;
+
+        while (recoveryBlock < params.RecoveryCount  &&  lost[params.OriginalCount + recoveryBlock])
+            ++recoveryBlock;
+        if (recoveryBlock == params.RecoveryCount)
+            return false;
+        blocks[i].Block = recoveryBlocks + recoveryBlock * params.BlockBytes;
+        blocks[i].Index = cm256_get_recovery_block_index(params, recoveryBlock);
+        ++recoveryBlock;
+    }
+    return true;
+}
+
+
+// Perform single operation decoding single lost block, return false if it fails
+bool cm256_benchmark_decode_one_block(
+    ECC_bench_params params,
+    uint8_t* originalFileData,
+    uint8_t* recoveryBlocks,
+    OperationTimer& decode_time)
+{
+    // Pointers to data
+    cm256_block blocks[256];
+    cm256_lose_one_block(params, originalFileData, recoveryBlocks, blocks);
 
     decode_time.BeginCall();
     if (cm256_decode(params, blocks))
@@ -84,19 +454,7 @@ bool cm256_benchmark_decode_all_blocks(
 {
     // Pointers to data
     cm256_block blocks[256];
-
-    // Initialize the indices for recovery operation
-    for (int i = 0; i < params.OriginalCount; ++i)
-    {
-        if (i < params.RecoveryCount) {
-            // Simulate loss of data, subsituting a recovery block in its place
-            blocks[i].Block = recoveryBlocks + i * params.BlockBytes;       // recovery block
-            blocks[i].Index = cm256_get_recovery_block_index(params, i);    // recovery block index
-        } else {
-            blocks[i].Block = originalFileData + i * params.BlockBytes;     // data block
-            blocks[i].Index = cm256_get_original_block_index(params, i);    // data block index
-        }
-    }
+    cm256_lose_all_blocks(params, originalFileData, recoveryBlocks, blocks);
 
     decode_time.BeginCall();
     if (cm256_decode(params, blocks))
@@ -114,20 +472,154 @@ bool cm256_benchmark_decode_all_blocks(
 }
 
 
+// Timers of all operations
+struct CM256Timers
+{
+    OperationTimer encode, decode_one, decode_all;
+};
+
+
+// Run all benchmark trials on a single codeword, return false if anything failed
+bool cm256_benchmark_trials(
+    ECC_bench_params params,
+    uint8_t* buffer,
+    CM256Timers& timers)
+{
+    // Places for original and parity data
+    auto originalFileData = buffer;
+    auto recoveryBlocks   = buffer + params.OriginalFileBytes();
+
+    // Repeat benchmark multiple times to improve its accuracy
+    for (TrialLoop trial(params); trial.Next(); )
+    {
+        if (! cm256_benchmark_encode(params, originalFileData, recoveryBlocks, timers.encode)) {
+            return false;
+        }
+        if (! cm256_benchmark_decode_one_block(params, originalFileData, recoveryBlocks, timers.decode_one)) {
+            return false;
+        }
+        if (! cm256_benchmark_encode(params, originalFileData, recoveryBlocks, timers.encode)) {
+            return false;
+        }
+        if (! cm256_benchmark_decode_all_blocks(params, originalFileData, recoveryBlocks, timers.decode_all)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// Perform single cached decoding operation, and check the recovered data on the first call.
+// Return false if it fails
+bool cm256_benchmark_cached_decode(
+    ECC_bench_params params,
+    CM256CachedDecoder& decoder,
+    const cm256_block* blocks,
+    uint8_t* originalFileData,
+    uint8_t* recoveredBlocks,
+    OperationTimer& decode_time)
+{
+    decode_time.BeginCall();
+    const CM256CachedDecoder::Matrix* matrix = decoder.Lookup(params, blocks);
+    if (! matrix)
+    {
+        printf("  CM256CachedDecoder failed: not enough blocks for recovery\n");
+        return false;
+    }
+    decoder.Apply(params, *matrix, blocks, recoveredBlocks);
+    decode_time.EndCall();
+
+    // Check the recovered data, but only once since it's slow
+    if (! decode_time.Checked) {
+        decode_time.Checked = true;
+        for (size_t r = 0; r < matrix->Lost.size(); ++r) {
+            if (memcmp(recoveredBlocks + r * params.BlockBytes, originalFileData + matrix->Lost[r] * params.BlockBytes, params.BlockBytes)) {
+                printf("  CM256CachedDecoder failed: recovered block %d doesn't match original data\n", int(matrix->Lost[r]));
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+// Benchmark decoding with recovery matrices cached per erasure pattern:
+// setup cost (building the matrix on cache miss) separately from the steady-state cost per stripe
+bool cm256_benchmark_cached(ECC_bench_params params, uint8_t* buffer)
+{
+    // Places for original, parity and recovered data
+    auto originalFileData = buffer;
+    auto recoveryBlocks   = buffer + params.OriginalFileBytes();
+    auto recoveredBlocks  = recoveryBlocks + params.RecoveryDataBytes();
+
+    // Recovery data for decoding
+    OperationTimer encode_time;
+    if (! cm256_benchmark_encode(params, originalFileData, recoveryBlocks, encode_time)) {
+        return false;
+    }
+
+    cm256_block blocks_losing_one[256], blocks_losing_all[256];
+    cm256_lose_one_block(params, originalFileData, recoveryBlocks, blocks_losing_one);
+    cm256_lose_all_blocks(params, originalFileData, recoveryBlocks, blocks_losing_all);
+
+    const size_t CACHE_SIZE = 64;   // number of erasure patterns kept
+    CM256CachedDecoder decoder(CACHE_SIZE);
+    OperationTimer setup_one_time, setup_all_time, decode_one_time, decode_all_time;
+
+    // Repeat benchmark multiple times to improve its accuracy
+    for (TrialLoop trial(params); trial.Next(); )
+    {
+        // Cache miss: build the recovery matrix
+        decoder.Clear();
+        setup_one_time.BeginCall();
+        bool succeeded = decoder.Lookup(params, blocks_losing_one) != nullptr;
+        setup_one_time.EndCall();
+        setup_all_time.BeginCall();
+        succeeded = succeeded  &&  decoder.Lookup(params, blocks_losing_all) != nullptr;
+        setup_all_time.EndCall();
+        if (! succeeded) {
+            printf("  CM256CachedDecoder failed: not enough blocks for recovery\n");
+            return false;
+        }
+
+        // Cache hit: process the stripe data only
+        if (! cm256_benchmark_cached_decode(params, decoder, blocks_losing_one, originalFileData, recoveredBlocks, decode_one_time)) {
+            return false;
+        }
+        if (! cm256_benchmark_cached_decode(params, decoder, blocks_losing_all, originalFileData, recoveredBlocks, decode_all_time)) {
+            return false;
+        }
+    }
+
+    setup_one_time.PrintTime("decode one setup");
+    decode_one_time.Print("decode one cached", params.BlockBytes);
+    setup_all_time.PrintTime("decode all setup");
+    decode_all_time.Print("decode all cached", params.RecoveryDataBytes());
+
+    return true;
+}
+
+
 // Benchmark library and print results, return false if anything failed
 bool cm256_benchmark_main(ECC_bench_params params, uint8_t* buffer)
 {
     if (params.OriginalCount + params.RecoveryCount > 256)
         return false;
 
-    // Initialize library and choose CPU SIMD extension to use
+    // Initialize library (timed as the one-time setup) and choose CPU SIMD extension to use, no more advanced than params.Isa
+    OperationTimer init_time(0);
+    init_time.BeginCall();
     if (cm256_init()) {
         printf("cm256_init failed\n");
         return false;
     }
+    init_time.EndCall();
+    gf256_limit_isa(params.Isa);
 
     // Print CPU SIMD extensions used to accelerate library in this run
-    // (depends on compilation options such as -mavx2 and actual CPU)
+    // (depends on compilation options such as -mavx2, actual CPU and --isa option)
     printf("CM256 (%s, %d-bit):\n",
 #ifndef GF256_TARGET_MOBILE
 #  ifdef GF256_TRY_AVX2
@@ -139,37 +631,41 @@ bool cm256_benchmark_main(ECC_bench_params params, uint8_t* buffer)
         CpuHasNeon64? "neon64":
         CpuHasNeon? "neon":
 #endif
-        "", sizeof(size_t)*8);
-
+        "scalar", sizeof(size_t)*8);
+    init_time.PrintTime("init");
 
-    // Places for original and parity data
-    auto originalFileData = buffer;
-    auto recoveryBlocks   = buffer + params.OriginalFileBytes();
 
     // Total encode/decode times
-    OperationTimer encode_time, decode_one_time, decode_all_time;
+    CM256Timers timers;
 
-    // Repeat benchmark multiple times to improve its accuracy
-    for (int trial = 0; trial < params.Trials; ++trial)
+    if (! cm256_benchmark_trials(params, buffer, timers)) {
+        return false;
+    }
+
+    // Benchmark reports for each operation
+    timers.encode.Print("encode", params.OriginalFileBytes());
+    timers.decode_one.Print("decode one", params.BlockBytes);
+    timers.decode_all.Print("decode all", params.RecoveryDataBytes());
+
+    if (! cm256_benchmark_cached(params, buffer)) {
+        return false;
+    }
+
+    // Repeat the same benchmark on multiple cores simultaneously, each thread processing its own codeword
+    if (params.Threads > 1)
     {
-        if (! cm256_benchmark_encode(params, originalFileData, recoveryBlocks, encode_time)) {
-            return false;
-        }
-        if (! cm256_benchmark_decode_one_block(params, originalFileData, recoveryBlocks, decode_one_time)) {
-            return false;
-        }
-        if (! cm256_benchmark_encode(params, originalFileData, recoveryBlocks, encode_time)) {
-            return false;
-        }
-        if (! cm256_benchmark_decode_all_blocks(params, originalFileData, recoveryBlocks, decode_all_time)) {
+        if (! run_scaling_on_threads(params, buffer, timers,
+                [&](uint8_t* thread_buffer, CM256Timers& thread_timers) {
+                    return cm256_benchmark_trials(params, thread_buffer, thread_timers);
+                },
+                {{"encode", &CM256Timers::encode, params.OriginalFileBytes()},
+                 {"decode one", &CM256Timers::decode_one, uint64_t(params.BlockBytes)},
+                 {"decode all", &CM256Timers::decode_all, params.RecoveryDataBytes()}})) {
             return false;
         }
     }
 
-    // Benchmark reports for each operation
-    encode_time.Print("encode", params.OriginalFileBytes());
-    decode_one_time.Print("decode one", params.BlockBytes);
-    decode_all_time.Print("decode all", params.RecoveryDataBytes());
-
     return true;
 }
+
+ISA_BUILD_END
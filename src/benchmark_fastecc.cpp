@@ -6,24 +6,71 @@
 //
 // Implementation of the Reed-Solomon algo in O(N*log(N)) using Number-Theoretical Transform in GF(p)
 //
+// The library has no decoder at all, so we implemented the erasure decoder on top of its NTT
+//
+// The encoder and decoder use our own NTT with Montgomery multiplication, vectorized with AVX2 and AVX-512.
+// The original encoder built on the library NTT is benchmarked as `encode library` for comparison
+//
 
 #include <cstdio>
 #include <cmath>
+#include <cstring>
 #include <memory>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>   // _umul128, __umulh
+#endif
 
 #include "common.h"
 
+#if defined(__AVX2__)  ||  ((defined(__GNUC__) || defined(__clang__))  &&  (defined(__x86_64__) || defined(__i386__)))
+#include <immintrin.h>
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__))  &&  (defined(__x86_64__) || defined(__i386__))
+#define FASTECC_HAVE_AVX512
+#define FASTECC_TARGET_AVX512  __attribute__((target("avx512f")))
+#endif
+
+ISA_BUILD_BEGIN
+
+// The library consists of templates only, so it's compiled into the namespace of the build.
+// System headers it includes are already included above
 #include "GF(p).cpp"
 #include "ntt.cpp"
 
 
+// NTT of order 2N, required by the decoder, should exist in GF(P), i.e. 2N should divide P-1:
+// 0xFFF00000 = 4095 * 2^20 for 32-bit words, and 0xFFFFFFFF00000000 = (2^32-1) * 2^32 for 64-bit words.
+// Blocks should consist of whole words
+bool fastecc_supports(ECC_bench_params params)
+{
+    size_t max_N = (params.FastECCBits == 64? size_t(1)<<31 : size_t(1)<<19);
+    return NextPow2( std::max( params.OriginalCount, params.RecoveryCount)) <= max_N
+        && params.BlockBytes % (params.FastECCBits / 8) == 0;
+}
+
+
 // Extra workspace used by the library on top of place required for original data
 size_t fastecc_extra_space(ECC_bench_params params)
 {
-    return params.BlockBytes * params.OriginalCount;
+    size_t N = NextPow2( std::max( params.OriginalCount, params.RecoveryCount));   // NTT order
+    // Decoder workspace of 2N blocks (encoder uses the first N of them) plus the codeword to decode
+    return params.BlockBytes * (2*N + params.OriginalCount + params.RecoveryCount);
 }
 
 
+// Encoder copies original blocks into N work blocks and transforms them in-place, the first of them being recovery blocks
+size_t fastecc_encode_working_set(ECC_bench_params params)
+{
+    size_t N = NextPow2( std::max( params.OriginalCount, params.RecoveryCount));
+    return params.OriginalFileBytes() + params.BlockBytes * N;
+}
+
 // Benchmark encoding using the Reed-Solomon algo
 template <typename T, T P>
 void EncodeReedSolomon (size_t N, size_t SIZE, T **data)
@@ -55,15 +102,1196 @@ void EncodeReedSolomon (size_t N, size_t SIZE, T **data)
 
     // Further optimization: in order to compute only even-indexed points,
     // it's enough to compute order-N/2 NTT of data[i]+data[i+N/2]. And so on...
+    // (EncodeReedSolomonFast does it by pruning the NTT to the first M outputs)
+}
+
+
+// Montgomery multiplication in GF(P) for 32-bit P: Mont(x,y) = x*y/2^32 mod P.
+// Multipliers are stored in the Montgomery form c*2^32 mod P, so Mont(x, c*2^32) = x*c,
+// i.e. data stay in the normal form through the whole transform, and each multiplication by a constant
+// costs a single Montgomery reduction - three 32x32-bit multiplications without any division
+struct MontConst
+{
+    uint32_t Value;       // c*2^32 mod P
+    uint32_t Quotient;    // Value * P**-1 mod 2^32, so the Montgomery quotient is just x*Quotient
+};
+
+// P**-1 mod 2^32 by Newton iteration, each step doubles the number of correct low bits starting from 3
+constexpr uint32_t mont_inverse(uint32_t p)
+{
+    uint32_t x = p;
+    for (int i = 0; i < 4; i++)
+        x *= 2 - p*x;
+    return x;
+}
+
+template <uint32_t P>
+MontConst mont_const(uint32_t c)
+{
+    uint32_t value = uint32_t((uint64_t(c) << 32) % P);
+    return {value, value * mont_inverse(P)};
+}
+
+// x*c mod P for x < P. x*Value - m*P is divisible by 2^32, so only high halves of both products are required
+template <uint32_t P>
+inline uint32_t mont_mul(uint32_t x, MontConst c)
+{
+    uint32_t high = uint32_t((uint64_t(x) * c.Value) >> 32);
+    uint32_t m = x * c.Quotient;
+    uint32_t mp = uint32_t((uint64_t(m) * P) >> 32);
+    return high - mp + (high < mp? P : 0);
+}
+
+
+// Kernels processing a block of 32-bit elements: multiplication by a constant, its accumulation, and NTT butterflies.
+// Decimation-in-frequency butterfly: x,y = x+y, (x-y)*w.  Decimation-in-time butterfly: x,y = x+y*w, x-y*w
+template <uint32_t P>
+static void fastecc_mul_block_scalar(size_t start, size_t end, uint32_t* dst, const uint32_t* src, MontConst c)
+{
+    for (size_t k = start; k < end; k++)
+        dst[k] = mont_mul<P>(src[k], c);
+}
+
+template <uint32_t P>
+static void fastecc_muladd_block_scalar(size_t start, size_t end, uint32_t* dst, const uint32_t* src, MontConst c)
+{
+    for (size_t k = start; k < end; k++)
+        dst[k] = GF_Add<uint32_t,P>(dst[k], mont_mul<P>(src[k], c));
+}
+
+template <uint32_t P>
+static void fastecc_dif_scalar(size_t start, size_t end, uint32_t* x, uint32_t* y, MontConst w)
+{
+    for (size_t k = start; k < end; k++) {
+        uint32_t u = x[k], v = y[k];
+        x[k] = GF_Add<uint32_t,P>(u, v);
+        y[k] = mont_mul<P>(GF_Sub<uint32_t,P>(u, v), w);
+    }
+}
+
+template <uint32_t P>
+static void fastecc_dit_scalar(size_t start, size_t end, uint32_t* x, uint32_t* y, MontConst w)
+{
+    for (size_t k = start; k < end; k++) {
+        uint32_t u = x[k], v = mont_mul<P>(y[k], w);
+        x[k] = GF_Add<uint32_t,P>(u, v);
+        y[k] = GF_Sub<uint32_t,P>(u, v);
+    }
+}
+
+
+#if defined(__AVX2__)
+// VPMULUDQ multiplies only even 32-bit lanes, so odd lanes are shifted into even positions and multiplied separately
+template <uint32_t P>
+static inline __m256i fastecc_mul_avx2(__m256i x, __m256i value, __m256i quotient)
+{
+    const __m256i p = _mm256_set1_epi32(P);
+    __m256i high_even = _mm256_srli_epi64(_mm256_mul_epu32(x, value), 32);
+    __m256i high_odd  = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), value);
+    __m256i high = _mm256_blend_epi32(high_even, high_odd, 0xAA);
+    __m256i m = _mm256_mullo_epi32(x, quotient);
+    __m256i mp_even = _mm256_srli_epi64(_mm256_mul_epu32(m, p), 32);
+    __m256i mp_odd  = _mm256_mul_epu32(_mm256_srli_epi64(m, 32), p);
+    __m256i mp = _mm256_blend_epi32(mp_even, mp_odd, 0xAA);
+    __m256i diff = _mm256_sub_epi32(high, mp);
+    __m256i no_borrow = _mm256_cmpeq_epi32(_mm256_max_epu32(high, mp), high);
+    return _mm256_add_epi32(diff, _mm256_andnot_si256(no_borrow, p));
+}
+
+// x-y mod P for x,y < P. P > 2^31, so x+y may overflow and we compute it as x-(P-y)
+template <uint32_t P>
+static inline __m256i fastecc_sub_avx2(__m256i x, __m256i y)
+{
+    __m256i diff = _mm256_sub_epi32(x, y);
+    __m256i no_borrow = _mm256_cmpeq_epi32(_mm256_max_epu32(x, y), x);
+    return _mm256_add_epi32(diff, _mm256_andnot_si256(no_borrow, _mm256_set1_epi32(P)));
+}
+
+template <uint32_t P>
+static inline __m256i fastecc_add_avx2(__m256i x, __m256i y)
+{
+    return fastecc_sub_avx2<P>(x, _mm256_sub_epi32(_mm256_set1_epi32(P), y));
+}
+
+template <uint32_t P>
+static void fastecc_mul_block_avx2(uint32_t* dst, const uint32_t* src, MontConst c, size_t size)
+{
+    __m256i value = _mm256_set1_epi32(c.Value), quotient = _mm256_set1_epi32(c.Quotient);
+    size_t k = 0;
+    for (; k + 8 <= size; k += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i*) (src+k));
+        _mm256_storeu_si256((__m256i*) (dst+k), fastecc_mul_avx2<P>(x, value, quotient));
+    }
+    fastecc_mul_block_scalar<P>(k, size, dst, src, c);
+}
+
+template <uint32_t P>
+static void fastecc_muladd_block_avx2(uint32_t* dst, const uint32_t* src, MontConst c, size_t size)
+{
+    __m256i value = _mm256_set1_epi32(c.Value), quotient = _mm256_set1_epi32(c.Quotient);
+    size_t k = 0;
+    for (; k + 8 <= size; k += 8) {
+        __m256i x = fastecc_mul_avx2<P>(_mm256_loadu_si256((const __m256i*) (src+k)), value, quotient);
+        __m256i y = _mm256_loadu_si256((const __m256i*) (dst+k));
+        _mm256_storeu_si256((__m256i*) (dst+k), fastecc_add_avx2<P>(y, x));
+    }
+    fastecc_muladd_block_scalar<P>(k, size, dst, src, c);
+}
+
+template <uint32_t P>
+static void fastecc_dif_avx2(uint32_t* x, uint32_t* y, MontConst w, size_t size)
+{
+    __m256i value = _mm256_set1_epi32(w.Value), quotient = _mm256_set1_epi32(w.Quotient);
+    size_t k = 0;
+    for (; k + 8 <= size; k += 8) {
+        __m256i u = _mm256_loadu_si256((const __m256i*) (x+k));
+        __m256i v = _mm256_loadu_si256((const __m256i*) (y+k));
+        _mm256_storeu_si256((__m256i*) (x+k), fastecc_add_avx2<P>(u, v));
+        _mm256_storeu_si256((__m256i*) (y+k), fastecc_mul_avx2<P>(fastecc_sub_avx2<P>(u, v), value, quotient));
+    }
+    fastecc_dif_scalar<P>(k, size, x, y, w);
+}
+
+template <uint32_t P>
+static void fastecc_dit_avx2(uint32_t* x, uint32_t* y, MontConst w, size_t size)
+{
+    __m256i value = _mm256_set1_epi32(w.Value), quotient = _mm256_set1_epi32(w.Quotient);
+    size_t k = 0;
+    for (; k + 8 <= size; k += 8) {
+        __m256i u = _mm256_loadu_si256((const __m256i*) (x+k));
+        __m256i v = fastecc_mul_avx2<P>(_mm256_loadu_si256((const __m256i*) (y+k)), value, quotient);
+        _mm256_storeu_si256((__m256i*) (x+k), fastecc_add_avx2<P>(u, v));
+        _mm256_storeu_si256((__m256i*) (y+k), fastecc_sub_avx2<P>(u, v));
+    }
+    fastecc_dit_scalar<P>(k, size, x, y, w);
+}
+#endif
+
+
+#ifdef FASTECC_HAVE_AVX512
+// The same operations on 16 elements, with comparisons into mask registers
+template <uint32_t P>
+FASTECC_TARGET_AVX512 static inline __m512i fastecc_mul_avx512(__m512i x, __m512i value, __m512i quotient)
+{
+    const __m512i p = _mm512_set1_epi32(P);
+    __m512i high_even = _mm512_srli_epi64(_mm512_mul_epu32(x, value), 32);
+    __m512i high_odd  = _mm512_mul_epu32(_mm512_srli_epi64(x, 32), value);
+    __m512i high = _mm512_mask_blend_epi32(0xAAAA, high_even, high_odd);
+    __m512i m = _mm512_mullo_epi32(x, quotient);
+    __m512i mp_even = _mm512_srli_epi64(_mm512_mul_epu32(m, p), 32);
+    __m512i mp_odd  = _mm512_mul_epu32(_mm512_srli_epi64(m, 32), p);
+    __m512i mp = _mm512_mask_blend_epi32(0xAAAA, mp_even, mp_odd);
+    __m512i diff = _mm512_sub_epi32(high, mp);
+    return _mm512_mask_add_epi32(diff, _mm512_cmplt_epu32_mask(high, mp), diff, p);
+}
+
+template <uint32_t P>
+FASTECC_TARGET_AVX512 static inline __m512i fastecc_sub_avx512(__m512i x, __m512i y)
+{
+    __m512i diff = _mm512_sub_epi32(x, y);
+    return _mm512_mask_add_epi32(diff, _mm512_cmplt_epu32_mask(x, y), diff, _mm512_set1_epi32(P));
+}
+
+template <uint32_t P>
+FASTECC_TARGET_AVX512 static inline __m512i fastecc_add_avx512(__m512i x, __m512i y)
+{
+    return fastecc_sub_avx512<P>(x, _mm512_sub_epi32(_mm512_set1_epi32(P), y));
+}
+
+template <uint32_t P>
+FASTECC_TARGET_AVX512 static void fastecc_mul_block_avx512(uint32_t* dst, const uint32_t* src, MontConst c, size_t size)
+{
+    __m512i value = _mm512_set1_epi32(c.Value), quotient = _mm512_set1_epi32(c.Quotient);
+    size_t k = 0;
+    for (; k + 16 <= size; k += 16) {
+        __m512i x = _mm512_loadu_si512(src+k);
+        _mm512_storeu_si512(dst+k, fastecc_mul_avx512<P>(x, value, quotient));
+    }
+    fastecc_mul_block_scalar<P>(k, size, dst, src, c);
+}
+
+template <uint32_t P>
+FASTECC_TARGET_AVX512 static void fastecc_muladd_block_avx512(uint32_t* dst, const uint32_t* src, MontConst c, size_t size)
+{
+    __m512i value = _mm512_set1_epi32(c.Value), quotient = _mm512_set1_epi32(c.Quotient);
+    size_t k = 0;
+    for (; k + 16 <= size; k += 16) {
+        __m512i x = fastecc_mul_avx512<P>(_mm512_loadu_si512(src+k), value, quotient);
+        _mm512_storeu_si512(dst+k, fastecc_add_avx512<P>(_mm512_loadu_si512(dst+k), x));
+    }
+    fastecc_muladd_block_scalar<P>(k, size, dst, src, c);
+}
+
+template <uint32_t P>
+FASTECC_TARGET_AVX512 static void fastecc_dif_avx512(uint32_t* x, uint32_t* y, MontConst w, size_t size)
+{
+    __m512i value = _mm512_set1_epi32(w.Value), quotient = _mm512_set1_epi32(w.Quotient);
+    size_t k = 0;
+    for (; k + 16 <= size; k += 16) {
+        __m512i u = _mm512_loadu_si512(x+k);
+        __m512i v = _mm512_loadu_si512(y+k);
+        _mm512_storeu_si512(x+k, fastecc_add_avx512<P>(u, v));
+        _mm512_storeu_si512(y+k, fastecc_mul_avx512<P>(fastecc_sub_avx512<P>(u, v), value, quotient));
+    }
+    fastecc_dif_scalar<P>(k, size, x, y, w);
+}
+
+template <uint32_t P>
+FASTECC_TARGET_AVX512 static void fastecc_dit_avx512(uint32_t* x, uint32_t* y, MontConst w, size_t size)
+{
+    __m512i value = _mm512_set1_epi32(w.Value), quotient = _mm512_set1_epi32(w.Quotient);
+    size_t k = 0;
+    for (; k + 16 <= size; k += 16) {
+        __m512i u = _mm512_loadu_si512(x+k);
+        __m512i v = fastecc_mul_avx512<P>(_mm512_loadu_si512(y+k), value, quotient);
+        _mm512_storeu_si512(x+k, fastecc_add_avx512<P>(u, v));
+        _mm512_storeu_si512(y+k, fastecc_sub_avx512<P>(u, v));
+    }
+    fastecc_dit_scalar<P>(k, size, x, y, w);
+}
+#endif
+
+
+// Cache size used by the tiled NTT unless specified by --fastecc-tile option, typical L2 size
+const size_t FASTECC_DEFAULT_TILE_BYTES = 256 << 10;
+
+
+enum FastECCKernel { FASTECC_SCALAR, FASTECC_AVX2, FASTECC_AVX512, FASTECC_KERNELS };
+
+static const char* fastecc_kernel_name[FASTECC_KERNELS] = {"scalar", "avx2", "avx512"};
+
+// Instruction set required by each kernel
+static const int fastecc_kernel_isa[FASTECC_KERNELS] = {ISA_SCALAR, ISA_AVX2, ISA_AVX512};
+
+
+// Check whether the kernel is compiled in, supported by CPU and allowed by the isa limit
+static bool fastecc_kernel_supported(FastECCKernel kernel, int isa)
+{
+    int kernel_isa = fastecc_kernel_isa[kernel];
+    if (kernel_isa > isa  ||  kernel_isa > cpu_isa())
+        return false;
+    switch (kernel) {
+#if defined(__AVX2__)
+        case FASTECC_AVX2:    return true;
+#endif
+#ifdef FASTECC_HAVE_AVX512
+        case FASTECC_AVX512:  return true;
+#endif
+        case FASTECC_SCALAR:  return true;
+        default:              return false;
+    }
+}
+
+
+// The fastest kernel allowed by the isa limit
+static FastECCKernel fastecc_best_kernel(int isa)
+{
+    int kernel = FASTECC_KERNELS - 1;
+    while (! fastecc_kernel_supported(FastECCKernel(kernel), isa))
+        --kernel;
+    return FastECCKernel(kernel);
+}
+
+
+// Whether this build has a kernel for the instruction set
+bool fastecc_has_isa(int isa)
+{
+    for (int kernel = 0; kernel < FASTECC_KERNELS; ++kernel)
+        if (fastecc_kernel_isa[kernel] == isa  &&  fastecc_kernel_supported(FastECCKernel(kernel), isa))
+            return true;
+    return false;
+}
+
+
+template <uint32_t P>
+static void fastecc_mul_block_kernel(FastECCKernel kernel, uint32_t* dst, const uint32_t* src, MontConst c, size_t size)
+{
+    switch (kernel) {
+#if defined(__AVX2__)
+        case FASTECC_AVX2:    fastecc_mul_block_avx2<P>(dst, src, c, size);  return;
+#endif
+#ifdef FASTECC_HAVE_AVX512
+        case FASTECC_AVX512:  fastecc_mul_block_avx512<P>(dst, src, c, size);  return;
+#endif
+        default:              fastecc_mul_block_scalar<P>(0, size, dst, src, c);  return;
+    }
+}
+
+template <uint32_t P>
+static void fastecc_muladd_block_kernel(FastECCKernel kernel, uint32_t* dst, const uint32_t* src, MontConst c, size_t size)
+{
+    switch (kernel) {
+#if defined(__AVX2__)
+        case FASTECC_AVX2:    fastecc_muladd_block_avx2<P>(dst, src, c, size);  return;
+#endif
+#ifdef FASTECC_HAVE_AVX512
+        case FASTECC_AVX512:  fastecc_muladd_block_avx512<P>(dst, src, c, size);  return;
+#endif
+        default:              fastecc_muladd_block_scalar<P>(0, size, dst, src, c);  return;
+    }
+}
+
+template <uint32_t P>
+static void fastecc_dif_kernel(FastECCKernel kernel, uint32_t* x, uint32_t* y, MontConst w, size_t size)
+{
+    switch (kernel) {
+#if defined(__AVX2__)
+        case FASTECC_AVX2:    fastecc_dif_avx2<P>(x, y, w, size);  return;
+#endif
+#ifdef FASTECC_HAVE_AVX512
+        case FASTECC_AVX512:  fastecc_dif_avx512<P>(x, y, w, size);  return;
+#endif
+        default:              fastecc_dif_scalar<P>(0, size, x, y, w);  return;
+    }
+}
+
+template <uint32_t P>
+static void fastecc_dit_kernel(FastECCKernel kernel, uint32_t* x, uint32_t* y, MontConst w, size_t size)
+{
+    switch (kernel) {
+#if defined(__AVX2__)
+        case FASTECC_AVX2:    fastecc_dit_avx2<P>(x, y, w, size);  return;
+#endif
+#ifdef FASTECC_HAVE_AVX512
+        case FASTECC_AVX512:  fastecc_dit_avx512<P>(x, y, w, size);  return;
+#endif
+        default:              fastecc_dit_scalar<P>(0, size, x, y, w);  return;
+    }
+}
+
+
+// Arithmetic modulo P = 2^64-2^32+1 without division, using 2^64 = 2^32-1 and 2^96 = -1 (mod P).
+// Carries and borrows are random, so they are handled with masks rather than branches
+static const uint64_t GOLDILOCKS_P = 0xFFFFFFFF00000001, GOLDILOCKS_EPSILON = 0xFFFFFFFF;   // 2^64 mod P
+
+static inline uint64_t mask_if(bool condition)  { return 0 - uint64_t(condition); }
+
+static inline uint64_t goldilocks_sub(uint64_t x, uint64_t y)
+{
+    return x - y + (mask_if(x < y) & GOLDILOCKS_P);
+}
+
+// x+y may overflow 64 bits, so we compute it as x-(P-y)
+static inline uint64_t goldilocks_add(uint64_t x, uint64_t y)
+{
+    return goldilocks_sub (x, GOLDILOCKS_P - y);
+}
+
+// x*y = high_high*2^96 + high_low*2^64 + low = low - high_high + high_low*(2^32-1)
+static inline uint64_t goldilocks_mul(uint64_t x, uint64_t y)
+{
+#if defined(_MSC_VER)  &&  defined(_M_X64)
+    uint64_t high;
+    uint64_t low = _umul128(x, y, &high);
+#elif defined(_MSC_VER)  &&  defined(_M_ARM64)
+    uint64_t low = x * y,  high = __umulh(x, y);
+#else
+    __uint128_t product = __uint128_t(x) * y;
+    uint64_t low = uint64_t(product),  high = uint64_t(product >> 64);
+#endif
+    uint64_t high_high = high >> 32,  high_low = high & GOLDILOCKS_EPSILON;
+
+    uint64_t t = low - high_high - (mask_if(low < high_high) & GOLDILOCKS_EPSILON);   // borrow of 2^64
+    uint64_t u = high_low * GOLDILOCKS_EPSILON;
+    uint64_t r = t + u;
+    r += mask_if(r < u) & GOLDILOCKS_EPSILON;                                          // carry of 2^64
+    return r - (mask_if(r >= GOLDILOCKS_P) & GOLDILOCKS_P);
+}
+
+
+#ifdef FASTECC_HAVE_AVX512
+// The same operations on 8 elements. The 128-bit product is assembled from four 32x32-bit VPMULUDQ products,
+// and carries are found with unsigned comparisons into mask registers, which AVX2 lacks
+FASTECC_TARGET_AVX512 static inline __m512i goldilocks_sub_avx512(__m512i x, __m512i y)
+{
+    __m512i diff = _mm512_sub_epi64(x, y);
+    return _mm512_mask_add_epi64(diff, _mm512_cmplt_epu64_mask(x, y), diff, _mm512_set1_epi64(GOLDILOCKS_P));
+}
+
+FASTECC_TARGET_AVX512 static inline __m512i goldilocks_add_avx512(__m512i x, __m512i y)
+{
+    return goldilocks_sub_avx512(x, _mm512_sub_epi64(_mm512_set1_epi64(GOLDILOCKS_P), y));
+}
+
+// w_high = w >> 32
+FASTECC_TARGET_AVX512 static inline __m512i goldilocks_mul_avx512(__m512i x, __m512i w, __m512i w_high)
+{
+    const __m512i epsilon = _mm512_set1_epi64(GOLDILOCKS_EPSILON);
+    __m512i x_high = _mm512_srli_epi64(x, 32);
+    __m512i ll = _mm512_mul_epu32(x, w),       lh = _mm512_mul_epu32(x, w_high);
+    __m512i hl = _mm512_mul_epu32(x_high, w),  hh = _mm512_mul_epu32(x_high, w_high);
+
+    // 128-bit product = high*2^64 + low, where the middle products lh+hl are shifted by 32 bits
+    __m512i middle = _mm512_add_epi64(lh, hl);
+    __mmask8 middle_carry = _mm512_cmplt_epu64_mask(middle, lh);
+    __m512i low = _mm512_add_epi64(ll, _mm512_slli_epi64(middle, 32));
+    __mmask8 low_carry = _mm512_cmplt_epu64_mask(low, ll);
+    __m512i high = _mm512_add_epi64(hh, _mm512_srli_epi64(middle, 32));
+    high = _mm512_mask_add_epi64(high, middle_carry, high, _mm512_set1_epi64(uint64_t(1) << 32));
+    high = _mm512_mask_add_epi64(high, low_carry, high, _mm512_set1_epi64(1));
+
+    // Reduction as in goldilocks_mul
+    __m512i high_high = _mm512_srli_epi64(high, 32),  high_low = _mm512_and_si512(high, epsilon);
+    __m512i t = _mm512_sub_epi64(low, high_high);
+    t = _mm512_mask_sub_epi64(t, _mm512_cmplt_epu64_mask(low, high_high), t, epsilon);
+    __m512i u = _mm512_sub_epi64(_mm512_slli_epi64(high_low, 32), high_low);
+    __m512i r = _mm512_add_epi64(t, u);
+    r = _mm512_mask_add_epi64(r, _mm512_cmplt_epu64_mask(r, u), r, epsilon);
+    const __m512i p = _mm512_set1_epi64(GOLDILOCKS_P);
+    return _mm512_mask_sub_epi64(r, _mm512_cmpge_epu64_mask(r, p), r, p);
+}
+
+FASTECC_TARGET_AVX512 static void goldilocks_mul_block_avx512(uint64_t* dst, const uint64_t* src, uint64_t c, size_t size)
+{
+    __m512i w = _mm512_set1_epi64(c), w_high = _mm512_set1_epi64(c >> 32);
+    size_t k = 0;
+    for (; k + 8 <= size; k += 8)
+        _mm512_storeu_si512(dst+k, goldilocks_mul_avx512(_mm512_loadu_si512(src+k), w, w_high));
+    for (; k < size; k++)
+        dst[k] = goldilocks_mul (src[k], c);
+}
+
+FASTECC_TARGET_AVX512 static void goldilocks_muladd_block_avx512(uint64_t* dst, const uint64_t* src, uint64_t c, size_t size)
+{
+    __m512i w = _mm512_set1_epi64(c), w_high = _mm512_set1_epi64(c >> 32);
+    size_t k = 0;
+    for (; k + 8 <= size; k += 8) {
+        __m512i x = goldilocks_mul_avx512(_mm512_loadu_si512(src+k), w, w_high);
+        _mm512_storeu_si512(dst+k, goldilocks_add_avx512(_mm512_loadu_si512(dst+k), x));
+    }
+    for (; k < size; k++)
+        dst[k] = goldilocks_add (dst[k], goldilocks_mul (src[k], c));
+}
+
+FASTECC_TARGET_AVX512 static void goldilocks_dif_avx512(uint64_t* x, uint64_t* y, uint64_t c, size_t size)
+{
+    __m512i w = _mm512_set1_epi64(c), w_high = _mm512_set1_epi64(c >> 32);
+    size_t k = 0;
+    for (; k + 8 <= size; k += 8) {
+        __m512i u = _mm512_loadu_si512(x+k),  v = _mm512_loadu_si512(y+k);
+        _mm512_storeu_si512(x+k, goldilocks_add_avx512(u, v));
+        _mm512_storeu_si512(y+k, goldilocks_mul_avx512(goldilocks_sub_avx512(u, v), w, w_high));
+    }
+    for (; k < size; k++) {
+        uint64_t u = x[k], v = y[k];
+        x[k] = goldilocks_add (u, v);
+        y[k] = goldilocks_mul (goldilocks_sub (u, v), c);
+    }
+}
+
+FASTECC_TARGET_AVX512 static void goldilocks_dit_avx512(uint64_t* x, uint64_t* y, uint64_t c, size_t size)
+{
+    __m512i w = _mm512_set1_epi64(c), w_high = _mm512_set1_epi64(c >> 32);
+    size_t k = 0;
+    for (; k + 8 <= size; k += 8) {
+        __m512i u = _mm512_loadu_si512(x+k),  v = goldilocks_mul_avx512(_mm512_loadu_si512(y+k), w, w_high);
+        _mm512_storeu_si512(x+k, goldilocks_add_avx512(u, v));
+        _mm512_storeu_si512(y+k, goldilocks_sub_avx512(u, v));
+    }
+    for (; k < size; k++) {
+        uint64_t u = x[k], v = goldilocks_mul (y[k], c);
+        x[k] = goldilocks_add (u, v);
+        y[k] = goldilocks_sub (u, v);
+    }
 }
+#endif
 
 
+// Arithmetic of our NTT in GF(P): constants with data precomputed for fast multiplication, and kernels processing whole blocks
 template <typename T, T P>
-bool fastecc_benchmark_specialize(ECC_bench_params params, uint8_t* buffer)
+struct FastField;
+
+// 32-bit field: Montgomery multiplication, vectorized with AVX2 and AVX-512
+template <uint32_t P>
+struct FastField<uint32_t,P>
+{
+    typedef MontConst Const;
+
+    static Const MakeConst(uint32_t c)                      { return mont_const<P> (c); }
+    static bool HasKernel(FastECCKernel kernel, int isa)    { return fastecc_kernel_supported (kernel, isa); }
+    static FastECCKernel BestKernel(int isa)                { return fastecc_best_kernel (isa); }
+
+    static void MulBlock(FastECCKernel kernel, uint32_t* dst, const uint32_t* src, Const c, size_t size)  { fastecc_mul_block_kernel<P> (kernel, dst, src, c, size); }
+    static void MulAddBlock(FastECCKernel kernel, uint32_t* dst, const uint32_t* src, Const c, size_t size)  { fastecc_muladd_block_kernel<P> (kernel, dst, src, c, size); }
+    static void DIF(FastECCKernel kernel, uint32_t* x, uint32_t* y, Const w, size_t size)                 { fastecc_dif_kernel<P> (kernel, x, y, w, size); }
+    static void DIT(FastECCKernel kernel, uint32_t* x, uint32_t* y, Const w, size_t size)                 { fastecc_dit_kernel<P> (kernel, x, y, w, size); }
+};
+
+// 64-bit field 2^64-2^32+1: special reduction of 128-bit products. There is no 64x64-bit vector multiplication,
+// so the AVX-512 kernel combines four 32x32-bit ones, and there is no AVX2 kernel since AVX2 lacks unsigned 64-bit comparisons
+template <uint64_t P>
+struct FastField<uint64_t,P>
+{
+    static_assert (P == GOLDILOCKS_P, "only P = 2^64-2^32+1 is supported");
+    typedef uint64_t Const;
+
+    static Const MakeConst(uint64_t c)                      { return c; }
+    static bool HasKernel(FastECCKernel kernel, int isa)    { return (kernel == FASTECC_SCALAR  ||  kernel == FASTECC_AVX512)  &&  fastecc_kernel_supported (kernel, isa); }
+    static FastECCKernel BestKernel(int isa)                { return HasKernel (FASTECC_AVX512, isa)? FASTECC_AVX512 : FASTECC_SCALAR; }
+
+    static void MulBlock(FastECCKernel kernel, uint64_t* dst, const uint64_t* src, Const c, size_t size)
+    {
+#ifdef FASTECC_HAVE_AVX512
+        if (kernel == FASTECC_AVX512)
+            return goldilocks_mul_block_avx512 (dst, src, c, size);
+#endif
+        for (size_t k = 0; k < size; k++)
+            dst[k] = goldilocks_mul (src[k], c);
+    }
+
+    static void MulAddBlock(FastECCKernel kernel, uint64_t* dst, const uint64_t* src, Const c, size_t size)
+    {
+#ifdef FASTECC_HAVE_AVX512
+        if (kernel == FASTECC_AVX512)
+            return goldilocks_muladd_block_avx512 (dst, src, c, size);
+#endif
+        for (size_t k = 0; k < size; k++)
+            dst[k] = goldilocks_add (dst[k], goldilocks_mul (src[k], c));
+    }
+
+    static void DIF(FastECCKernel kernel, uint64_t* x, uint64_t* y, Const w, size_t size)
+    {
+#ifdef FASTECC_HAVE_AVX512
+        if (kernel == FASTECC_AVX512)
+            return goldilocks_dif_avx512 (x, y, w, size);
+#endif
+        for (size_t k = 0; k < size; k++) {
+            uint64_t u = x[k], v = y[k];
+            x[k] = goldilocks_add (u, v);
+            y[k] = goldilocks_mul (goldilocks_sub (u, v), w);
+        }
+    }
+
+    static void DIT(FastECCKernel kernel, uint64_t* x, uint64_t* y, Const w, size_t size)
+    {
+#ifdef FASTECC_HAVE_AVX512
+        if (kernel == FASTECC_AVX512)
+            return goldilocks_dit_avx512 (x, y, w, size);
+#endif
+        for (size_t k = 0; k < size; k++) {
+            uint64_t u = x[k], v = goldilocks_mul (y[k], w);
+            x[k] = goldilocks_add (u, v);
+            y[k] = goldilocks_sub (u, v);
+        }
+    }
+};
+
+
+// Position of the element x in the bit-reversed order of n elements
+static size_t bit_reverse(size_t x, size_t n)
+{
+    size_t r = 0;
+    for (size_t bit = 1; bit < n; bit <<= 1, x >>= 1)
+        r = (r << 1) | (x & 1);
+    return r;
+}
+
+
+// Twiddle factors prepared for fast multiplication, and the kernel, used by the encoder with NTT of order N and the decoder with NTT of order 2N.
+// They depend only on N, so the plan is computed once and reused for all codewords
+template <typename T, T P>
+struct NTTPlan
+{
+    typedef typename FastField<T,P>::Const Const;
+    size_t N;
+    FastECCKernel Kernel;
+    size_t TileBytes;              // cache size for the tiled NTT, 0 for the depth-first recursion only
+    std::vector<Const> Root;       // root(2*N)**j for j < N, i.e. twiddles of the order-2N NTT
+    std::vector<Const> InvRoot;    // root(2*N)**-j for j < N
+    std::vector<Const> Scale;      // root(2*N)**i / N at the position bit_reverse(i) (step 2 of the encoder)
+
+    void Init (size_t n, FastECCKernel kernel, size_t tile_bytes)
+    {
+        N = n;
+        Kernel = kernel;
+        TileBytes = tile_bytes;
+        T root_2N = GF_Root<T,P>(2*N),  inv_root_2N = GF_Inv<T,P>(root_2N),  inv_N = GF_Inv<T,P>(N);
+        Root.resize(N);  InvRoot.resize(N);  Scale.resize(N);
+        T w = 1, inv_w = 1;
+        for (size_t j=0; j<N; j++) {
+            Root[j]    = FastField<T,P>::MakeConst (w);
+            InvRoot[j] = FastField<T,P>::MakeConst (inv_w);
+            Scale[bit_reverse(j,N)] = FastField<T,P>::MakeConst (GF_Mul<T,P> (w, inv_N));
+            w     = GF_Mul<T,P> (w, root_2N);
+            inv_w = GF_Mul<T,P> (inv_w, inv_root_2N);
+        }
+    }
+};
+
+
+// Tiled NTT processes the stages exchanging data between blocks j, j+C, j+2C... (C = n/R) in groups of R blocks,
+// so that R column tiles of these blocks fit into tile_bytes (L2 cache) and all these stages run from the cache.
+// It's the four-step NTT, where the first step is done by R-point transforms, and the remaining ones by the recursion on n/R blocks.
+// Return R, or 0 if the transform fits into the cache and the tiling isn't required
+template <typename T>
+size_t ntt_tile_blocks (size_t n, size_t SIZE, size_t tile_bytes, size_t& tile_width)
+{
+    const size_t MIN_TILE_WIDTH = 512 / sizeof(T);   // make tiles wide enough to load whole cache lines with SIMD
+    if (tile_bytes == 0  ||  n < 4  ||  n*SIZE*sizeof(T) <= tile_bytes)
+        return 0;
+    size_t R = 2;
+    while (R*2 <= n  &&  R*2 * std::min(SIZE, MIN_TILE_WIDTH) * sizeof(T) <= tile_bytes)
+        R *= 2;
+    tile_width = std::max(tile_bytes / (R*sizeof(T)), size_t(1));
+    return R;
+}
+
+// log2(R) stages of the order-n NTT with butterflies between blocks j and j+half*C, performed on each group
+// of blocks {c, c+C, c+2C...} tile by tile. DIF performs them from half=R/2 down to half=1, and DIT in the reverse order.
+// Blocks of a group are spaced by a power of 2, so they would compete for the same cache sets -
+// instead, each tile is copied into a contiguous buffer, transformed there and copied back.
+// The stages are pruned like NTT_DIF_Pruned and NTT_DIT_Pruned: a sub-transform of s blocks has min(active, s) non-zero inputs (DIF)
+// or required outputs (DIT), placed first, so butterflies of blocks j >= active are skipped, and with active = n nothing is pruned
+template <typename T, T P>
+void NTT_TiledStages (T** data, size_t n, size_t R, const typename FastField<T,P>::Const* roots, size_t stride,
+                      size_t SIZE, size_t tile_width, FastECCKernel kernel, bool dif, size_t active)
+{
+    size_t C = n / R;
+    tile_width = std::min(tile_width, SIZE);
+    std::vector<T> buffer(R * tile_width);
+    std::vector<T*> tile(R);
+    for (size_t r=0; r<R; r++)
+        tile[r] = &buffer[r * tile_width];
+
+    // Block c of each sub-transform is the first one of the group, so groups c >= active have nothing to compute
+    for (size_t c=0; c<C  &&  c<active; c++) {
+        for (size_t k=0; k<SIZE; k+=tile_width) {
+            size_t width = std::min(tile_width, SIZE-k);
+            for (size_t r=0; r<R; r++)
+                if (! dif  ||  c + r*C < active)              // zero inputs of DIF aren't read, they may hold garbage
+                    memcpy (tile[r], data[c + r*C] + k, width*sizeof(T));
+
+            for (size_t stage=1; stage<R; stage*=2) {
+                size_t half = (dif? R/2/stage : stage);
+                size_t step = stride * R/(2*half);            // twiddle stride of the sub-transform of 2*half*C blocks
+                for (size_t r=0; r<R; r++) {
+                    if (r & half)  continue;                  // r is the second block of a butterfly
+                    size_t j_rel = c + (r % half)*C;          // position of block c+r*C in its sub-transform
+                    if (j_rel >= active)
+                        continue;
+                    if (! dif)
+                        FastField<T,P>::DIT (kernel, tile[r], tile[r+half], roots[j_rel*step], width);
+                    else if (j_rel + half*C >= active)        // zero y: x,y = x, x*w
+                        FastField<T,P>::MulBlock (kernel, tile[r+half], tile[r], roots[j_rel*step], width);
+                    else
+                        FastField<T,P>::DIF (kernel, tile[r], tile[r+half], roots[j_rel*step], width);
+                }
+            }
+
+            for (size_t r=0; r<R; r++)
+                memcpy (data[c + r*C] + k, tile[r], width*sizeof(T));
+        }
+    }
+}
+
+
+// Decimation-in-frequency NTT of order n: natural order of input, bit-reversed order of output.
+// roots[j*stride] = root(n)**j. The first stage goes over all blocks, then each half is transformed recursively,
+// so once a half fits into the cache, all its remaining stages run from the cache.
+// With non-zero tile_bytes, the first stages are tiled while the transform doesn't fit into tile_bytes
+template <typename T, T P>
+void NTT_DIF (T** data, size_t n, const typename FastField<T,P>::Const* roots, size_t stride, size_t SIZE, FastECCKernel kernel, size_t tile_bytes)
+{
+    if (n < 2)  return;
+    size_t tile_width, R = ntt_tile_blocks<T> (n, SIZE, tile_bytes, tile_width);
+    if (R) {
+        NTT_TiledStages<T,P> (data, n, R, roots, stride, SIZE, tile_width, kernel, true, n);
+        for (size_t i=0; i<R; i++)
+            NTT_DIF<T,P> (data + i*(n/R), n/R, roots, stride*R, SIZE, kernel, tile_bytes);
+        return;
+    }
+    size_t half = n/2;
+    for (size_t j=0; j<half; j++)
+        FastField<T,P>::DIF (kernel, data[j], data[j+half], roots[j*stride], SIZE);
+    NTT_DIF<T,P> (data,      half, roots, stride*2, SIZE, kernel, 0);
+    NTT_DIF<T,P> (data+half, half, roots, stride*2, SIZE, kernel, 0);
+}
+
+// Decimation-in-time NTT of order n: bit-reversed order of input, natural order of output
+template <typename T, T P>
+void NTT_DIT (T** data, size_t n, const typename FastField<T,P>::Const* roots, size_t stride, size_t SIZE, FastECCKernel kernel, size_t tile_bytes)
+{
+    if (n < 2)  return;
+    size_t tile_width, R = ntt_tile_blocks<T> (n, SIZE, tile_bytes, tile_width);
+    if (R) {
+        for (size_t i=0; i<R; i++)
+            NTT_DIT<T,P> (data + i*(n/R), n/R, roots, stride*R, SIZE, kernel, tile_bytes);
+        NTT_TiledStages<T,P> (data, n, R, roots, stride, SIZE, tile_width, kernel, false, n);
+        return;
+    }
+    size_t half = n/2;
+    NTT_DIT<T,P> (data,      half, roots, stride*2, SIZE, kernel, 0);
+    NTT_DIT<T,P> (data+half, half, roots, stride*2, SIZE, kernel, 0);
+    for (size_t j=0; j<half; j++)
+        FastField<T,P>::DIT (kernel, data[j], data[j+half], roots[j*stride], SIZE);
+}
+
+
+// DIF NTT of order n, whose input blocks past the first `inputs` ones are zero. They aren't read, so they may hold garbage.
+// A butterfly with zero y is x,y = x, x*w, and a butterfly with both zero inputs is skipped, so the halves have the same number
+// of non-zero inputs. The transform of a single non-zero block is this block repeated n times, and the transform of zeroes is zeroes.
+// While the transform doesn't fit into tile_bytes, the first stages are tiled as in NTT_DIF
+template <typename T, T P>
+void NTT_DIF_Pruned (T** data, size_t n, size_t inputs, const typename FastField<T,P>::Const* roots, size_t stride, size_t SIZE, FastECCKernel kernel, size_t tile_bytes)
+{
+    if (inputs >= n)
+        return NTT_DIF<T,P> (data, n, roots, stride, SIZE, kernel, tile_bytes);
+    if (inputs <= 1) {
+        for (size_t i=inputs; i<n; i++) {
+            if (inputs)
+                memcpy (data[i], data[0], SIZE*sizeof(T));
+            else
+                memset (data[i], 0, SIZE*sizeof(T));
+        }
+        return;
+    }
+    size_t tile_width, R = ntt_tile_blocks<T> (n, SIZE, tile_bytes, tile_width);
+    if (R) {
+        NTT_TiledStages<T,P> (data, n, R, roots, stride, SIZE, tile_width, kernel, true, inputs);
+        for (size_t i=0; i<R; i++)
+            NTT_DIF_Pruned<T,P> (data + i*(n/R), n/R, std::min(inputs, n/R), roots, stride*R, SIZE, kernel, tile_bytes);
+        return;
+    }
+    size_t half = n/2;
+    for (size_t j=0; j<half  &&  j<inputs; j++) {
+        if (j+half < inputs)
+            FastField<T,P>::DIF (kernel, data[j], data[j+half], roots[j*stride], SIZE);
+        else
+            FastField<T,P>::MulBlock (kernel, data[j+half], data[j], roots[j*stride], SIZE);
+    }
+    size_t half_inputs = std::min(inputs, half);
+    NTT_DIF_Pruned<T,P> (data,      half, half_inputs, roots, stride*2, SIZE, kernel, tile_bytes);
+    NTT_DIF_Pruned<T,P> (data+half, half, half_inputs, roots, stride*2, SIZE, kernel, tile_bytes);
+}
+
+// DIT NTT of order n computing only the first `outputs` blocks of the result, other blocks are left with garbage.
+// The last stage computes output j from the outputs j of both halves, so the halves need only their first min(outputs, n/2) blocks.
+// Butterflies are skipped only when both their outputs are unneeded, computing the second one isn't worth a separate kernel.
+// While the transform doesn't fit into tile_bytes, the last stages are tiled as in NTT_DIT
+template <typename T, T P>
+void NTT_DIT_Pruned (T** data, size_t n, size_t outputs, const typename FastField<T,P>::Const* roots, size_t stride, size_t SIZE, FastECCKernel kernel, size_t tile_bytes)
+{
+    if (outputs >= n)
+        return NTT_DIT<T,P> (data, n, roots, stride, SIZE, kernel, tile_bytes);
+    if (outputs == 0)  return;
+    size_t tile_width, R = ntt_tile_blocks<T> (n, SIZE, tile_bytes, tile_width);
+    if (R) {
+        for (size_t i=0; i<R; i++)
+            NTT_DIT_Pruned<T,P> (data + i*(n/R), n/R, std::min(outputs, n/R), roots, stride*R, SIZE, kernel, tile_bytes);
+        NTT_TiledStages<T,P> (data, n, R, roots, stride, SIZE, tile_width, kernel, false, outputs);
+        return;
+    }
+    size_t half = n/2,  half_outputs = std::min(outputs, half);
+    NTT_DIT_Pruned<T,P> (data,      half, half_outputs, roots, stride*2, SIZE, kernel, tile_bytes);
+    NTT_DIT_Pruned<T,P> (data+half, half, half_outputs, roots, stride*2, SIZE, kernel, tile_bytes);
+    for (size_t j=0; j<half_outputs; j++)
+        FastField<T,P>::DIT (kernel, data[j], data[j+half], roots[j*stride], SIZE);
+}
+
+
+// The same encoding algo as EncodeReedSolomon, with our NTT. Inverse NTT leaves coefficients in the bit-reversed order,
+// which is exactly the input order of the forward DIT NTT, so no permutation is required, and step 2 just uses the permuted multipliers.
+// Only the first K blocks hold the data, and only the first M parity blocks are required, so both NTTs are pruned:
+// blocks past K aren't read, and blocks past M are used as the workspace. K=M=N performs the full NTTs
+template <typename T, T P>
+void EncodeReedSolomonFast (size_t N, size_t K, size_t M, size_t SIZE, T **data, const NTTPlan<T,P>& plan)
+{
+    // 1. iNTT of order N, whose roots are every second root of order 2N
+    NTT_DIF_Pruned<T,P> (data, N, K, &plan.InvRoot[0], 2, SIZE, plan.Kernel, plan.TileBytes);
+
+    // 2. Multiply the polynomial coefficients by root(2*N)**i / N
+    #pragma omp parallel for
+    for (ptrdiff_t i=0; i<N; i++) {
+        FastField<T,P>::MulBlock (plan.Kernel, data[i], data[i], plan.Scale[i], SIZE);
+    }
+
+    // 3. NTT: polynomial evaluation at root(2*N)**(2*i+1) points for i < M
+    NTT_DIT_Pruned<T,P> (data, N, M, &plan.Root[0], 2, SIZE, plan.Kernel, plan.TileBytes);
+}
+
+
+// FastECC works only with values < P, so larger words of the original data are reduced modulo P, i.e. P is subtracted.
+// A real application should keep positions of these words (escapes) along with the parity data, to restore them after decoding.
+// They are rare: 1/4096 of random 32-bit words for P=0xFFF00001, and 1/2^32 of 64-bit words for P=2^64-2^32+1
+template <typename T, T P>
+void fastecc_condition_data (T* dst, const T* src, size_t size, size_t position, std::vector<size_t>& escapes)
+{
+    for (size_t k=0; k<size; k++) {
+        T x = src[k];
+        if (x >= P) {
+            x -= P;
+            escapes.push_back (position+k);
+        }
+        dst[k] = x;
+    }
+}
+
+
+// Scalar NTT of order a.size(): a[j] = sum(a[i] * root**(i*j)), where root = root(N) or its inverse.
+// Used only for small polynomial arithmetic, so there is no need to make it fast
+template <typename T, T P>
+void ScalarNTT (std::vector<T>& a, bool InvNTT)
+{
+    size_t N = a.size();
+    for (size_t i=1, j=0; i<N; i++) {       // bit-reversal permutation
+        size_t bit = N >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j)  std::swap (a[i], a[j]);
+    }
+
+    T root = GF_Root<T,P>(N);
+    if (InvNTT)  root = GF_Inv<T,P>(root);
+    std::vector<T> stage_root;              // root(len) for each stage, computed as powers of root(N)
+    for (size_t len=N; len>=2; len/=2, root=GF_Mul<T,P>(root,root))
+        stage_root.push_back(root);
+
+    for (size_t len=2, stage=stage_root.size(); len<=N; len*=2) {
+        T root_len = stage_root[--stage];
+        for (size_t i=0; i<N; i+=len) {
+            T w = 1;
+            for (size_t j=0; j<len/2; j++, w=GF_Mul<T,P>(w,root_len)) {
+                T x = a[i+j],  y = GF_Mul<T,P> (a[i+j+len/2], w);
+                a[i+j]       = GF_Add<T,P> (x, y);
+                a[i+j+len/2] = GF_Sub<T,P> (x, y);
+            }
+        }
+    }
+}
+
+
+// Coefficients (lowest degree first) of the polynomial Prod(x - roots[i]) for i=0..n-1
+template <typename T, T P>
+std::vector<T> PolyFromRoots (const T* roots, size_t n)
+{
+    if (n <= 64) {
+        // Multiply by (x - root) one by one
+        std::vector<T> poly(n+1, 0);
+        poly[0] = 1;
+        for (size_t i=0; i<n; i++) {
+            for (size_t k=i+1; k>0; k--)
+                poly[k] = GF_Sub<T,P> (poly[k-1], GF_Mul<T,P> (poly[k], roots[i]));
+            poly[0] = GF_Sub<T,P> (0, GF_Mul<T,P> (poly[0], roots[i]));
+        }
+        return poly;
+    }
+
+    // Multiply two halves of the product using NTT
+    std::vector<T> a = PolyFromRoots<T,P> (roots, n/2),  b = PolyFromRoots<T,P> (roots + n/2, n - n/2);
+    size_t size = NextPow2(n+1);
+    a.resize(size);  ScalarNTT<T,P> (a, false);
+    b.resize(size);  ScalarNTT<T,P> (b, false);
+    for (size_t i=0; i<size; i++)
+        a[i] = GF_Mul<T,P> (a[i], b[i]);
+    ScalarNTT<T,P> (a, true);
+
+    T inv_size = GF_Inv<T,P>(size);
+    a.resize(n+1);
+    for (size_t i=0; i<=n; i++)
+        a[i] = GF_Mul<T,P> (a[i], inv_size);
+    return a;
+}
+
+
+// Erasure locator polynomial Lambda(x) = Prod(x - root(2*N)**e) over all erased positions e of the codeword.
+// Position 2*i holds i-th data block, position 2*i+1 holds i-th parity block.
+// It depends only on the erasure pattern, so it may be computed once and reused for many codewords.
+template <typename T, T P>
+struct ErasureLocator
+{
+    std::vector<T> Value;           // Lambda(root(2*N)**x) for all 2*N positions x
+    std::vector<T> InvDerivative;   // 1/Lambda'(root(2*N)**x) for erased positions x, 0 for other positions
+
+    void Init (size_t N, const std::vector<size_t>& erased)
+    {
+        T root_2N = GF_Root<T,P>(2*N);
+        std::vector<T> roots;
+        for (size_t x : erased)
+            roots.push_back (GF_Pow<T,P> (root_2N, x));
+
+        // Evaluate Lambda(x) and Lambda'(x) at all 2*N points
+        std::vector<T> poly = PolyFromRoots<T,P> (&roots[0], roots.size());
+        std::vector<T> derivative(2*N, 0);
+        for (size_t k=1; k<poly.size(); k++)
+            derivative[k-1] = GF_Mul<T,P> (poly[k], T(k));
+        poly.resize(2*N, 0);
+        ScalarNTT<T,P> (poly, false);
+        ScalarNTT<T,P> (derivative, false);
+
+        Value = poly;
+        InvDerivative.assign(2*N, 0);
+        for (size_t x : erased)
+            InvDerivative[x] = GF_Inv<T,P> (derivative[x]);
+    }
+};
+
+
+// Recover erased blocks using the Reed-Solomon algo in O(N*log(N)):
+//   codeword[x] points to the block at position x of the order-2N codeword, or nullptr if the block is zero or erased
+//   work[] points to 2*N blocks of workspace. On return, work[x] points to the recovered block x for each x in `recover`
+//
+// Codeword is the evaluation of order-N polynomial f(x) at 2N points root(2*N)**x. Let g(x) = f(x)*Lambda(x),
+// then g(x) is zero at erased points and known at all other points, and its degree is < 2N.
+// Since Lambda(e)==0 for erased e, we have g'(e) = f(e)*Lambda'(e), so we can compute f(e) = g'(e)/Lambda'(e).
+template <typename T, T P>
+void DecodeReedSolomon (size_t N, size_t SIZE, T **codeword, T **work, const ErasureLocator<T,P>& locator, const std::vector<size_t>& recover,
+                        const NTTPlan<T,P>& plan)
+{
+    // 1. Compute g(x) at all 2N points
+    #pragma omp parallel for
+    for (ptrdiff_t x=0; x<2*N; x++) {
+        if (codeword[x])
+            FastField<T,P>::MulBlock (plan.Kernel, work[x], codeword[x], FastField<T,P>::MakeConst (locator.Value[x]), SIZE);
+        else
+            memset (work[x], 0, SIZE*sizeof(T));
+    }
+
+    // 2. iNTT: find coefficients of g(x), multiplied by 2N. Coefficient k is placed at the position bit_reverse(k)
+    NTT_DIF<T,P> (work, 2*N, &plan.InvRoot[0], 1, SIZE, plan.Kernel, plan.TileBytes);
+
+    // 3. Formal derivative: g'[k-1] = g[k]*k. Division by 2N is combined with this multiplication.
+    // Coefficients are shifted by moving pointers rather than data, keeping the bit-reversed order for the DIT NTT
+    T inv_2N = GF_Inv<T,P>(2*N);
+    std::vector<T*> coef(work, work + 2*N);
+    #pragma omp parallel for
+    for (ptrdiff_t k=1; k<2*N; k++) {
+        T* block = coef[bit_reverse(k,2*N)];
+        FastField<T,P>::MulBlock (plan.Kernel, block, block, FastField<T,P>::MakeConst (GF_Mul<T,P> (inv_2N, T(k))), SIZE);
+        work[bit_reverse(k-1,2*N)] = block;
+    }
+    memset (coef[0], 0, SIZE*sizeof(T));
+    work[2*N-1] = coef[0];
+
+    // 4. NTT: evaluate g'(x) at all 2N points
+    NTT_DIT<T,P> (work, 2*N, &plan.Root[0], 1, SIZE, plan.Kernel, plan.TileBytes);
+
+    // 5. f(e) = g'(e)/Lambda'(e)
+    for (size_t x : recover) {
+        FastField<T,P>::MulBlock (plan.Kernel, work[x], work[x], FastField<T,P>::MakeConst (locator.InvDerivative[x]), SIZE);
+    }
+}
+
+
+// Stripe encoder reusing its NTT workspace for all stripes.
+// Recovery data are computed in the first RecoveryCount blocks, so we point them directly to the output,
+// and keep only the remaining blocks in our own workspace. The decoder workspace of 2N blocks is allocated on the first decoding
+template <typename T, T P>
+class FastECCStripeCodec : public StripeCodec
+{
+public:
+    explicit FastECCStripeCodec(ECC_bench_params params)
+        : Params(params),
+          N(NextPow2( std::max( params.OriginalCount, params.RecoveryCount))),
+          SIZE(params.BlockBytes / sizeof(T)),
+          Work((N - params.RecoveryCount) * params.BlockBytes),
+          Data(N)
+    {
+        for (size_t i=params.RecoveryCount; i<N; i++)
+            Data[i] = (T*) Work.data() + (i-params.RecoveryCount)*SIZE;
+        Plan.Init (N, FastField<T,P>::BestKernel(params.Isa), params.FastECCTileBytes);
+    }
+
+    bool Encode(uint8_t* original, uint8_t* recovery) override
+    {
+        for (size_t i=0; i<Params.RecoveryCount; i++)
+            Data[i] = (T*) recovery + i*SIZE;
+
+        // Algorithm overwrites data in-place, so we copy them into the workspace, conditioning words >= P
+        const T* source = (const T*) original;
+        Escapes.clear();
+        for (size_t i=0; i<Params.OriginalCount; i++) {
+            fastecc_condition_data<T,P> (Data[i], source + i*SIZE, SIZE, i*SIZE, Escapes);
+        }
+        EncodeReedSolomonFast<T,P> (N, Params.OriginalCount, Params.RecoveryCount, SIZE, &Data[0], Plan);
+        return true;
+    }
+
+    // Data blocks occupy even positions of the order-2N codeword, and parity blocks occupy odd positions.
+    // Available data blocks are conditioned into the workspace, so they stay intact, and words >= P of the recovered blocks
+    // are restored from the escapes of the last encoded stripe
+    bool Decode(uint8_t* original, uint8_t* recovery, const std::vector<char>& lost) override
+    {
+        if (! DecodeWork) {
+            DecodeWork.reset(new AlignedBuffer(2*N * Params.BlockBytes));
+        }
+        std::vector<T*> work(2*N);
+        for (size_t x=0; x<2*N; x++)
+            work[x] = (T*) DecodeWork->data() + x*SIZE;
+
+        // DecodeReedSolomon() multiplies each available block into its own work block, so they can be the same
+        std::vector<size_t> erased, recover, escapes;
+        std::vector<T*> codeword(2*N, nullptr);
+        for (size_t i=0; i<Params.OriginalCount; i++) {
+            if (lost[i]) {
+                recover.push_back(2*i);
+            } else {
+                fastecc_condition_data<T,P> (work[2*i], (const T*) original + i*SIZE, SIZE, i*SIZE, escapes);
+                codeword[2*i] = work[2*i];
+            }
+        }
+        erased = recover;
+        for (size_t i=0; i<N; i++) {
+            if (i < Params.RecoveryCount  &&  ! lost[Params.OriginalCount+i])
+                codeword[2*i+1] = (T*) recovery + i*SIZE;
+            else
+                erased.push_back(2*i+1);
+        }
+        if (erased.size() > N)   // the order-N polynomial requires N known points
+            return false;
+
+        ErasureLocator<T,P> locator;
+        locator.Init (N, erased);
+        DecodeReedSolomon<T,P> (N, SIZE, &codeword[0], &work[0], locator, recover, Plan);
+        for (size_t x : recover)
+            memcpy (original + (x/2)*Params.BlockBytes, work[x], Params.BlockBytes);
+
+        T* words = (T*) original;
+        for (size_t e : Escapes)
+            if (lost[e/SIZE])  words[e] += P;
+        return true;
+    }
+
+private:
+    ECC_bench_params Params;
+    size_t N, SIZE;
+    AlignedBuffer Work;
+    std::vector<T*> Data;
+    NTTPlan<T,P> Plan;
+    std::vector<size_t> Escapes;   // positions of the original words >= P in the last encoded stripe, kept along with its parity
+    std::unique_ptr<AlignedBuffer> DecodeWork;
+};
+
+
+std::unique_ptr<StripeCodec> fastecc_create_stripe_codec(ECC_bench_params params)
+{
+    if (params.FastECCBits == 64)
+        return std::unique_ptr<StripeCodec>(new FastECCStripeCodec<uint64_t,0xFFFFFFFF00000001> (params));
+    return std::unique_ptr<StripeCodec>(new FastECCStripeCodec<uint32_t,0xFFF00001> (params));
+}
+
+std::unique_ptr<StripeEncoder> fastecc_create_stripe_encoder(ECC_bench_params params)
+{
+    return fastecc_create_stripe_codec(params);
+}
+
+
+// Compute 1/x for all elements of the array using single inversion (Montgomery's trick)
+template <typename T, T P>
+void BatchInverse (std::vector<T>& x)
+{
+    std::vector<T> prefix(x.size());
+    T product = 1;
+    for (size_t i=0; i<x.size(); i++) {
+        prefix[i] = product;
+        product = GF_Mul<T,P> (product, x[i]);
+    }
+    T inv = GF_Inv<T,P> (product);
+    for (size_t i=x.size(); i-- > 0; ) {
+        T inv_i = GF_Mul<T,P> (inv, prefix[i]);
+        inv = GF_Mul<T,P> (inv, x[i]);
+        x[i] = inv_i;
+    }
+}
+
+
+// Recover a few erased blocks directly by Lagrange interpolation. Each recovered block is a linear combination
+// of K surviving blocks, so recovery of L blocks requires O(L*K) operations per element, plus O(N*log(N)**2)
+// to compute the coefficients. It's faster than DecodeReedSolomon for small L,
+// since NTT-based decoding time doesn't depend on the number of erasures.
+template <typename T, T P>
+struct MatrixDecoder
 {
-    // Total encode/decode times
-    OperationTimer encode_time, decode_one_time, decode_all_time;
+    std::vector<size_t> Sources;    // positions of nonzero blocks used for recovery
+    std::vector<size_t> Recover;    // positions of blocks to recover
+    std::vector<T> Coef;            // Coef[r*Sources.size()+s]: multiplier of block Sources[s] in the recovered block Recover[r]
 
+    // Prepare recovery of erased data blocks `recover`. `erased` lists all positions, missing in the codeword of order N
+    // (including recover[] and parity blocks that aren't stored). Return false if there is not enough blocks for recovery
+    bool Init (size_t N, size_t K, const std::vector<size_t>& erased, const std::vector<size_t>& recover)
+    {
+        // The polynomial has order N, so we need exactly N known points: all data blocks that aren't lost,
+        // zero blocks following them, and a parity block per each lost data block.
+        // All other points are "erased" from the viewpoint of Lagrange interpolation
+        std::vector<char> known(2*N, true);
+        for (size_t x : erased)
+            known[x] = false;
+        Sources.clear();
+        size_t parity_blocks = 0;
+        for (size_t x=0; x<2*N; x++) {
+            if (! known[x])  continue;
+            if (x%2) {
+                if (parity_blocks == recover.size()) {
+                    known[x] = false;
+                    continue;
+                }
+                parity_blocks++;
+            }
+            if (x%2  ||  x/2 < K)
+                Sources.push_back(x);
+        }
+        if (parity_blocks < recover.size())
+            return false;
+
+        std::vector<size_t> unknown;
+        for (size_t x=0; x<2*N; x++)
+            if (! known[x])
+                unknown.push_back(x);
+        ErasureLocator<T,P> locator;
+        locator.Init (N, unknown);
+
+        // Points root(2*N)**x
+        std::vector<T> point(2*N);
+        T root_2N = GF_Root<T,P>(2*N);
+        point[0] = 1;
+        for (size_t x=1; x<2*N; x++)
+            point[x] = GF_Mul<T,P> (point[x-1], root_2N);
+
+        // With S = known points, E = unknown points, Z(x) = x**(2N)-1 = Prod_S(x-x_s) * Lambda_E(x),
+        // Lagrange coefficient of the point s for the point e simplifies to
+        // x_s * Lambda_E(x_s) / (x_e * Lambda_E'(x_e) * (x_e-x_s))
+        Recover = recover;
+        Coef.resize (Recover.size() * Sources.size());
+        for (size_t r=0; r<Recover.size(); r++)
+            for (size_t s=0; s<Sources.size(); s++)
+                Coef[r*Sources.size()+s] = GF_Sub<T,P> (point[Recover[r]], point[Sources[s]]);
+        BatchInverse<T,P> (Coef);
+
+        for (size_t r=0; r<Recover.size(); r++) {
+            size_t e = Recover[r];
+            T multiplier = GF_Mul<T,P> (locator.InvDerivative[e], point[(2*N-e) % (2*N)]);   // 1/(x_e * Lambda_E'(x_e))
+            for (size_t s=0; s<Sources.size(); s++) {
+                size_t x = Sources[s];
+                T c = GF_Mul<T,P> (GF_Mul<T,P> (point[x], locator.Value[x]), multiplier);
+                Coef[r*Sources.size()+s] = GF_Mul<T,P> (Coef[r*Sources.size()+s], c);
+            }
+        }
+        return true;
+    }
+
+    // Recover blocks Recover[r] from the codeword into output[r], using the same kernel as the NTT
+    void Decode (FastECCKernel kernel, size_t SIZE, T **codeword, T **output)
+    {
+        for (size_t r=0; r<Recover.size(); r++)
+            memset (output[r], 0, SIZE*sizeof(T));
+
+        // Read each source block once and add it to all recovered blocks
+        for (size_t s=0; s<Sources.size(); s++) {
+            const T* src = codeword[Sources[s]];
+            for (size_t r=0; r<Recover.size(); r++) {
+                FastField<T,P>::MulAddBlock (kernel, output[r], src, FastField<T,P>::MakeConst (Coef[r*Sources.size()+s]), SIZE);
+            }
+        }
+    }
+};
+
+
+// Fill the workspace and prepare the codeword to decode: data blocks at even positions, parity blocks at odd positions.
+// Data blocks past OriginalCount are zeroes, parity blocks past RecoveryCount are never stored.
+// data[] points to N blocks of the encoder workspace, codeword[] points to 2N blocks of the codeword
+template <typename T, T P>
+void fastecc_prepare_codeword(ECC_bench_params params, uint8_t* buffer, std::vector<T*>& data, std::vector<T*>& codeword)
+{
     size_t N = NextPow2( std::max( params.OriginalCount, params.RecoveryCount));   // NTT order
     size_t SIZE = params.BlockBytes / sizeof(T);
 
@@ -75,23 +1303,435 @@ bool fastecc_benchmark_specialize(ECC_bench_params params, uint8_t* buffer)
         data0[i] = (i < P? i : i%P);
     }
 
-    T **data = new T* [N];      // pointers to blocks
+    data.resize(N);             // pointers to blocks
     for (size_t i=0; i<N; i++)
         data[i] = data0 + i*SIZE;
 
-    printf("FastECC 0x%llx %d-bit\n", (unsigned long long)P, sizeof(T)*8);
+    T *codeword0 = data0 + 2*N*SIZE;
+    codeword.assign(2*N, nullptr);
+    for (size_t i=0; i<params.OriginalCount; i++) {
+        codeword[2*i] = codeword0 + i*SIZE;
+        memcpy (codeword[2*i], data[i], params.BlockBytes);
+    }
+    for (size_t i=params.OriginalCount; i<N; i++) {
+        memset (data[i], 0, params.BlockBytes);
+    }
+    EncodeReedSolomon<T,P> (N, SIZE, &data[0]);
+    for (size_t i=0; i<params.RecoveryCount; i++) {
+        codeword[2*i+1] = codeword0 + (params.OriginalCount+i)*SIZE;
+        memcpy (codeword[2*i+1], data[i], params.BlockBytes);
+    }
+}
+
+
+// Erasure pattern losing the first `lost` data blocks. Parity blocks past RecoveryCount are never stored, so they are erased too
+void fastecc_erasure_pattern(ECC_bench_params params, size_t lost, std::vector<size_t>& erased, std::vector<size_t>& recover)
+{
+    size_t N = NextPow2( std::max( params.OriginalCount, params.RecoveryCount));   // NTT order
+    recover.clear();
+    for (size_t i=0; i<lost; i++)
+        recover.push_back(2*i);
+    erased = recover;
+    for (size_t i=params.RecoveryCount; i<N; i++)
+        erased.push_back(2*i+1);
+}
+
+
+// Fill the encoder workspace with the data blocks of the codeword, and zero blocks after them
+template <typename T, T P>
+void fastecc_load_data(ECC_bench_params params, T** data, T** codeword)
+{
+    size_t N = NextPow2( std::max( params.OriginalCount, params.RecoveryCount));   // NTT order
+    for (size_t i=0; i<params.OriginalCount; i++)
+        memcpy (data[i], codeword[2*i], params.BlockBytes);
+    for (size_t i=params.OriginalCount; i<N; i++)
+        memset (data[i], 0, params.BlockBytes);
+}
+
+
+// Check that the encoder computed the same parity blocks as the library encoder
+template <typename T, T P>
+bool fastecc_check_parity(ECC_bench_params params, T** data, T** codeword, const char* encoder)
+{
+    for (size_t i=0; i<params.RecoveryCount; i++) {
+        if (memcmp (data[i], codeword[2*i+1], params.BlockBytes)) {
+            printf("  FastECC %s encoder failed: parity block %d doesn't match the library encoder\n", encoder, int(i));
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Perform single decoding operation, return false if it fails
+template <typename T, T P>
+bool fastecc_benchmark_decode(
+    ECC_bench_params params,
+    size_t N,
+    T** codeword,
+    T* work0,
+    const NTTPlan<T,P>& plan,
+    const std::vector<size_t>& erased,
+    const std::vector<size_t>& recover,
+    OperationTimer& decode_time,
+    OperationTimer* setup_time = nullptr,
+    OperationTimer* data_time = nullptr)
+{
+    size_t SIZE = params.BlockBytes / sizeof(T);
+
+    // Erased blocks are absent in the codeword
+    std::vector<T*> available(codeword, codeword + 2*N);
+    for (size_t x : erased)
+        available[x] = nullptr;
+
+    std::vector<T*> work(2*N);
+    for (size_t i=0; i<2*N; i++)
+        work[i] = work0 + i*SIZE;
+
+    // Optional timers split the decoding into the setup for the erasure pattern and the data processing
+    decode_time.BeginCall();
+    if (setup_time)  setup_time->BeginCall();
+    ErasureLocator<T,P> locator;
+    locator.Init (N, erased);
+    if (setup_time)  setup_time->EndCall();
+    if (data_time)   data_time->BeginCall();
+    DecodeReedSolomon<T,P> (N, SIZE, &available[0], &work[0], locator, recover, plan);
+    if (data_time)   data_time->EndCall();
+    decode_time.EndCall();
+
+    // Check the recovered data, but only once since it's slow
+    if (! decode_time.Checked) {
+        decode_time.Checked = true;
+        for (size_t x : recover) {
+            if (memcmp (work[x], codeword[x], params.BlockBytes)) {
+                printf("  FastECC decode failed: recovered block %d doesn't match original data\n", int(x/2));
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+// Timers of all operations: decoding is also measured separately as the erasure locator setup and the data processing
+struct FastECCTimers
+{
+    OperationTimer encode;
+    OperationTimer decode_one, decode_one_setup, decode_one_data;
+    OperationTimer decode_all, decode_all_setup, decode_all_data;
+};
+
+
+// Run all benchmark trials on a single codeword, return false if anything failed
+template <typename T, T P>
+bool fastecc_benchmark_trials(
+    ECC_bench_params params,
+    uint8_t* buffer,
+    FastECCTimers& timers)
+{
+    size_t N = NextPow2( std::max( params.OriginalCount, params.RecoveryCount));   // NTT order
+    size_t SIZE = params.BlockBytes / sizeof(T);
+    T *data0 = (T*) (buffer + params.OriginalFileBytes());
+
+    std::vector<T*> data, codeword;
+    fastecc_prepare_codeword<T,P> (params, buffer, data, codeword);
+    NTTPlan<T,P> plan;
+    plan.Init (N, FastField<T,P>::BestKernel(params.Isa), params.FastECCTileBytes);
+
+    // Erasure patterns: lose the first data block, or as much data blocks as possible
+    std::vector<size_t> erased_one, recover_one, erased_all, recover_all;
+    fastecc_erasure_pattern (params, 1, erased_one, recover_one);
+    fastecc_erasure_pattern (params, std::min(params.OriginalCount, params.RecoveryCount), erased_all, recover_all);
+
+    // Repeat benchmark multiple times to improve its accuracy
+    for (TrialLoop trial(params); trial.Next(); )
+    {
+        // Generate recovery data. Workspace is overwritten by the decoder, so the original data are restored only for the check
+        if (trial.Trial == 1)
+            fastecc_load_data<T,P> (params, &data[0], &codeword[0]);
+        timers.encode.BeginCall();
+        EncodeReedSolomonFast<T,P> (N, params.OriginalCount, params.RecoveryCount, SIZE, &data[0], plan);
+        timers.encode.EndCall();
+        if (trial.Trial == 1  &&  ! fastecc_check_parity<T,P> (params, &data[0], &codeword[0], fastecc_kernel_name[plan.Kernel])) {
+            return false;
+        }
+
+        if (! fastecc_benchmark_decode<T,P> (params, N, &codeword[0], data0, plan, erased_one, recover_one,
+                                             timers.decode_one, &timers.decode_one_setup, &timers.decode_one_data)) {
+            return false;
+        }
+        if (! fastecc_benchmark_decode<T,P> (params, N, &codeword[0], data0, plan, erased_all, recover_all,
+                                             timers.decode_all, &timers.decode_all_setup, &timers.decode_all_data)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// Perform single hybrid decoding operation: matrix decoding for less than `crossover` lost blocks,
+// and NTT decoding for larger amounts. Return false if it fails
+template <typename T, T P>
+bool fastecc_benchmark_hybrid_decode(
+    ECC_bench_params params,
+    size_t N,
+    T** codeword,
+    T* work0,
+    const NTTPlan<T,P>& plan,
+    const std::vector<size_t>& erased,
+    const std::vector<size_t>& recover,
+    size_t crossover,
+    OperationTimer& decode_time)
+{
+    if (recover.size() >= crossover)
+        return fastecc_benchmark_decode<T,P> (params, N, codeword, work0, plan, erased, recover, decode_time);
+
+    size_t SIZE = params.BlockBytes / sizeof(T);
+    std::vector<T*> output(recover.size());
+    for (size_t r=0; r<recover.size(); r++)
+        output[r] = work0 + r*SIZE;
+
+    decode_time.BeginCall();
+    MatrixDecoder<T,P> decoder;
+    if (! decoder.Init (N, params.OriginalCount, erased, recover)) {
+        printf("  FastECC matrix decoder failed: not enough blocks for recovery\n");
+        return false;
+    }
+    decoder.Decode (plan.Kernel, SIZE, codeword, &output[0]);
+    decode_time.EndCall();
+
+    // Check the recovered data, but only once since it's slow
+    if (! decode_time.Checked) {
+        decode_time.Checked = true;
+        for (size_t r=0; r<recover.size(); r++) {
+            if (memcmp (output[r], codeword[recover[r]], params.BlockBytes)) {
+                printf("  FastECC matrix decoder failed: recovered block %d doesn't match original data\n", int(recover[r]/2));
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+// Find the smallest number of lost blocks for which matrix decoding is slower than NTT decoding,
+// or 0 if any decoding fails
+template <typename T, T P>
+size_t fastecc_hybrid_crossover(ECC_bench_params params, size_t N, T** codeword, T* work0, const NTTPlan<T,P>& plan)
+{
+    const int REPEATS = 3;   // use the best time of a few runs
+    size_t max_lost = std::min(params.OriginalCount, params.RecoveryCount);
+    std::vector<size_t> erased, recover;
+
+    // NTT decoding time doesn't depend on the number of lost blocks
+    OperationTimer ntt_time(0);   // no warmup, since only the best time is used
+    fastecc_erasure_pattern (params, max_lost, erased, recover);
+    for (int i = 0; i < REPEATS; ++i)
+        if (! fastecc_benchmark_decode<T,P> (params, N, codeword, work0, plan, erased, recover, ntt_time))
+            return 0;
+
+    // A failed matrix decoding stops the search, and the crossover is reported as 0
+    bool failed = false;
+    auto matrix_is_faster = [&](size_t lost) {
+        if (failed)
+            return false;
+        OperationTimer matrix_time(0);
+        fastecc_erasure_pattern (params, lost, erased, recover);
+        for (int i = 0; i < REPEATS; ++i)
+            if (! fastecc_benchmark_hybrid_decode<T,P> (params, N, codeword, work0, plan, erased, recover, SIZE_MAX, matrix_time)) {
+                failed = true;
+                return false;
+            }
+        return matrix_time.MinCallUsec < ntt_time.MinCallUsec;
+    };
+
+    // Exponential search followed by binary search
+    size_t faster = 0, slower = 1;
+    while (slower <= max_lost  &&  matrix_is_faster(slower)) {
+        faster = slower;
+        slower *= 2;
+    }
+    if (slower > max_lost) {
+        if (faster == max_lost  ||  matrix_is_faster(max_lost))
+            return failed? 0 : max_lost+1;
+        slower = max_lost;
+    }
+    while (slower - faster > 1) {
+        size_t middle = (faster + slower) / 2;
+        if (matrix_is_faster(middle))
+            faster = middle;
+        else
+            slower = middle;
+    }
+    return failed? 0 : slower;
+}
+
+
+// Benchmark hybrid decoder that employs matrix decoding when it's faster than NTT decoding
+template <typename T, T P>
+bool fastecc_benchmark_hybrid(ECC_bench_params params, uint8_t* buffer)
+{
+    size_t N = NextPow2( std::max( params.OriginalCount, params.RecoveryCount));   // NTT order
+    T *data0 = (T*) (buffer + params.OriginalFileBytes());
+
+    std::vector<T*> data, codeword;
+    fastecc_prepare_codeword<T,P> (params, buffer, data, codeword);
+    NTTPlan<T,P> plan;
+    plan.Init (N, FastField<T,P>::BestKernel(params.Isa), params.FastECCTileBytes);
+
+    size_t crossover = fastecc_hybrid_crossover<T,P> (params, N, &codeword[0], data0, plan);
+    if (crossover == 0)
+        return false;
+    printf("  hybrid crossover: matrix decoding for up to %d lost blocks\n", int(crossover-1));
+
+    std::vector<size_t> erased_one, recover_one, erased_all, recover_all;
+    fastecc_erasure_pattern (params, 1, erased_one, recover_one);
+    fastecc_erasure_pattern (params, std::min(params.OriginalCount, params.RecoveryCount), erased_all, recover_all);
 
     // Repeat benchmark multiple times to improve its accuracy
-    for (int trial = 0; trial < params.Trials; ++trial)
+    OperationTimer decode_one_time, decode_all_time;
+    for (TrialLoop trial(params); trial.Next(); )
+    {
+        if (! fastecc_benchmark_hybrid_decode<T,P> (params, N, &codeword[0], data0, plan, erased_one, recover_one, crossover, decode_one_time)) {
+            return false;
+        }
+        if (! fastecc_benchmark_hybrid_decode<T,P> (params, N, &codeword[0], data0, plan, erased_all, recover_all, crossover, decode_all_time)) {
+            return false;
+        }
+    }
+
+    decode_one_time.Print("decode one hybrid", params.BlockBytes);
+    decode_all_time.Print("decode all hybrid", params.RecoveryDataBytes());
+
+    return true;
+}
+
+
+// Compare encoding speed of the library NTT and our NTT with each kernel, return false if anything failed
+template <typename T, T P>
+bool fastecc_benchmark_kernels(ECC_bench_params params, uint8_t* buffer)
+{
+    size_t N = NextPow2( std::max( params.OriginalCount, params.RecoveryCount));   // NTT order
+    size_t SIZE = params.BlockBytes / sizeof(T);
+
+    std::vector<T*> data, codeword;
+    fastecc_prepare_codeword<T,P> (params, buffer, data, codeword);
+
+    // Kernel -1 is the original encoder built on the library NTT, then each kernel with the pruned NTT,
+    // and finally the best kernel with the tiled pruned NTT and with the full (unpruned) NTT
+    FastECCKernel best_kernel = FastField<T,P>::BestKernel(params.Isa);
+    double untiled_usec = 0;   // median time of the pruned NTT with the best kernel
+    for (int k = -1; k <= FASTECC_KERNELS+1; ++k)
     {
-        // Generate recovery data
-        encode_time.BeginCall();
-        EncodeReedSolomon<T,P> (N, SIZE, data);
-        encode_time.EndCall();
+        NTTPlan<T,P> plan;
+        char name[64] = "library";
+        size_t K = params.OriginalCount,  M = params.RecoveryCount;
+        if (k >= 0  &&  k < FASTECC_KERNELS) {
+            if (! FastField<T,P>::HasKernel(FastECCKernel(k), params.Isa))
+                continue;
+            plan.Init (N, FastECCKernel(k), 0);
+            snprintf(name, sizeof(name), "%s", fastecc_kernel_name[k]);
+        } else if (k == FASTECC_KERNELS) {
+            size_t tile_bytes = (params.FastECCTileBytes? params.FastECCTileBytes : FASTECC_DEFAULT_TILE_BYTES);
+            plan.Init (N, best_kernel, tile_bytes);
+            snprintf(name, sizeof(name), "%s tiled %dK", fastecc_kernel_name[plan.Kernel], int(tile_bytes >> 10));
+        } else if (k == FASTECC_KERNELS+1) {
+            if (K == N  &&  M == N)
+                continue;
+            plan.Init (N, best_kernel, 0);
+            snprintf(name, sizeof(name), "%s unpruned", fastecc_kernel_name[plan.Kernel]);
+            K = M = N;
+        }
+
+        OperationTimer encode_time;
+        for (TrialLoop trial(params); trial.Next(); )
+        {
+            if (trial.Trial == 1)
+                fastecc_load_data<T,P> (params, &data[0], &codeword[0]);
+            encode_time.BeginCall();
+            if (k >= 0)
+                EncodeReedSolomonFast<T,P> (N, K, M, SIZE, &data[0], plan);
+            else
+                EncodeReedSolomon<T,P> (N, SIZE, &data[0]);
+            encode_time.EndCall();
+            if (trial.Trial == 1  &&  ! fastecc_check_parity<T,P> (params, &data[0], &codeword[0], name)) {
+                return false;
+            }
+        }
+
+        char operation[64];
+        snprintf(operation, sizeof(operation), "encode %s", name);
+        encode_time.Print(operation, params.OriginalFileBytes());
+
+        // Compare the pruned NTT with and without tiling
+        double median_usec = encode_time.Stats().MedianUsec;
+        if (k == best_kernel)
+            untiled_usec = median_usec;
+        else if (k == FASTECC_KERNELS  &&  untiled_usec > 0  &&  median_usec > 0) {
+            size_t tile_width;
+            printf("  encode %s tiled vs untiled: %+.1lf%% speed%s\n", fastecc_kernel_name[best_kernel], (untiled_usec / median_usec - 1) * 100,
+                ntt_tile_blocks<T> (N, SIZE, plan.TileBytes, tile_width)? "" : " (the NTT fits into the tile, so it isn't tiled)");
+        }
+    }
+
+    return true;
+}
+
+
+template <typename T, T P>
+bool fastecc_benchmark_specialize(ECC_bench_params params, uint8_t* buffer)
+{
+    printf("FastECC 0x%llx %d-bit (%s):\n", (unsigned long long)P, int(sizeof(T)*8), fastecc_kernel_name[FastField<T,P>::BestKernel(params.Isa)]);
+
+    // One-time setup: twiddle factors of the NTT, shared by all codewords of the same size
+    {
+        size_t N = NextPow2( std::max( params.OriginalCount, params.RecoveryCount));
+        OperationTimer init_time(0);
+        NTTPlan<T,P> plan;
+        init_time.BeginCall();
+        plan.Init (N, FastField<T,P>::BestKernel(params.Isa), params.FastECCTileBytes);
+        init_time.EndCall();
+        init_time.PrintTime("init");
+    }
+
+    FastECCTimers timers;
+    if (! fastecc_benchmark_trials<T,P> (params, buffer, timers)) {
+        return false;
     }
 
     // Benchmark reports for each operation
-    encode_time.Print("encode", params.OriginalFileBytes());
+    timers.encode.Print("encode", params.OriginalFileBytes());
+    timers.decode_one.Print("decode one", params.BlockBytes);
+    timers.decode_one_setup.PrintTime("decode one setup");
+    timers.decode_one_data.Print("decode one data", params.BlockBytes);
+    timers.decode_all.Print("decode all", params.RecoveryDataBytes());
+    timers.decode_all_setup.PrintTime("decode all setup");
+    timers.decode_all_data.Print("decode all data", params.RecoveryDataBytes());
+
+    if (! fastecc_benchmark_hybrid<T,P> (params, buffer)) {
+        return false;
+    }
+
+    if (! fastecc_benchmark_kernels<T,P> (params, buffer)) {
+        return false;
+    }
+
+    // Repeat the same benchmark on multiple cores simultaneously, each thread processing its own codeword
+    if (params.Threads > 1)
+    {
+        if (! run_scaling_on_threads(params, buffer, timers,
+                [&](uint8_t* thread_buffer, FastECCTimers& thread_timers) {
+                    return fastecc_benchmark_trials<T,P> (params, thread_buffer, thread_timers);
+                },
+                {{"encode", &FastECCTimers::encode, params.OriginalFileBytes()},
+                 {"decode one", &FastECCTimers::decode_one, uint64_t(params.BlockBytes)},
+                 {"decode all", &FastECCTimers::decode_all, params.RecoveryDataBytes()}})) {
+            return false;
+        }
+    }
 
     return true;
 }
@@ -100,5 +1740,9 @@ bool fastecc_benchmark_specialize(ECC_bench_params params, uint8_t* buffer)
 // Benchmark library and print results, return false if anything failed
 bool fastecc_benchmark_main(ECC_bench_params params, uint8_t* buffer)
 {
+    if (params.FastECCBits == 64)
+        return fastecc_benchmark_specialize<uint64_t,0xFFFFFFFF00000001> (params, buffer);
     return fastecc_benchmark_specialize<uint32_t,0xFFF00001> (params, buffer);
 }
+
+ISA_BUILD_END
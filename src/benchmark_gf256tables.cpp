@@ -0,0 +1,938 @@
+//
+// Table-driven GF(2^8) Reed-Solomon codec in the style of Intel ISA-L: https://github.com/intel/isa-l
+// The coding matrix is converted once into split-nibble multiplication tables (like ec_init_tables),
+// then each stripe is processed with PSHUFB table lookups only (like ec_encode_data).
+// The encoding matrix is the Cauchy matrix of CM256, so its first parity row is XOR-only.
+// Kernels are selected at runtime among scalar, SSSE3, AVX2, AVX-512 (VPSHUFB on 64 bytes) and GFNI (GF2P8AFFINEQB) ones.
+// The last two are compiled with target attributes, so they are available in any x86 build on CPUs supporting them
+//
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "common.h"
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__))  &&  (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define GF256TABLES_HAVE_AVX512
+#define GF256TABLES_TARGET_AVX512  __attribute__((target("avx512f,avx512bw")))
+#define GF256TABLES_TARGET_GFNI    __attribute__((target("avx512f,avx512bw,gfni")))
+#endif
+
+ISA_BUILD_BEGIN
+
+
+// GF(2^8) limits the total number of blocks
+bool gf256tables_supports(ECC_bench_params params)
+{
+    return params.OriginalCount + params.RecoveryCount <= 256;
+}
+
+
+// Extra workspace used by the library on top of place required for original data:
+// recovery blocks plus recovered blocks
+size_t gf256tables_extra_space(ECC_bench_params params)
+{
+    return 2 * params.RecoveryDataBytes();
+}
+
+
+// Original and recovery blocks, plus nibble tables and GFNI matrices of all coefficients
+size_t gf256tables_encode_working_set(ECC_bench_params params)
+{
+    return params.OriginalFileBytes() + params.RecoveryDataBytes() + size_t(32 + 8) * params.OriginalCount * params.RecoveryCount;
+}
+
+// Multiplication tables of a Rows x Sources coding matrix. For each coefficient c, 32 bytes:
+// products c*x for the low nibble x, followed by products c*(x<<4) for the high nibble,
+// so c*y = table[y & 15] ^ table[16 + (y >> 4)]
+struct GF256Tables
+{
+    int Sources = 0;
+    int Rows = 0;
+    std::vector<uint8_t> Tables;   // 32*(r*Sources+s): tables of the coefficient of source s in row r
+    std::vector<uint64_t> Affine;  // r*Sources+s: the same coefficient as a bit matrix for the GFNI kernel
+    std::vector<int> XorRows;      // rows with all coefficients equal to 1, computed with XOR only
+    std::vector<int> MulRows;      // all other rows
+};
+
+
+// Multiplication by c in GF(2^8) is linear over GF(2), i.e. it's a multiplication by 8x8 bit matrix.
+// GF2P8AFFINEQB computes bit i of the result as parity of (x AND byte 7-i of the matrix),
+// so byte 7-i contains the input bits contributing to the output bit i.
+// Unlike GF2P8MULB, it doesn't depend on the field polynomial
+static uint64_t gf256tables_affine_matrix(uint8_t c)
+{
+    uint64_t matrix = 0;
+    for (int j = 0; j < 8; ++j) {
+        uint8_t column = gf256_mul(c, uint8_t(1 << j));   // image of the input bit j
+        for (int i = 0; i < 8; ++i)
+            if (column & (1 << i))
+                matrix |= uint64_t(1) << (8*(7-i) + j);
+    }
+    return matrix;
+}
+
+
+// Convert coding matrix[rows*sources] into multiplication tables
+static void gf256tables_init(int sources, int rows, const uint8_t* matrix, GF256Tables& tables)
+{
+    tables.Sources = sources;
+    tables.Rows = rows;
+    tables.Tables.resize(size_t(32) * rows * sources);
+    tables.Affine.resize(size_t(rows) * sources);
+    tables.XorRows.clear();
+    tables.MulRows.clear();
+
+    for (int r = 0; r < rows; ++r)
+    {
+        bool xor_only = true;
+        for (int s = 0; s < sources; ++s)
+        {
+            uint8_t c = matrix[r*sources + s];
+            uint8_t* table = &tables.Tables[32 * (size_t(r)*sources + s)];
+            for (int x = 0; x < 16; ++x) {
+                table[x]      = gf256_mul(c, uint8_t(x));
+                table[16 + x] = gf256_mul(c, uint8_t(x << 4));
+            }
+            tables.Affine[size_t(r)*sources + s] = gf256tables_affine_matrix(c);
+            xor_only = xor_only  &&  c == 1;
+        }
+        (xor_only? tables.XorRows : tables.MulRows).push_back(r);
+    }
+}
+
+
+// Vector operations used by the SSSE3 and AVX2 kernels, on 16 and 32 bytes respectively.
+// Both are compiled in the AVX2 build, so the SSSE3 kernel can also be benchmarked against the AVX2 one in a single build
+#if defined(__SSSE3__)
+struct SimdVector128
+{
+    typedef __m128i V;
+    static const size_t BYTES = 16;
+
+    static V load(const uint8_t* p)            { return _mm_loadu_si128((const __m128i*) p); }
+    static void store(uint8_t* p, V x)         { _mm_storeu_si128((__m128i*) p, x); }
+    static V load_table(const uint8_t* p)      { return _mm_loadu_si128((const __m128i*) p); }
+    static V zero()                            { return _mm_setzero_si128(); }
+    static V xor_(V x, V y)                    { return _mm_xor_si128(x, y); }
+    static V low_nibbles(V x)                  { return _mm_and_si128(x, _mm_set1_epi8(0x0f)); }
+    static V high_nibbles(V x)                 { return _mm_and_si128(_mm_srli_epi64(x, 4), _mm_set1_epi8(0x0f)); }
+    static V lookup(V table, V nibbles)        { return _mm_shuffle_epi8(table, nibbles); }
+};
+#endif
+
+#if defined(__AVX2__)
+struct SimdVector256
+{
+    typedef __m256i V;
+    static const size_t BYTES = 32;
+
+    static V load(const uint8_t* p)            { return _mm256_loadu_si256((const __m256i*) p); }
+    static void store(uint8_t* p, V x)         { _mm256_storeu_si256((__m256i*) p, x); }
+    // 16-byte table copied into both lanes, since VPSHUFB looks up each lane separately
+    static V load_table(const uint8_t* p)      { return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) p)); }
+    static V zero()                            { return _mm256_setzero_si256(); }
+    static V xor_(V x, V y)                    { return _mm256_xor_si256(x, y); }
+    static V low_nibbles(V x)                  { return _mm256_and_si256(x, _mm256_set1_epi8(0x0f)); }
+    static V high_nibbles(V x)                 { return _mm256_and_si256(_mm256_srli_epi64(x, 4), _mm256_set1_epi8(0x0f)); }
+    static V lookup(V table, V nibbles)        { return _mm256_shuffle_epi8(table, nibbles); }
+};
+#endif
+
+
+// Compute OUTPUTS dot products of bytes [start,end) of all sources with the rows whose tables are row_tables[]
+template <int OUTPUTS>
+static void gf256tables_dot_prod_scalar(size_t start, size_t end, int sources,
+                                        const uint8_t* const* row_tables, const uint8_t* const* data, uint8_t* const* out)
+{
+    for (size_t i = start; i < end; ++i)
+    {
+        uint8_t sum[OUTPUTS] = {};
+        for (int s = 0; s < sources; ++s) {
+            uint8_t x = data[s][i];
+            for (int o = 0; o < OUTPUTS; ++o) {
+                const uint8_t* table = row_tables[o] + 32*s;
+                sum[o] ^= table[x & 15] ^ table[16 + (x >> 4)];
+            }
+        }
+        for (int o = 0; o < OUTPUTS; ++o)
+            out[o][i] = sum[o];
+    }
+}
+
+
+// Compute OUTPUTS dot products at once, like gf_Nvect_dot_prod of ISA-L: each source vector is loaded
+// and split into nibbles only once for all outputs, and the sums are kept in registers until all sources are added
+template <class Vector, int OUTPUTS>
+static void gf256tables_dot_prod(size_t bytes, int sources,
+                                 const uint8_t* const* row_tables, const uint8_t* const* data, uint8_t* const* out)
+{
+    typedef typename Vector::V V;
+    size_t i = 0;
+    for (; i + Vector::BYTES <= bytes; i += Vector::BYTES)
+    {
+        V sum[OUTPUTS];
+        for (int o = 0; o < OUTPUTS; ++o)
+            sum[o] = Vector::zero();
+
+        for (int s = 0; s < sources; ++s)
+        {
+            V x  = Vector::load(data[s] + i);
+            V lo = Vector::low_nibbles(x);
+            V hi = Vector::high_nibbles(x);
+            for (int o = 0; o < OUTPUTS; ++o)
+            {
+                const uint8_t* table = row_tables[o] + 32*s;
+                V product = Vector::xor_(Vector::lookup(Vector::load_table(table), lo),
+                                         Vector::lookup(Vector::load_table(table + 16), hi));
+                sum[o] = Vector::xor_(sum[o], product);
+            }
+        }
+
+        for (int o = 0; o < OUTPUTS; ++o)
+            Vector::store(out[o] + i, sum[o]);
+    }
+    gf256tables_dot_prod_scalar<OUTPUTS>(i, bytes, sources, row_tables, data, out);
+}
+
+
+// XOR of bytes [start,end) of all sources, for rows with all coefficients equal to 1
+static void gf256tables_xor_sum_scalar(size_t start, size_t end, int sources, const uint8_t* const* data, uint8_t* out)
+{
+    for (size_t i = start; i < end; ++i)
+    {
+        uint8_t sum = 0;
+        for (int s = 0; s < sources; ++s)
+            sum ^= data[s][i];
+        out[i] = sum;
+    }
+}
+
+
+template <class Vector>
+static void gf256tables_xor_sum(size_t bytes, int sources, const uint8_t* const* data, uint8_t* out)
+{
+    size_t i = 0;
+    for (; i + Vector::BYTES <= bytes; i += Vector::BYTES)
+    {
+        typename Vector::V sum = Vector::load(data[0] + i);
+        for (int s = 1; s < sources; ++s)
+            sum = Vector::xor_(sum, Vector::load(data[s] + i));
+        Vector::store(out + i, sum);
+    }
+    gf256tables_xor_sum_scalar(i, bytes, sources, data, out);
+}
+
+
+// Bytes [start,end) of dst[] = c * src[], or dst[] ^= c * src[] if add. table[] is the table of c
+static void gf256tables_mul_mem_scalar(size_t start, size_t end, uint8_t* dst, const uint8_t* table, const uint8_t* src, bool add)
+{
+    for (size_t i = start; i < end; ++i) {
+        uint8_t product = table[src[i] & 15] ^ table[16 + (src[i] >> 4)];
+        dst[i] = (add? dst[i] ^ product : product);
+    }
+}
+
+
+template <class Vector>
+static void gf256tables_mul_mem(uint8_t* dst, const uint8_t* table, const uint8_t* src, size_t bytes, bool add)
+{
+    typedef typename Vector::V V;
+    const V table_lo = Vector::load_table(table), table_hi = Vector::load_table(table + 16);
+    size_t i = 0;
+    for (; i + Vector::BYTES <= bytes; i += Vector::BYTES)
+    {
+        V x = Vector::load(src + i);
+        V product = Vector::xor_(Vector::lookup(table_lo, Vector::low_nibbles(x)), Vector::lookup(table_hi, Vector::high_nibbles(x)));
+        if (add)
+            product = Vector::xor_(product, Vector::load(dst + i));
+        Vector::store(dst + i, product);
+    }
+    gf256tables_mul_mem_scalar(i, bytes, dst, table, src, add);
+}
+
+
+#ifdef GF256TABLES_HAVE_AVX512
+// The same kernels processing 64 bytes at once with AVX-512BW. They can't reuse the templates above,
+// since target attributes of the intrinsics should match the attributes of the functions using them
+template <int OUTPUTS>
+GF256TABLES_TARGET_AVX512 static void gf256tables_dot_prod_avx512(size_t bytes, int sources,
+                                 const uint8_t* const* row_tables, const uint8_t* const* data, uint8_t* const* out)
+{
+    const __m512i mask = _mm512_set1_epi8(0x0f);
+    size_t i = 0;
+    for (; i + 64 <= bytes; i += 64)
+    {
+        __m512i sum[OUTPUTS];
+        for (int o = 0; o < OUTPUTS; ++o)
+            sum[o] = _mm512_setzero_si512();
+
+        for (int s = 0; s < sources; ++s)
+        {
+            __m512i x  = _mm512_loadu_si512((const void*)(data[s] + i));
+            __m512i lo = _mm512_and_si512(x, mask);
+            __m512i hi = _mm512_and_si512(_mm512_srli_epi64(x, 4), mask);
+            for (int o = 0; o < OUTPUTS; ++o)
+            {
+                // 16-byte tables are copied into all 4 lanes, since VPSHUFB looks up each lane separately
+                const uint8_t* table = row_tables[o] + 32*s;
+                __m512i table_lo = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*) table));
+                __m512i table_hi = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)(table + 16)));
+                __m512i product  = _mm512_xor_si512(_mm512_shuffle_epi8(table_lo, lo), _mm512_shuffle_epi8(table_hi, hi));
+                sum[o] = _mm512_xor_si512(sum[o], product);
+            }
+        }
+
+        for (int o = 0; o < OUTPUTS; ++o)
+            _mm512_storeu_si512((void*)(out[o] + i), sum[o]);
+    }
+    gf256tables_dot_prod_scalar<OUTPUTS>(i, bytes, sources, row_tables, data, out);
+}
+
+
+GF256TABLES_TARGET_AVX512 static void gf256tables_xor_sum_avx512(size_t bytes, int sources, const uint8_t* const* data, uint8_t* out)
+{
+    size_t i = 0;
+    for (; i + 64 <= bytes; i += 64)
+    {
+        __m512i sum = _mm512_loadu_si512((const void*)(data[0] + i));
+        for (int s = 1; s < sources; ++s)
+            sum = _mm512_xor_si512(sum, _mm512_loadu_si512((const void*)(data[s] + i)));
+        _mm512_storeu_si512((void*)(out + i), sum);
+    }
+    gf256tables_xor_sum_scalar(i, bytes, sources, data, out);
+}
+
+
+GF256TABLES_TARGET_AVX512 static void gf256tables_mul_mem_avx512(uint8_t* dst, const uint8_t* table, const uint8_t* src, size_t bytes, bool add)
+{
+    const __m512i mask = _mm512_set1_epi8(0x0f);
+    const __m512i table_lo = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*) table));
+    const __m512i table_hi = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)(table + 16)));
+    size_t i = 0;
+    for (; i + 64 <= bytes; i += 64)
+    {
+        __m512i x = _mm512_loadu_si512((const void*)(src + i));
+        __m512i product = _mm512_xor_si512(_mm512_shuffle_epi8(table_lo, _mm512_and_si512(x, mask)),
+                                           _mm512_shuffle_epi8(table_hi, _mm512_and_si512(_mm512_srli_epi64(x, 4), mask)));
+        if (add)
+            product = _mm512_xor_si512(product, _mm512_loadu_si512((const void*)(dst + i)));
+        _mm512_storeu_si512((void*)(dst + i), product);
+    }
+    gf256tables_mul_mem_scalar(i, bytes, dst, table, src, add);
+}
+
+
+// The same with GFNI: a single GF2P8AFFINEQB per source and output replaces two lookups, masking and shift
+template <int OUTPUTS>
+GF256TABLES_TARGET_GFNI static void gf256tables_dot_prod_gfni(size_t bytes, int sources,
+                                 const uint8_t* const* row_tables, const uint64_t* const* row_affine,
+                                 const uint8_t* const* data, uint8_t* const* out)
+{
+    size_t i = 0;
+    for (; i + 64 <= bytes; i += 64)
+    {
+        __m512i sum[OUTPUTS];
+        for (int o = 0; o < OUTPUTS; ++o)
+            sum[o] = _mm512_setzero_si512();
+
+        for (int s = 0; s < sources; ++s)
+        {
+            __m512i x = _mm512_loadu_si512((const void*)(data[s] + i));
+            for (int o = 0; o < OUTPUTS; ++o)
+            {
+                __m512i matrix = _mm512_set1_epi64((long long) row_affine[o][s]);
+                sum[o] = _mm512_xor_si512(sum[o], _mm512_gf2p8affine_epi64_epi8(x, matrix, 0));
+            }
+        }
+
+        for (int o = 0; o < OUTPUTS; ++o)
+            _mm512_storeu_si512((void*)(out[o] + i), sum[o]);
+    }
+    gf256tables_dot_prod_scalar<OUTPUTS>(i, bytes, sources, row_tables, data, out);
+}
+
+
+// affine is the bit matrix of the multiplier
+GF256TABLES_TARGET_GFNI static void gf256tables_mul_mem_gfni(uint8_t* dst, const uint8_t* table, uint64_t affine,
+                                                             const uint8_t* src, size_t bytes, bool add)
+{
+    const __m512i matrix = _mm512_set1_epi64((long long) affine);
+    size_t i = 0;
+    for (; i + 64 <= bytes; i += 64)
+    {
+        __m512i product = _mm512_gf2p8affine_epi64_epi8(_mm512_loadu_si512((const void*)(src + i)), matrix, 0);
+        if (add)
+            product = _mm512_xor_si512(product, _mm512_loadu_si512((const void*)(dst + i)));
+        _mm512_storeu_si512((void*)(dst + i), product);
+    }
+    gf256tables_mul_mem_scalar(i, bytes, dst, table, src, add);
+}
+#endif
+
+
+// Kernels processing the data, in increasing order of speed. SSSE3 and AVX2 ones are compiled
+// in the builds for these instruction sets (see isa_build.h), AVX-512 and GFNI ones are compiled with target attributes.
+// Kernels are selected at runtime among those supported by CPU and allowed by params.Isa
+enum GF256TablesKernel { GF256TABLES_SCALAR, GF256TABLES_SSSE3, GF256TABLES_AVX2, GF256TABLES_AVX512, GF256TABLES_GFNI, GF256TABLES_KERNELS };
+
+static const char* gf256tables_kernel_name[GF256TABLES_KERNELS] = {"scalar", "ssse3", "avx2", "avx512", "gfni"};
+
+// Instruction set required by each kernel
+static const int gf256tables_kernel_isa[GF256TABLES_KERNELS] = {ISA_SCALAR, ISA_SSSE3, ISA_AVX2, ISA_AVX512, ISA_AVX512};
+
+
+// Check whether the kernel is compiled in, supported by CPU and allowed by the isa limit
+static bool gf256tables_kernel_supported(GF256TablesKernel kernel, int isa)
+{
+    int kernel_isa = gf256tables_kernel_isa[kernel];
+    if (kernel_isa > isa  ||  kernel_isa > cpu_isa())
+        return false;
+    switch (kernel) {
+#if defined(__SSSE3__)
+        case GF256TABLES_SSSE3:   return true;
+#endif
+#if defined(__AVX2__)
+        case GF256TABLES_AVX2:    return true;
+#endif
+#ifdef GF256TABLES_HAVE_AVX512
+        case GF256TABLES_AVX512:  return true;
+        case GF256TABLES_GFNI:    return cpu_has_gfni();
+#endif
+        case GF256TABLES_SCALAR:  return true;
+        default:                  return false;
+    }
+}
+
+
+// The fastest kernel allowed by the isa limit
+static GF256TablesKernel gf256tables_best_kernel(int isa)
+{
+    int kernel = GF256TABLES_KERNELS - 1;
+    while (! gf256tables_kernel_supported(GF256TablesKernel(kernel), isa))
+        --kernel;
+    return GF256TablesKernel(kernel);
+}
+
+
+// Whether this build has a kernel for the instruction set
+bool gf256tables_has_isa(int isa)
+{
+    for (int kernel = 0; kernel < GF256TABLES_KERNELS; ++kernel)
+        if (gf256tables_kernel_isa[kernel] == isa  &&  gf256tables_kernel_supported(GF256TablesKernel(kernel), isa))
+            return true;
+    return false;
+}
+
+
+// Compute OUTPUTS dot products with the kernel
+template <int OUTPUTS>
+static void gf256tables_dot_prod_kernel(GF256TablesKernel kernel, size_t bytes, int sources,
+                                        const uint8_t* const* row_tables, const uint64_t* const* row_affine,
+                                        const uint8_t* const* data, uint8_t* const* out)
+{
+    switch (kernel) {
+#if defined(__SSSE3__)
+        case GF256TABLES_SSSE3:   gf256tables_dot_prod<SimdVector128, OUTPUTS>(bytes, sources, row_tables, data, out);  return;
+#endif
+#if defined(__AVX2__)
+        case GF256TABLES_AVX2:    gf256tables_dot_prod<SimdVector256, OUTPUTS>(bytes, sources, row_tables, data, out);  return;
+#endif
+#ifdef GF256TABLES_HAVE_AVX512
+        case GF256TABLES_AVX512:  gf256tables_dot_prod_avx512<OUTPUTS>(bytes, sources, row_tables, data, out);  return;
+        case GF256TABLES_GFNI:    gf256tables_dot_prod_gfni<OUTPUTS>(bytes, sources, row_tables, row_affine, data, out);  return;
+#endif
+        default:                  gf256tables_dot_prod_scalar<OUTPUTS>(0, bytes, sources, row_tables, data, out);  return;
+    }
+}
+
+
+// XOR of all sources with the kernel
+static void gf256tables_xor_sum_kernel(GF256TablesKernel kernel, size_t bytes, int sources, const uint8_t* const* data, uint8_t* out)
+{
+    switch (kernel) {
+#if defined(__SSSE3__)
+        case GF256TABLES_SSSE3:   gf256tables_xor_sum<SimdVector128>(bytes, sources, data, out);  return;
+#endif
+#if defined(__AVX2__)
+        case GF256TABLES_AVX2:    gf256tables_xor_sum<SimdVector256>(bytes, sources, data, out);  return;
+#endif
+#ifdef GF256TABLES_HAVE_AVX512
+        case GF256TABLES_AVX512:
+        case GF256TABLES_GFNI:    gf256tables_xor_sum_avx512(bytes, sources, data, out);  return;
+#endif
+        default:                  gf256tables_xor_sum_scalar(0, bytes, sources, data, out);  return;
+    }
+}
+
+
+// Multiply coding matrix by the data: out[r] = sum of coef(r,s) * data[s] for all rows, like ec_encode_data of ISA-L.
+// Up to 4 rows are computed in a single pass over the sources, which leaves enough registers for nibbles and tables
+static void gf256tables_encode(size_t bytes, const GF256Tables& tables, const uint8_t* const* data, uint8_t* const* out,
+                               GF256TablesKernel kernel)
+{
+    for (int r : tables.XorRows)
+        gf256tables_xor_sum_kernel(kernel, bytes, tables.Sources, data, out[r]);
+
+    const int GROUP = 4;
+    for (size_t first = 0; first < tables.MulRows.size(); first += GROUP)
+    {
+        const uint8_t* row_tables[GROUP];
+        const uint64_t* row_affine[GROUP];
+        uint8_t* row_out[GROUP];
+        int outputs = int(std::min<size_t>(GROUP, tables.MulRows.size() - first));
+        for (int o = 0; o < outputs; ++o) {
+            int r = tables.MulRows[first + o];
+            row_tables[o] = &tables.Tables[32 * size_t(r) * tables.Sources];
+            row_affine[o] = &tables.Affine[size_t(r) * tables.Sources];
+            row_out[o] = out[r];
+        }
+
+        switch (outputs) {
+            case 1:  gf256tables_dot_prod_kernel<1>(kernel, bytes, tables.Sources, row_tables, row_affine, data, row_out);  break;
+            case 2:  gf256tables_dot_prod_kernel<2>(kernel, bytes, tables.Sources, row_tables, row_affine, data, row_out);  break;
+            case 3:  gf256tables_dot_prod_kernel<3>(kernel, bytes, tables.Sources, row_tables, row_affine, data, row_out);  break;
+            default: gf256tables_dot_prod_kernel<4>(kernel, bytes, tables.Sources, row_tables, row_affine, data, row_out);  break;
+        }
+    }
+}
+
+
+// Multiplication tables of all 256 multipliers for gf256tables_mul_mem_kernel. They are constructed on the first use,
+// since builds of the libraries for other instruction sets shouldn't run any code at startup (see isa_build.h)
+static GF256Tables& gf256tables_multipliers()
+{
+    static GF256Tables tables;
+    return tables;
+}
+
+static void gf256tables_mul_mem_init()
+{
+    uint8_t multipliers[256];
+    for (int c = 0; c < 256; ++c)
+        multipliers[c] = uint8_t(c);
+    gf256tables_init(256, 1, multipliers, gf256tables_multipliers());
+}
+
+
+// Region operation of the CM256 encoder, like gf256_mul_mem and gf256_muladd_mem:
+// dst[] = c * src[], or dst[] ^= c * src[] if add
+static void gf256tables_mul_mem_kernel(GF256TablesKernel kernel, uint8_t* dst, uint8_t c, const uint8_t* src, size_t bytes, bool add)
+{
+    const GF256Tables& multipliers = gf256tables_multipliers();
+    const uint8_t* table = &multipliers.Tables[32*c];
+    switch (kernel) {
+#if defined(__SSSE3__)
+        case GF256TABLES_SSSE3:   gf256tables_mul_mem<SimdVector128>(dst, table, src, bytes, add);  return;
+#endif
+#if defined(__AVX2__)
+        case GF256TABLES_AVX2:    gf256tables_mul_mem<SimdVector256>(dst, table, src, bytes, add);  return;
+#endif
+#ifdef GF256TABLES_HAVE_AVX512
+        case GF256TABLES_AVX512:  gf256tables_mul_mem_avx512(dst, table, src, bytes, add);  return;
+        case GF256TABLES_GFNI:    gf256tables_mul_mem_gfni(dst, table, multipliers.Affine[c], src, bytes, add);  return;
+#endif
+        default:                  gf256tables_mul_mem_scalar(0, bytes, dst, table, src, add);  return;
+    }
+}
+
+
+// Invert n x n matrix a[] into inv[] with Gauss-Jordan elimination, like gf_invert_matrix of ISA-L.
+// a[] is destroyed, return false if it's singular
+static bool gf256tables_invert_matrix(std::vector<uint8_t>& a, std::vector<uint8_t>& inv, size_t n)
+{
+    inv.assign(n*n, 0);
+    for (size_t i = 0; i < n; ++i)
+        inv[i*n+i] = 1;
+
+    for (size_t col = 0; col < n; ++col)
+    {
+        size_t pivot = col;
+        while (pivot < n  &&  a[pivot*n+col] == 0)
+            ++pivot;
+        if (pivot == n)
+            return false;
+        for (size_t j = 0; j < n; ++j) {
+            std::swap(a[col*n+j], a[pivot*n+j]);
+            std::swap(inv[col*n+j], inv[pivot*n+j]);
+        }
+        uint8_t scale = gf256_inv(a[col*n+col]);
+        for (size_t j = 0; j < n; ++j) {
+            a[col*n+j] = gf256_mul(a[col*n+j], scale);
+            inv[col*n+j] = gf256_mul(inv[col*n+j], scale);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            uint8_t factor = a[i*n+col];
+            if (i == col  ||  factor == 0)
+                continue;
+            for (size_t j = 0; j < n; ++j) {
+                a[i*n+j] = gf256_add(a[i*n+j], gf256_mul(a[col*n+j], factor));
+                inv[i*n+j] = gf256_add(inv[i*n+j], gf256_mul(inv[col*n+j], factor));
+            }
+        }
+    }
+    return true;
+}
+
+
+// Build encoding tables from the CM256 Cauchy matrix
+static void gf256tables_encode_setup(ECC_bench_params params, GF256Tables& tables)
+{
+    std::vector<uint8_t> matrix(params.RecoveryCount * params.OriginalCount);
+    for (int i = 0; i < params.RecoveryCount; ++i)
+        for (int j = 0; j < params.OriginalCount; ++j)
+            matrix[i*params.OriginalCount + j] = cm256_matrix_element(params.OriginalCount, cm256_get_recovery_block_index(params, i), j);
+    gf256tables_init(params.OriginalCount, params.RecoveryCount, matrix.data(), tables);
+}
+
+
+// Build decoding tables for the erasure pattern of blocks[] (OriginalCount blocks, as passed to cm256_decode),
+// like in ISA-L examples: the encoding matrix rows of received blocks are inverted, and the rows of the inverse
+// corresponding to lost original blocks are converted into tables. Lost block indexes are stored into lost[].
+// Return false if blocks[] can't be decoded
+static bool gf256tables_decode_setup(ECC_bench_params params, const cm256_block* blocks,
+                                     GF256Tables& tables, std::vector<int>& lost)
+{
+    size_t k = params.OriginalCount;
+    bool present[256] = {};
+    std::vector<uint8_t> a(k*k, 0), inv;
+    for (size_t i = 0; i < k; ++i)
+    {
+        int index = blocks[i].Index;
+        if (index < params.OriginalCount) {
+            present[index] = true;
+            a[i*k + index] = 1;
+        } else {
+            for (size_t j = 0; j < k; ++j)
+                a[i*k + j] = cm256_matrix_element(params.OriginalCount, index, int(j));
+        }
+    }
+    if (! gf256tables_invert_matrix(a, inv, k))
+        return false;
+
+    lost.clear();
+    std::vector<uint8_t> matrix;
+    for (size_t j = 0; j < k; ++j)
+        if (! present[j]) {
+            lost.push_back(int(j));
+            matrix.insert(matrix.end(), inv.begin() + j*k, inv.begin() + (j+1)*k);
+        }
+    gf256tables_init(int(k), int(lost.size()), matrix.data(), tables);
+    return true;
+}
+
+
+// Stripe encoder with tables computed once for all stripes, and decoder building tables for each erasure pattern
+class GF256TablesStripeCodec : public StripeCodec
+{
+public:
+    explicit GF256TablesStripeCodec(ECC_bench_params params)
+        : Params(params), Kernel(gf256tables_best_kernel(params.Isa)), Data(params.OriginalCount), Out(params.RecoveryCount)
+    {
+        gf256tables_encode_setup(params, Tables);
+    }
+
+    bool Encode(uint8_t* original, uint8_t* recovery) override
+    {
+        for (int i = 0; i < Params.OriginalCount; ++i)
+            Data[i] = original + i * Params.BlockBytes;
+        for (int i = 0; i < Params.RecoveryCount; ++i)
+            Out[i] = recovery + i * Params.BlockBytes;
+        gf256tables_encode(Params.BlockBytes, Tables, Data.data(), Out.data(), Kernel);
+        return true;
+    }
+
+    bool Decode(uint8_t* original, uint8_t* recovery, const std::vector<char>& lost) override
+    {
+        cm256_block blocks[256];
+        std::vector<int> lost_blocks;
+        if (! cm256_lose_blocks(Params, original, recovery, lost, blocks)  ||
+            ! gf256tables_decode_setup(Params, blocks, DecodeTables, lost_blocks))
+            return false;
+
+        for (int i = 0; i < Params.OriginalCount; ++i)
+            Data[i] = (const uint8_t*) blocks[i].Block;
+        for (size_t r = 0; r < lost_blocks.size(); ++r)
+            Out[r] = original + lost_blocks[r] * Params.BlockBytes;
+        gf256tables_encode(Params.BlockBytes, DecodeTables, Data.data(), Out.data(), Kernel);
+        return true;
+    }
+
+private:
+    ECC_bench_params Params;
+    GF256TablesKernel Kernel;
+    GF256Tables Tables, DecodeTables;
+    std::vector<const uint8_t*> Data;
+    std::vector<uint8_t*> Out;
+};
+
+
+std::unique_ptr<StripeCodec> gf256tables_create_stripe_codec(ECC_bench_params params)
+{
+    if (! gf256tables_supports(params))
+        return nullptr;
+    if (gf256_init()) {
+        printf("gf256_init failed\n");
+        return nullptr;
+    }
+    return std::unique_ptr<StripeCodec>(new GF256TablesStripeCodec(params));
+}
+
+std::unique_ptr<StripeEncoder> gf256tables_create_stripe_encoder(ECC_bench_params params)
+{
+    return gf256tables_create_stripe_codec(params);
+}
+
+
+// Timers of all operations: table setup is measured separately from the processing of stripe data
+struct GF256TablesTimers
+{
+    OperationTimer encode_setup, encode;
+    OperationTimer decode_one_setup, decode_one;
+    OperationTimer decode_all_setup, decode_all;
+};
+
+
+// Perform single decoding operation with the table setup for the erasure pattern of blocks[],
+// and check the recovered data on the first call. Return false if it fails
+bool gf256tables_benchmark_decode(
+    ECC_bench_params params,
+    GF256Tables& tables,
+    const cm256_block* blocks,
+    uint8_t* originalFileData,
+    uint8_t* recoveredBlocks,
+    OperationTimer& setup_time,
+    OperationTimer& decode_time)
+{
+    std::vector<int> lost;
+    setup_time.BeginCall();
+    bool succeeded = gf256tables_decode_setup(params, blocks, tables, lost);
+    setup_time.EndCall();
+    if (! succeeded) {
+        printf("  gf256tables_decode_setup failed: singular matrix\n");
+        return false;
+    }
+
+    const uint8_t* data[256];
+    uint8_t* out[256];
+    for (int i = 0; i < params.OriginalCount; ++i)
+        data[i] = (const uint8_t*) blocks[i].Block;
+    for (size_t r = 0; r < lost.size(); ++r)
+        out[r] = recoveredBlocks + r * params.BlockBytes;
+
+    decode_time.BeginCall();
+    gf256tables_encode(params.BlockBytes, tables, data, out, gf256tables_best_kernel(params.Isa));
+    decode_time.EndCall();
+
+    // Check the recovered data, but only once since it's slow
+    if (! decode_time.Checked) {
+        decode_time.Checked = true;
+        for (size_t r = 0; r < lost.size(); ++r) {
+            if (memcmp(out[r], originalFileData + lost[r] * params.BlockBytes, params.BlockBytes)) {
+                printf("  gf256tables decoding failed: recovered block %d doesn't match original data\n", lost[r]);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+// Compare all kernels allowed by params.Isa side by side: the dot product over all sources used by GF256Tables,
+// and the multiply-add of a single region used by the CM256 encoder. Return false if any kernel produces wrong results
+bool gf256tables_benchmark_kernels(ECC_bench_params params, uint8_t* buffer)
+{
+    // Places for original and parity data, and the reference parity data computed by the scalar kernel
+    auto originalFileData = buffer;
+    auto recoveryBlocks   = buffer + params.OriginalFileBytes();
+    auto expectedBlocks   = recoveryBlocks + params.RecoveryDataBytes();
+
+    std::vector<const uint8_t*> data(params.OriginalCount);
+    std::vector<uint8_t*> out(params.RecoveryCount), expected(params.RecoveryCount);
+    for (int i = 0; i < params.OriginalCount; ++i)
+        data[i] = originalFileData + i * params.BlockBytes;
+    for (int i = 0; i < params.RecoveryCount; ++i) {
+        out[i] = recoveryBlocks + i * params.BlockBytes;
+        expected[i] = expectedBlocks + i * params.BlockBytes;
+    }
+
+    GF256Tables tables;
+    gf256tables_encode_setup(params, tables);
+    gf256tables_encode(params.BlockBytes, tables, data.data(), expected.data(), GF256TABLES_SCALAR);
+
+    std::vector<uint8_t> matrix(params.RecoveryCount * params.OriginalCount);
+    for (int i = 0; i < params.RecoveryCount; ++i)
+        for (int j = 0; j < params.OriginalCount; ++j)
+            matrix[i*params.OriginalCount + j] = cm256_matrix_element(params.OriginalCount, cm256_get_recovery_block_index(params, i), j);
+
+    for (int k = 0; k < GF256TABLES_KERNELS; ++k)
+    {
+        GF256TablesKernel kernel = GF256TablesKernel(k);
+        if (! gf256tables_kernel_supported(kernel, params.Isa))
+            continue;
+
+        OperationTimer encode_time, muladd_time;
+        for (TrialLoop trial(params); trial.Next(); )
+        {
+            encode_time.BeginCall();
+            gf256tables_encode(params.BlockBytes, tables, data.data(), out.data(), kernel);
+            encode_time.EndCall();
+            bool encode_ok = (trial.Trial > 1  ||  memcmp(recoveryBlocks, expectedBlocks, params.RecoveryDataBytes()) == 0);
+
+            // Encoding with region operations, like CM256StripeEncoder
+            muladd_time.BeginCall();
+            for (int i = 0; i < params.RecoveryCount; ++i)
+                for (int j = 0; j < params.OriginalCount; ++j)
+                    gf256tables_mul_mem_kernel(kernel, out[i], matrix[i*params.OriginalCount + j], data[j], params.BlockBytes, j > 0);
+            muladd_time.EndCall();
+            bool muladd_ok = (trial.Trial > 1  ||  memcmp(recoveryBlocks, expectedBlocks, params.RecoveryDataBytes()) == 0);
+
+            // Check the results, but only once since it's slow
+            if (! encode_ok  ||  ! muladd_ok) {
+                printf("  %s kernel failed: parity data doesn't match the scalar kernel\n", gf256tables_kernel_name[kernel]);
+                return false;
+            }
+        }
+
+        char operation[64];
+        snprintf(operation, sizeof(operation), "encode %s", gf256tables_kernel_name[kernel]);
+        encode_time.Print(operation, params.OriginalFileBytes());
+        snprintf(operation, sizeof(operation), "muladd %s", gf256tables_kernel_name[kernel]);
+        muladd_time.Print(operation, params.OriginalFileBytes());
+    }
+
+    // The baseline: the same encoding with gf256_mul_mem/gf256_muladd_mem of CM256, on its best code path allowed by params.Isa
+    gf256_limit_isa(params.Isa);
+    OperationTimer cm256_time;
+    for (TrialLoop trial(params); trial.Next(); )
+    {
+        cm256_time.BeginCall();
+        for (int i = 0; i < params.RecoveryCount; ++i)
+            for (int j = 0; j < params.OriginalCount; ++j)
+                if (j == 0)
+                    gf256_mul_mem(out[i], data[j], matrix[i*params.OriginalCount + j], params.BlockBytes);
+                else
+                    gf256_muladd_mem(out[i], matrix[i*params.OriginalCount + j], data[j], params.BlockBytes);
+        cm256_time.EndCall();
+
+        if (trial.Trial == 1  &&  memcmp(recoveryBlocks, expectedBlocks, params.RecoveryDataBytes())) {
+            printf("  cm256 muladd failed: parity data doesn't match the scalar kernel\n");
+            return false;
+        }
+    }
+    cm256_time.Print("muladd cm256", params.OriginalFileBytes());
+
+    return true;
+}
+
+
+// Run all benchmark trials on a single codeword, return false if anything failed
+bool gf256tables_benchmark_trials(ECC_bench_params params, uint8_t* buffer, GF256TablesTimers& timers)
+{
+    // Places for original, parity and recovered data
+    auto originalFileData = buffer;
+    auto recoveryBlocks   = buffer + params.OriginalFileBytes();
+    auto recoveredBlocks  = recoveryBlocks + params.RecoveryDataBytes();
+
+    std::vector<const uint8_t*> data(params.OriginalCount);
+    std::vector<uint8_t*> out(params.RecoveryCount);
+    for (int i = 0; i < params.OriginalCount; ++i)
+        data[i] = originalFileData + i * params.BlockBytes;
+    for (int i = 0; i < params.RecoveryCount; ++i)
+        out[i] = recoveryBlocks + i * params.BlockBytes;
+
+    cm256_block blocks_losing_one[256], blocks_losing_all[256];
+    cm256_lose_one_block(params, originalFileData, recoveryBlocks, blocks_losing_one);
+    cm256_lose_all_blocks(params, originalFileData, recoveryBlocks, blocks_losing_all);
+
+    GF256Tables encode_tables, decode_tables;
+    GF256TablesKernel kernel = gf256tables_best_kernel(params.Isa);
+
+    // Repeat benchmark multiple times to improve its accuracy
+    for (TrialLoop trial(params); trial.Next(); )
+    {
+        timers.encode_setup.BeginCall();
+        gf256tables_encode_setup(params, encode_tables);
+        timers.encode_setup.EndCall();
+
+        timers.encode.BeginCall();
+        gf256tables_encode(params.BlockBytes, encode_tables, data.data(), out.data(), kernel);
+        timers.encode.EndCall();
+
+        if (! gf256tables_benchmark_decode(params, decode_tables, blocks_losing_one, originalFileData, recoveredBlocks,
+                                           timers.decode_one_setup, timers.decode_one)) {
+            return false;
+        }
+        if (! gf256tables_benchmark_decode(params, decode_tables, blocks_losing_all, originalFileData, recoveredBlocks,
+                                           timers.decode_all_setup, timers.decode_all)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// Benchmark library and print results, return false if anything failed
+bool gf256tables_benchmark_main(ECC_bench_params params, uint8_t* buffer)
+{
+    if (! gf256tables_supports(params))
+        return false;
+
+    // Initialize multiplication tables used to build the encoding tables
+    OperationTimer init_time(0);
+    init_time.BeginCall();
+    if (gf256_init()) {
+        printf("gf256_init failed\n");
+        return false;
+    }
+
+    gf256tables_mul_mem_init();
+    init_time.EndCall();
+
+    // The fastest kernel supported by CPU and allowed by params.Isa
+    printf("GF256Tables (%s, %d-bit):\n", gf256tables_kernel_name[gf256tables_best_kernel(params.Isa)], int(sizeof(size_t)*8));
+    init_time.PrintTime("init");
+
+    GF256TablesTimers timers;
+    if (! gf256tables_benchmark_trials(params, buffer, timers)) {
+        return false;
+    }
+
+    // Benchmark reports for each operation
+    timers.encode_setup.PrintTime("encode setup");
+    timers.encode.Print("encode", params.OriginalFileBytes());
+    timers.decode_one_setup.PrintTime("decode one setup");
+    timers.decode_one.Print("decode one", params.BlockBytes);
+    timers.decode_all_setup.PrintTime("decode all setup");
+    timers.decode_all.Print("decode all", params.RecoveryDataBytes());
+
+    if (! gf256tables_benchmark_kernels(params, buffer)) {
+        return false;
+    }
+
+    // Repeat the same benchmark on multiple cores simultaneously, each thread processing its own codeword
+    if (params.Threads > 1)
+    {
+        if (! run_scaling_on_threads(params, buffer, timers,
+                [&](uint8_t* thread_buffer, GF256TablesTimers& thread_timers) {
+                    return gf256tables_benchmark_trials(params, thread_buffer, thread_timers);
+                },
+                {{"encode", &GF256TablesTimers::encode, params.OriginalFileBytes()},
+                 {"decode one", &GF256TablesTimers::decode_one, uint64_t(params.BlockBytes)},
+                 {"decode all", &GF256TablesTimers::decode_all, params.RecoveryDataBytes()}})) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+ISA_BUILD_END
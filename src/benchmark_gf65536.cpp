@@ -0,0 +1,650 @@
+//
+// GF(2^16) Cauchy Reed-Solomon codec: the O(N^2) matrix codec of CM256 and GF256Tables in the wider field,
+// supporting up to 4096 blocks. Parity block i is the sum of C(i,j) * original block j over all j,
+// where C(i,j) = 1/(x_i + y_j) with x_i = OriginalCount+i and y_j = j, so any square submatrix is invertible.
+// Coefficients aren't stored: multiplication tables of each coefficient are built on the fly
+// from 16 products of the field basis, since tables of a 1000x3000 matrix would take hundreds of megabytes.
+// Decoding inverts only the LxL Cauchy submatrix for L lost blocks, using its closed form in O(L^2) operations.
+//
+// 16-bit words are stored in 64-byte chunks: low bytes of 32 words followed by their high bytes, like in Leopard,
+// so each byte of the word is processed by split-nibble PSHUFB lookups, like GF(2^8) multiplication in GF256Tables
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "common.h"
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+ISA_BUILD_BEGIN
+
+
+// Words are stored in 64-byte chunks
+static const size_t GF65536_CHUNK_BYTES = 64;
+
+// Field polynomial x^16 + x^5 + x^3 + x^2 + 1, the same as in Leopard
+static const unsigned GF65536_POLYNOMIAL = 0x1002D;
+static const unsigned GF65536_MODULUS = 65535;
+
+// Encoding performs K*M region multiply-adds, so the codec is limited to the wide stripes it's meant for,
+// rather than to the field size: a 32000+32000 codeword would take minutes per encode
+static const int GF65536_MAX_BLOCKS = 4096;
+
+// Kernels are compared with the scalar one only for codewords up to this number of multiply-adds,
+// since the scalar kernel is ~20 times slower than AVX2 ones
+static const int GF65536_MAX_KERNEL_PRODUCTS = 256 * 256;
+
+// Logarithms and exponents for the generator x. Exponents are doubled, so that the sum of two logarithms needs no reduction.
+// Plain arrays, since builds of the libraries for other instruction sets shouldn't run any code at startup (see isa_build.h)
+static uint16_t gf65536_log[65536], gf65536_exp[2 * GF65536_MODULUS];
+
+
+// Build log/exp tables, return false on failure
+static bool gf65536_init()
+{
+    if (gf65536_exp[0] != 0)   // already built, x^0 = 1
+        return true;
+
+    unsigned x = 1;
+    for (unsigned i = 0; i < GF65536_MODULUS; ++i) {
+        if (i > 0  &&  x == 1) {   // the period is shorter, so x isn't a generator
+            gf65536_exp[0] = 0;
+            return false;
+        }
+        gf65536_exp[i] = gf65536_exp[i + GF65536_MODULUS] = uint16_t(x);
+        gf65536_log[x] = uint16_t(i);
+        x <<= 1;
+        if (x & 0x10000)
+            x ^= GF65536_POLYNOMIAL;
+    }
+    return x == 1;   // x^65535 = 1 for any nonzero x, so it's just a check of the field polynomial
+}
+
+
+// Product of nonzero elements given by their logarithms
+static inline uint16_t gf65536_mul_log(unsigned log_x, unsigned log_y)
+{
+    return gf65536_exp[log_x + log_y];
+}
+
+
+// Up to GF65536_MAX_BLOCKS blocks of whole chunks
+bool gf65536_supports(ECC_bench_params params)
+{
+    return params.OriginalCount + params.RecoveryCount <= GF65536_MAX_BLOCKS  &&
+           params.BlockBytes % GF65536_CHUNK_BYTES == 0;
+}
+
+
+// Extra workspace used by the library on top of place required for original data:
+// recovery blocks, recovery blocks with the known original data subtracted, and recovered blocks
+size_t gf65536_extra_space(ECC_bench_params params)
+{
+    return 3 * params.RecoveryDataBytes();
+}
+
+
+// Tables of coefficients are built one at a time, so only original and recovery blocks count
+size_t gf65536_encode_working_set(ECC_bench_params params)
+{
+    return params.OriginalFileBytes() + params.RecoveryDataBytes();
+}
+
+// Multiplication table of a single coefficient c: product of c by nibble x at position n (bits 4n..4n+3) of the word.
+// Lo[n][x] is its low byte and Hi[n][x] is its high byte, so c*w = XOR of Lo[n][nibble n of w] and Hi[n][...] over n
+struct GF65536Table
+{
+    uint8_t Lo[4][16];
+    uint8_t Hi[4][16];
+};
+
+
+// Build table of coefficient c: c*(x<<4n) is the XOR of c*2^b for the bits b of x<<4n, and c*2^b = exp[log c + b]
+static void gf65536_table(uint16_t c, GF65536Table& table)
+{
+    uint16_t basis[16] = {};
+    if (c != 0)
+        for (int b = 0; b < 16; ++b)
+            basis[b] = gf65536_mul_log(gf65536_log[c], b);
+
+    for (int n = 0; n < 4; ++n)
+    {
+        uint16_t product[16] = {};
+        for (int x = 1; x < 16; ++x) {
+            int lowest = x & -x, bit = (lowest == 1? 0 : lowest == 2? 1 : lowest == 4? 2 : 3);
+            product[x] = product[x & (x-1)] ^ basis[4*n + bit];
+        }
+        for (int x = 0; x < 16; ++x) {
+            table.Lo[n][x] = uint8_t(product[x]);
+            table.Hi[n][x] = uint8_t(product[x] >> 8);
+        }
+    }
+}
+
+
+// Chunks [start,end) of dst[] = c * src[], or dst[] ^= c * src[] if add
+static void gf65536_mul_mem_scalar(size_t start, size_t end, uint8_t* dst, const GF65536Table& table, const uint8_t* src, bool add)
+{
+    for (size_t chunk = start; chunk < end; chunk += GF65536_CHUNK_BYTES)
+    {
+        for (size_t i = chunk; i < chunk + GF65536_CHUNK_BYTES/2; ++i)
+        {
+            uint8_t lo = src[i], hi = src[i + GF65536_CHUNK_BYTES/2];
+            uint8_t product_lo = table.Lo[0][lo & 15] ^ table.Lo[1][lo >> 4] ^ table.Lo[2][hi & 15] ^ table.Lo[3][hi >> 4];
+            uint8_t product_hi = table.Hi[0][lo & 15] ^ table.Hi[1][lo >> 4] ^ table.Hi[2][hi & 15] ^ table.Hi[3][hi >> 4];
+            dst[i]                         = (add? dst[i] ^ product_lo : product_lo);
+            dst[i + GF65536_CHUNK_BYTES/2] = (add? dst[i + GF65536_CHUNK_BYTES/2] ^ product_hi : product_hi);
+        }
+    }
+}
+
+
+// Vector operations used by the SSSE3 and AVX2 kernels, on 16 and 32 bytes respectively
+#if defined(__SSSE3__)
+struct GF65536Vector128
+{
+    typedef __m128i V;
+    static const size_t BYTES = 16;
+
+    static V load(const uint8_t* p)            { return _mm_loadu_si128((const __m128i*) p); }
+    static void store(uint8_t* p, V x)         { _mm_storeu_si128((__m128i*) p, x); }
+    static V load_table(const uint8_t* p)      { return _mm_loadu_si128((const __m128i*) p); }
+    static V xor_(V x, V y)                    { return _mm_xor_si128(x, y); }
+    static V low_nibbles(V x)                  { return _mm_and_si128(x, _mm_set1_epi8(0x0f)); }
+    static V high_nibbles(V x)                 { return _mm_and_si128(_mm_srli_epi64(x, 4), _mm_set1_epi8(0x0f)); }
+    static V lookup(V table, V nibbles)        { return _mm_shuffle_epi8(table, nibbles); }
+};
+#endif
+
+#if defined(__AVX2__)
+struct GF65536Vector256
+{
+    typedef __m256i V;
+    static const size_t BYTES = 32;
+
+    static V load(const uint8_t* p)            { return _mm256_loadu_si256((const __m256i*) p); }
+    static void store(uint8_t* p, V x)         { _mm256_storeu_si256((__m256i*) p, x); }
+    // 16-byte table copied into both lanes, since VPSHUFB looks up each lane separately
+    static V load_table(const uint8_t* p)      { return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) p)); }
+    static V xor_(V x, V y)                    { return _mm256_xor_si256(x, y); }
+    static V low_nibbles(V x)                  { return _mm256_and_si256(x, _mm256_set1_epi8(0x0f)); }
+    static V high_nibbles(V x)                 { return _mm256_and_si256(_mm256_srli_epi64(x, 4), _mm256_set1_epi8(0x0f)); }
+    static V lookup(V table, V nibbles)        { return _mm256_shuffle_epi8(table, nibbles); }
+};
+#endif
+
+
+// dst[] = c * src[], or dst[] ^= c * src[] if add. Each vector of low bytes is processed together
+// with the vector of high bytes of the same words, located half a chunk later
+template <class Vector>
+static void gf65536_mul_mem(uint8_t* dst, const GF65536Table& table, const uint8_t* src, size_t bytes, bool add)
+{
+    typedef typename Vector::V V;
+    V lo_tables[4], hi_tables[4];
+    for (int n = 0; n < 4; ++n) {
+        lo_tables[n] = Vector::load_table(table.Lo[n]);
+        hi_tables[n] = Vector::load_table(table.Hi[n]);
+    }
+
+    for (size_t chunk = 0; chunk < bytes; chunk += GF65536_CHUNK_BYTES)
+    {
+        for (size_t i = chunk; i < chunk + GF65536_CHUNK_BYTES/2; i += Vector::BYTES)
+        {
+            V lo = Vector::load(src + i), hi = Vector::load(src + i + GF65536_CHUNK_BYTES/2);
+            V nibbles[4] = {Vector::low_nibbles(lo), Vector::high_nibbles(lo), Vector::low_nibbles(hi), Vector::high_nibbles(hi)};
+
+            V product_lo = Vector::lookup(lo_tables[0], nibbles[0]);
+            V product_hi = Vector::lookup(hi_tables[0], nibbles[0]);
+            for (int n = 1; n < 4; ++n) {
+                product_lo = Vector::xor_(product_lo, Vector::lookup(lo_tables[n], nibbles[n]));
+                product_hi = Vector::xor_(product_hi, Vector::lookup(hi_tables[n], nibbles[n]));
+            }
+            if (add) {
+                product_lo = Vector::xor_(product_lo, Vector::load(dst + i));
+                product_hi = Vector::xor_(product_hi, Vector::load(dst + i + GF65536_CHUNK_BYTES/2));
+            }
+            Vector::store(dst + i, product_lo);
+            Vector::store(dst + i + GF65536_CHUNK_BYTES/2, product_hi);
+        }
+    }
+}
+
+
+// Kernels processing the data, in increasing order of speed. SSSE3 and AVX2 ones are compiled
+// in the builds for these instruction sets (see isa_build.h). AVX-512 would need 128-byte chunks to fill its vectors
+// with low bytes, which would make the data layout incompatible with Leopard's one
+enum GF65536Kernel { GF65536_SCALAR, GF65536_SSSE3, GF65536_AVX2, GF65536_KERNELS };
+
+static const char* gf65536_kernel_name[GF65536_KERNELS] = {"scalar", "ssse3", "avx2"};
+
+// Instruction set required by each kernel
+static const int gf65536_kernel_isa[GF65536_KERNELS] = {ISA_SCALAR, ISA_SSSE3, ISA_AVX2};
+
+
+// Check whether the kernel is compiled in, supported by CPU and allowed by the isa limit
+static bool gf65536_kernel_supported(GF65536Kernel kernel, int isa)
+{
+    int kernel_isa = gf65536_kernel_isa[kernel];
+    if (kernel_isa > isa  ||  kernel_isa > cpu_isa())
+        return false;
+    switch (kernel) {
+#if defined(__SSSE3__)
+        case GF65536_SSSE3:   return true;
+#endif
+#if defined(__AVX2__)
+        case GF65536_AVX2:    return true;
+#endif
+        case GF65536_SCALAR:  return true;
+        default:              return false;
+    }
+}
+
+
+// The fastest kernel allowed by the isa limit
+static GF65536Kernel gf65536_best_kernel(int isa)
+{
+    int kernel = GF65536_KERNELS - 1;
+    while (! gf65536_kernel_supported(GF65536Kernel(kernel), isa))
+        --kernel;
+    return GF65536Kernel(kernel);
+}
+
+
+// Whether this build has a kernel for the instruction set
+bool gf65536_has_isa(int isa)
+{
+    for (int kernel = 0; kernel < GF65536_KERNELS; ++kernel)
+        if (gf65536_kernel_isa[kernel] == isa  &&  gf65536_kernel_supported(GF65536Kernel(kernel), isa))
+            return true;
+    return false;
+}
+
+
+// dst[] = c * src[], or dst[] ^= c * src[] if add, with the kernel
+static void gf65536_mul_mem_kernel(GF65536Kernel kernel, uint8_t* dst, uint16_t c, const uint8_t* src, size_t bytes, bool add)
+{
+    GF65536Table table;
+    gf65536_table(c, table);
+    switch (kernel) {
+#if defined(__SSSE3__)
+        case GF65536_SSSE3:   gf65536_mul_mem<GF65536Vector128>(dst, table, src, bytes, add);  return;
+#endif
+#if defined(__AVX2__)
+        case GF65536_AVX2:    gf65536_mul_mem<GF65536Vector256>(dst, table, src, bytes, add);  return;
+#endif
+        default:              gf65536_mul_mem_scalar(0, bytes, dst, table, src, add);  return;
+    }
+}
+
+
+// Cauchy matrix element 1/(x+y) for distinct x and y
+static inline uint16_t gf65536_cauchy(unsigned x, unsigned y)
+{
+    return gf65536_exp[GF65536_MODULUS - gf65536_log[x ^ y]];
+}
+
+
+// Encode the stripe: out[i] = sum of C(i,j) * data[j]
+static void gf65536_encode(ECC_bench_params params, const uint8_t* const* data, uint8_t* const* out, GF65536Kernel kernel)
+{
+    for (int i = 0; i < params.RecoveryCount; ++i)
+        for (int j = 0; j < params.OriginalCount; ++j)
+            gf65536_mul_mem_kernel(kernel, out[i], gf65536_cauchy(params.OriginalCount + i, j), data[j], params.BlockBytes, j > 0);
+}
+
+
+// Decoder of a single erasure pattern. Lost original blocks y_b (b < L) are recovered from L recovery blocks x_a:
+// recovery block a minus the known original blocks is the sum of A(a,b) * original block y_b over the lost ones,
+// where A is the LxL Cauchy matrix 1/(x_a + y_b). Its inverse is B(b,a) = PX(a) * PY(b) / ((x_a + y_b) * DX(a) * DY(b)),
+// where PX(a) = Prod(x_a + y_k), PY(b) = Prod(x_k + y_b), DX(a) = Prod(x_a + x_k) for k != a, DY(b) = Prod(y_b + y_k) for k != b
+struct GF65536Decoder
+{
+    std::vector<int> Lost;       // indexes of lost original blocks, y_b
+    std::vector<int> Used;       // indexes of recovery blocks used for decoding, x_a - OriginalCount
+    std::vector<int> Known;      // indexes of original blocks that aren't lost
+    std::vector<uint16_t> Inverse;   // Inverse[b*L+a] = B(b,a)
+
+    // Prepare decoding, lost[] as in StripeCodec::Decode(). Return false if there are not enough recovery blocks
+    bool Init(ECC_bench_params params, const std::vector<char>& lost)
+    {
+        Lost.clear();
+        Used.clear();
+        Known.clear();
+        for (int j = 0; j < params.OriginalCount; ++j)
+            (lost[j]? Lost : Known).push_back(j);
+        for (int i = 0; i < params.RecoveryCount  &&  Used.size() < Lost.size(); ++i)
+            if (! lost[params.OriginalCount + i])
+                Used.push_back(i);
+        if (Used.size() < Lost.size())
+            return false;
+
+        // Logarithms of the products, computed in O(L^2) operations
+        size_t L = Lost.size();
+        std::vector<uint64_t> log_px(L, 0), log_py(L, 0), log_dx(L, 0), log_dy(L, 0);
+        for (size_t a = 0; a < L; ++a)
+        {
+            unsigned x_a = params.OriginalCount + Used[a];
+            for (size_t k = 0; k < L; ++k)
+            {
+                unsigned x_k = params.OriginalCount + Used[k];
+                log_px[a] += gf65536_log[x_a ^ Lost[k]];
+                log_py[a] += gf65536_log[x_k ^ Lost[a]];
+                if (k != a) {
+                    log_dx[a] += gf65536_log[x_a ^ x_k];
+                    log_dy[a] += gf65536_log[Lost[a] ^ Lost[k]];
+                }
+            }
+            log_px[a] %= GF65536_MODULUS;
+            log_py[a] %= GF65536_MODULUS;
+            log_dx[a] %= GF65536_MODULUS;
+            log_dy[a] %= GF65536_MODULUS;
+        }
+
+        Inverse.resize(L*L);
+        for (size_t b = 0; b < L; ++b)
+            for (size_t a = 0; a < L; ++a)
+            {
+                unsigned x_a = params.OriginalCount + Used[a];
+                unsigned log_numerator   = unsigned(log_px[a] + log_py[b]);
+                unsigned log_denominator = unsigned(gf65536_log[x_a ^ Lost[b]] + log_dx[a] + log_dy[b]);
+                Inverse[b*L+a] = gf65536_exp[(log_numerator + 3*GF65536_MODULUS - log_denominator) % GF65536_MODULUS];
+            }
+        return true;
+    }
+
+    // Recover lost original blocks into output[b], using L blocks at work[] as workspace.
+    // The data processing takes L*OriginalCount multiply-adds, like encoding of L recovery blocks
+    void Decode(ECC_bench_params params, const uint8_t* const* original, const uint8_t* const* recovery,
+                uint8_t* const* work, uint8_t* const* output, GF65536Kernel kernel)
+    {
+        size_t L = Lost.size();
+        for (size_t a = 0; a < L; ++a)
+        {
+            unsigned x_a = params.OriginalCount + Used[a];
+            memcpy(work[a], recovery[Used[a]], params.BlockBytes);
+            for (int j : Known)
+                gf65536_mul_mem_kernel(kernel, work[a], gf65536_cauchy(x_a, j), original[j], params.BlockBytes, true);
+        }
+        for (size_t b = 0; b < L; ++b)
+            for (size_t a = 0; a < L; ++a)
+                gf65536_mul_mem_kernel(kernel, output[b], Inverse[b*L+a], work[a], params.BlockBytes, a > 0);
+    }
+};
+
+
+// Stripe encoder and decoder, with the decoder workspace allocated on the first decoding
+class GF65536StripeCodec : public StripeCodec
+{
+public:
+    explicit GF65536StripeCodec(ECC_bench_params params)
+        : Params(params), Kernel(gf65536_best_kernel(params.Isa)),
+          Data(params.OriginalCount), Recovery(params.RecoveryCount), Out(params.RecoveryCount), Work(params.RecoveryCount)
+    {}
+
+    bool Encode(uint8_t* original, uint8_t* recovery) override
+    {
+        for (int i = 0; i < Params.OriginalCount; ++i)
+            Data[i] = original + i * Params.BlockBytes;
+        for (int i = 0; i < Params.RecoveryCount; ++i)
+            Out[i] = recovery + i * Params.BlockBytes;
+        gf65536_encode(Params, Data.data(), Out.data(), Kernel);
+        return true;
+    }
+
+    bool Decode(uint8_t* original, uint8_t* recovery, const std::vector<char>& lost) override
+    {
+        if (! Decoder.Init(Params, lost))
+            return false;
+        if (! DecodeWork) {
+            DecodeWork.reset(new AlignedBuffer(Params.RecoveryDataBytes()));
+            for (int i = 0; i < Params.RecoveryCount; ++i)
+                Work[i] = DecodeWork->data() + i * Params.BlockBytes;
+        }
+
+        for (int i = 0; i < Params.OriginalCount; ++i)
+            Data[i] = original + i * Params.BlockBytes;
+        for (int i = 0; i < Params.RecoveryCount; ++i)
+            Recovery[i] = recovery + i * Params.BlockBytes;
+        for (size_t b = 0; b < Decoder.Lost.size(); ++b)
+            Out[b] = original + Decoder.Lost[b] * Params.BlockBytes;
+        Decoder.Decode(Params, Data.data(), Recovery.data(), Work.data(), Out.data(), Kernel);
+        return true;
+    }
+
+private:
+    ECC_bench_params Params;
+    GF65536Kernel Kernel;
+    GF65536Decoder Decoder;
+    std::unique_ptr<AlignedBuffer> DecodeWork;
+    std::vector<const uint8_t*> Data, Recovery;
+    std::vector<uint8_t*> Out, Work;
+};
+
+
+std::unique_ptr<StripeCodec> gf65536_create_stripe_codec(ECC_bench_params params)
+{
+    if (! gf65536_supports(params))
+        return nullptr;
+    if (! gf65536_init()) {
+        printf("gf65536_init failed\n");
+        return nullptr;
+    }
+    return std::unique_ptr<StripeCodec>(new GF65536StripeCodec(params));
+}
+
+std::unique_ptr<StripeEncoder> gf65536_create_stripe_encoder(ECC_bench_params params)
+{
+    return gf65536_create_stripe_codec(params);
+}
+
+
+// Timers of all operations: decoder setup for the erasure pattern is measured separately from the processing of stripe data
+struct GF65536Timers
+{
+    OperationTimer encode;
+    OperationTimer decode_one_setup, decode_one;
+    OperationTimer decode_all_setup, decode_all;
+};
+
+
+// Perform single decoding operation with the decoder setup for the erasure pattern,
+// and check the recovered data on the first call. Return false if it fails
+bool gf65536_benchmark_decode(
+    ECC_bench_params params,
+    const std::vector<char>& lost,
+    const uint8_t* const* original,
+    const uint8_t* const* recovery,
+    uint8_t* workBlocks,
+    uint8_t* recoveredBlocks,
+    OperationTimer& setup_time,
+    OperationTimer& decode_time)
+{
+    GF65536Decoder decoder;
+    setup_time.BeginCall();
+    bool succeeded = decoder.Init(params, lost);
+    setup_time.EndCall();
+    if (! succeeded) {
+        printf("  gf65536 decoder setup failed: not enough recovery blocks\n");
+        return false;
+    }
+
+    std::vector<uint8_t*> work(decoder.Lost.size()), out(decoder.Lost.size());
+    for (size_t b = 0; b < decoder.Lost.size(); ++b) {
+        work[b] = workBlocks + b * params.BlockBytes;
+        out[b] = recoveredBlocks + b * params.BlockBytes;
+    }
+
+    decode_time.BeginCall();
+    decoder.Decode(params, original, recovery, work.data(), out.data(), gf65536_best_kernel(params.Isa));
+    decode_time.EndCall();
+
+    // Check the recovered data, but only once since it's slow
+    if (! decode_time.Checked) {
+        decode_time.Checked = true;
+        for (size_t b = 0; b < decoder.Lost.size(); ++b) {
+            if (memcmp(out[b], original[decoder.Lost[b]], params.BlockBytes)) {
+                printf("  gf65536 decoding failed: recovered block %d doesn't match original data\n", decoder.Lost[b]);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+// Compare all kernels allowed by params.Isa side by side. Return false if any kernel produces wrong results
+bool gf65536_benchmark_kernels(ECC_bench_params params, uint8_t* buffer)
+{
+    if (params.OriginalCount * params.RecoveryCount > GF65536_MAX_KERNEL_PRODUCTS) {
+        printf("  kernels: skipped, compared only for data_blocks*parity_blocks <= %d\n", GF65536_MAX_KERNEL_PRODUCTS);
+        return true;
+    }
+
+    // Places for original and parity data, and the reference parity data computed by the scalar kernel
+    auto originalFileData = buffer;
+    auto recoveryBlocks   = buffer + params.OriginalFileBytes();
+    auto expectedBlocks   = recoveryBlocks + params.RecoveryDataBytes();
+
+    std::vector<const uint8_t*> data(params.OriginalCount);
+    std::vector<uint8_t*> out(params.RecoveryCount), expected(params.RecoveryCount);
+    for (int i = 0; i < params.OriginalCount; ++i)
+        data[i] = originalFileData + i * params.BlockBytes;
+    for (int i = 0; i < params.RecoveryCount; ++i) {
+        out[i] = recoveryBlocks + i * params.BlockBytes;
+        expected[i] = expectedBlocks + i * params.BlockBytes;
+    }
+    gf65536_encode(params, data.data(), expected.data(), GF65536_SCALAR);
+
+    for (int k = 0; k < GF65536_KERNELS; ++k)
+    {
+        GF65536Kernel kernel = GF65536Kernel(k);
+        if (! gf65536_kernel_supported(kernel, params.Isa))
+            continue;
+
+        OperationTimer encode_time;
+        for (TrialLoop trial(params); trial.Next(); )
+        {
+            encode_time.BeginCall();
+            gf65536_encode(params, data.data(), out.data(), kernel);
+            encode_time.EndCall();
+
+            // Check the results, but only once since it's slow
+            if (trial.Trial == 1  &&  memcmp(recoveryBlocks, expectedBlocks, params.RecoveryDataBytes())) {
+                printf("  %s kernel failed: parity data doesn't match the scalar kernel\n", gf65536_kernel_name[kernel]);
+                return false;
+            }
+        }
+
+        char operation[64];
+        snprintf(operation, sizeof(operation), "encode %s", gf65536_kernel_name[kernel]);
+        encode_time.Print(operation, params.OriginalFileBytes());
+    }
+
+    return true;
+}
+
+
+// Run all benchmark trials on a single codeword, return false if anything failed
+bool gf65536_benchmark_trials(ECC_bench_params params, uint8_t* buffer, GF65536Timers& timers)
+{
+    // Places for original, parity, intermediate and recovered data
+    auto originalFileData = buffer;
+    auto recoveryBlocks   = buffer + params.OriginalFileBytes();
+    auto workBlocks       = recoveryBlocks + params.RecoveryDataBytes();
+    auto recoveredBlocks  = workBlocks + params.RecoveryDataBytes();
+
+    std::vector<const uint8_t*> data(params.OriginalCount), recovery(params.RecoveryCount);
+    std::vector<uint8_t*> out(params.RecoveryCount);
+    for (int i = 0; i < params.OriginalCount; ++i)
+        data[i] = originalFileData + i * params.BlockBytes;
+    for (int i = 0; i < params.RecoveryCount; ++i)
+        recovery[i] = out[i] = recoveryBlocks + i * params.BlockBytes;
+
+    // Lose the first original block, or as many first original blocks as possible
+    std::vector<char> lost_one(params.OriginalCount + params.RecoveryCount, 0), lost_all(lost_one);
+    lost_one[0] = 1;
+    for (int i = 0; i < std::min(params.OriginalCount, params.RecoveryCount); ++i)
+        lost_all[i] = 1;
+
+    GF65536Kernel kernel = gf65536_best_kernel(params.Isa);
+
+    // Repeat benchmark multiple times to improve its accuracy
+    for (TrialLoop trial(params); trial.Next(); )
+    {
+        timers.encode.BeginCall();
+        gf65536_encode(params, data.data(), out.data(), kernel);
+        timers.encode.EndCall();
+
+        if (! gf65536_benchmark_decode(params, lost_one, data.data(), recovery.data(), workBlocks, recoveredBlocks,
+                                       timers.decode_one_setup, timers.decode_one)) {
+            return false;
+        }
+        if (! gf65536_benchmark_decode(params, lost_all, data.data(), recovery.data(), workBlocks, recoveredBlocks,
+                                       timers.decode_all_setup, timers.decode_all)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// Benchmark library and print results, return false if anything failed
+bool gf65536_benchmark_main(ECC_bench_params params, uint8_t* buffer)
+{
+    if (! gf65536_supports(params))
+        return false;
+
+    // Build log/exp tables
+    OperationTimer init_time(0);
+    init_time.BeginCall();
+    if (! gf65536_init()) {
+        printf("gf65536_init failed\n");
+        return false;
+    }
+    init_time.EndCall();
+
+    // The fastest kernel supported by CPU and allowed by params.Isa
+    printf("GF65536 (%s, %d-bit):\n", gf65536_kernel_name[gf65536_best_kernel(params.Isa)], int(sizeof(size_t)*8));
+    init_time.PrintTime("init");
+
+    GF65536Timers timers;
+    if (! gf65536_benchmark_trials(params, buffer, timers)) {
+        return false;
+    }
+
+    // Benchmark reports for each operation
+    timers.encode.Print("encode", params.OriginalFileBytes());
+    timers.decode_one_setup.PrintTime("decode one setup");
+    timers.decode_one.Print("decode one", params.BlockBytes);
+    timers.decode_all_setup.PrintTime("decode all setup");
+    timers.decode_all.Print("decode all", params.RecoveryDataBytes());
+
+    if (! gf65536_benchmark_kernels(params, buffer)) {
+        return false;
+    }
+
+    // Repeat the same benchmark on multiple cores simultaneously, each thread processing its own codeword
+    if (params.Threads > 1)
+    {
+        if (! run_scaling_on_threads(params, buffer, timers,
+                [&](uint8_t* thread_buffer, GF65536Timers& thread_timers) {
+                    return gf65536_benchmark_trials(params, thread_buffer, thread_timers);
+                },
+                {{"encode", &GF65536Timers::encode, params.OriginalFileBytes()},
+                 {"decode one", &GF65536Timers::decode_one, uint64_t(params.BlockBytes)},
+                 {"decode all", &GF65536Timers::decode_all, params.RecoveryDataBytes()}})) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+ISA_BUILD_END
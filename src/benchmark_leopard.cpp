@@ -2,7 +2,10 @@
 // Benchmarking Leopard library: https://github.com/catid/leopard
 //
 
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
+#include <cstdint>
 #include <memory>
 
 #include "common.h"
@@ -20,6 +23,161 @@
 #include "LeopardCommon.cpp"
 #include "leopard.cpp"
 
+ISA_BUILD_BEGIN
+
+
+// Leopard has scalar, SSSE3 and AVX2 code paths, the latter only if compiled with AVX2 support.
+// The AVX-512 build runs the AVX2 code path, with the rest of the library compiled for AVX-512
+bool leopard_has_isa(int isa)
+{
+    return isa == ISA_SCALAR
+#ifndef GF256_TARGET_MOBILE
+        ||  isa == ISA_SSSE3
+#  ifdef GF256_TRY_AVX2
+        ||  isa == ISA_AVX2
+#  endif
+#  if defined(GF256_TRY_AVX2) && defined(__AVX512BW__)
+        ||  isa == ISA_AVX512
+#  endif
+#endif
+        ;
+}
+
+
+// Restrict SIMD code paths of Leopard to the instruction set. leo_init() detects CPU features
+// only on the first call, so we save them to restore later
+static void leopard_limit_isa(int isa)
+{
+#ifndef GF256_TARGET_MOBILE
+#  ifdef GF256_TRY_AVX2
+    static const bool has_avx2 = leopard::CpuHasAVX2;
+    leopard::CpuHasAVX2 = has_avx2  &&  isa >= ISA_AVX2;
+#  endif
+    static const bool has_ssse3 = leopard::CpuHasSSSE3;
+    leopard::CpuHasSSSE3 = has_ssse3  &&  isa >= ISA_SSSE3;
+#endif
+}
+
+
+// Field used for the params: the one forced by params.LeopardBits, otherwise the smallest one fitting the codeword,
+// as leo_encode() and leo_decode() choose it. Return 0 if the field isn't compiled in or too small for the codeword
+static int leopard_field_bits(ECC_bench_params params)
+{
+    unsigned m = leopard::NextPow2(params.RecoveryCount);
+    unsigned n = leopard::NextPow2(m + params.OriginalCount);
+
+#ifdef LEO_HAS_FF8
+    if (n <= leopard::ff8::kOrder  &&  params.LeopardBits != 16)
+        return 8;
+#endif
+#ifdef LEO_HAS_FF16
+    if (n <= leopard::ff16::kOrder  &&  params.LeopardBits != 8)
+        return 16;
+#endif
+    return 0;
+}
+
+
+// Up to 2^16 blocks (2^8 in GF(2^8)), and data blocks >= parity blocks
+bool leopard_supports(ECC_bench_params params)
+{
+    return params.OriginalCount + params.RecoveryCount <= 65536  &&
+           params.OriginalCount >= params.RecoveryCount  &&
+           leopard_field_bits(params) != 0;
+}
+
+
+// leo_encode() with the field chosen by leopard_field_bits(). Without params.LeopardBits, it's just leo_encode(),
+// otherwise it repeats its checks and special cases, and calls the encoder of the field directly
+static LeopardResult leopard_encode(
+    ECC_bench_params params,
+    unsigned work_count,
+    const void* const* original_data,
+    void** work_data)
+{
+    if (! params.LeopardBits)
+        return leo_encode(params.BlockBytes, params.OriginalCount, params.RecoveryCount, work_count, original_data, work_data);
+
+    if (params.BlockBytes % 64 != 0)
+        return Leopard_InvalidSize;
+    if (work_count < leo_encode_work_count(params.OriginalCount, params.RecoveryCount))
+        return Leopard_InvalidInput;
+
+    // Recovery blocks of a single original block are its copies
+    if (params.OriginalCount == 1) {
+        for (int i = 0; i < params.RecoveryCount; ++i)
+            memcpy(work_data[i], original_data[0], params.BlockBytes);
+        return Leopard_Success;
+    }
+
+    unsigned m = leopard::NextPow2(params.RecoveryCount);
+    switch (leopard_field_bits(params)) {
+#ifdef LEO_HAS_FF8
+        case 8:   leopard::ff8::ReedSolomonEncode(params.BlockBytes, params.OriginalCount, params.RecoveryCount, m, original_data, work_data);
+                  return Leopard_Success;
+#endif
+#ifdef LEO_HAS_FF16
+        case 16:  leopard::ff16::ReedSolomonEncode(params.BlockBytes, params.OriginalCount, params.RecoveryCount, m, original_data, work_data);
+                  return Leopard_Success;
+#endif
+        default:  return Leopard_TooMuchData;
+    }
+}
+
+
+// leo_decode() with the field chosen by leopard_field_bits(), in the same way
+static LeopardResult leopard_decode(
+    ECC_bench_params params,
+    unsigned work_count,
+    const void* const* original_data,
+    const void* const* recovery_data,
+    void** work_data)
+{
+    if (! params.LeopardBits)
+        return leo_decode(params.BlockBytes, params.OriginalCount, params.RecoveryCount, work_count, original_data, recovery_data, work_data);
+
+    if (params.BlockBytes % 64 != 0)
+        return Leopard_InvalidSize;
+    if (work_count < leo_decode_work_count(params.OriginalCount, params.RecoveryCount))
+        return Leopard_InvalidInput;
+
+    int original_loss_count = 0, recovery_got_count = 0, recovery_got_i = 0;
+    for (int i = 0; i < params.OriginalCount; ++i)
+        if (! original_data[i])
+            ++original_loss_count;
+    for (int i = 0; i < params.RecoveryCount; ++i)
+        if (recovery_data[i]) {
+            ++recovery_got_count;
+            recovery_got_i = i;
+        }
+    if (original_loss_count == 0)
+        return Leopard_Success;
+    if (recovery_got_count < original_loss_count)
+        return Leopard_NeedMoreData;
+
+    // Any recovery block of a single original block is its copy
+    if (params.OriginalCount == 1) {
+        memcpy(work_data[0], recovery_data[recovery_got_i], params.BlockBytes);
+        return Leopard_Success;
+    }
+
+    unsigned m = leopard::NextPow2(params.RecoveryCount);
+    unsigned n = leopard::NextPow2(m + params.OriginalCount);
+    switch (leopard_field_bits(params)) {
+#ifdef LEO_HAS_FF8
+        case 8:   leopard::ff8::ReedSolomonDecode(params.BlockBytes, params.OriginalCount, params.RecoveryCount, m, n,
+                                                  original_data, recovery_data, work_data);
+                  return Leopard_Success;
+#endif
+#ifdef LEO_HAS_FF16
+        case 16:  leopard::ff16::ReedSolomonDecode(params.BlockBytes, params.OriginalCount, params.RecoveryCount, m, n,
+                                                   original_data, recovery_data, work_data);
+                  return Leopard_Success;
+#endif
+        default:  return Leopard_TooMuchData;
+    }
+}
+
 
 // Extra workspace used by the library on top of place required for original data
 size_t leopard_extra_space(ECC_bench_params params)
@@ -30,6 +188,177 @@ size_t leopard_extra_space(ECC_bench_params params)
 }
 
 
+// Encoder reads original blocks and transforms its work blocks in-place, the first of them becoming recovery blocks
+size_t leopard_encode_working_set(ECC_bench_params params)
+{
+    return params.OriginalFileBytes() + params.BlockBytes * leo_encode_work_count(params.OriginalCount, params.RecoveryCount);
+}
+
+// Leopard internals used by the matrix decoder, for each of the two fields supported by the library
+struct LeopardFF8
+{
+    typedef leopard::ff8::ffe_t ffe_t;
+    static const unsigned kOrder = leopard::ff8::kOrder;
+    static const unsigned kModulus = leopard::ff8::kModulus;
+    static unsigned Log(unsigned x)  { return leopard::ff8::LogLUT[x]; }
+    static void MulMem(void* x, const void* y, unsigned log_m, uint64_t bytes)  { leopard::ff8::mul_mem(x, y, ffe_t(log_m), bytes); }
+};
+
+struct LeopardFF16
+{
+    typedef leopard::ff16::ffe_t ffe_t;
+    static const unsigned kOrder = leopard::ff16::kOrder;
+    static const unsigned kModulus = leopard::ff16::kModulus;
+    static unsigned Log(unsigned x)  { return leopard::ff16::LogLUT[x]; }
+    static void MulMem(void* x, const void* y, unsigned log_m, uint64_t bytes)  { leopard::ff16::mul_mem(x, y, ffe_t(log_m), bytes); }
+};
+
+
+// Recover a few lost original blocks directly by Lagrange interpolation. Each recovered block is a linear combination
+// of K surviving blocks, so recovery of L blocks requires O(L*K) operations per byte, plus O(K*L + kOrder*log(kOrder))
+// to compute the coefficients (the transform of the log table is computed once per field). It's faster than leo_decode()
+// for small L, since FFT-based decoding time doesn't depend on the number of erasures.
+//
+// Leopard codeword is the evaluation of polynomial of order n-m at points 0..n-1 of the field in its internal representation,
+// where m = NextPow2(recovery_count) and n = NextPow2(m + original_count). Recovery blocks occupy positions 0..m-1
+// (only the first recovery_count of them are stored), original blocks occupy positions m..m+original_count-1,
+// and the remaining positions are zeroes.
+template <typename Field>
+struct LeopardMatrixDecoder
+{
+    std::vector<const void*> Sources;   // blocks used for recovery
+    std::vector<unsigned> Recover;      // indexes of original blocks to recover
+    std::vector<unsigned> LogCoef;      // LogCoef[r*Sources.size()+s]: log of multiplier of Sources[s] in the recovered block Recover[r]
+
+    // Walsh-Hadamard transform modulo kModulus. Elements are < kModulus, so sums are reduced by a single subtraction
+    static void FWHT(std::vector<unsigned>& a)
+    {
+        for (size_t len = 1; len < a.size(); len *= 2)
+            for (size_t i = 0; i < a.size(); i += 2*len)
+                for (size_t j = i; j < i+len; ++j)
+                {
+                    unsigned x = a[j], y = a[j+len];
+                    unsigned sum = x + y,  diff = x + Field::kModulus - y;
+                    a[j]     = (sum  >= Field::kModulus? sum  - Field::kModulus : sum);
+                    a[j+len] = (diff >= Field::kModulus? diff - Field::kModulus : diff);
+                }
+    }
+
+    // Walsh-Hadamard transform of the log table, with log(0) taken as 0 to exclude t==s from the products in Init().
+    // It depends only on the field, so it's computed on the first call, after leo_init() has built the log table
+    static const std::vector<unsigned>& LogsFWHT()
+    {
+        static const std::vector<unsigned> transformed = []() {
+            std::vector<unsigned> logs(Field::kOrder);
+            for (unsigned x = 1; x < Field::kOrder; ++x)
+                logs[x] = Field::Log(x) % Field::kModulus;
+            logs[0] = 0;
+            FWHT(logs);
+            return logs;
+        }();
+        return transformed;
+    }
+
+    // Error locator of leo_decode(): logarithms of Prod(x-e) over erased points e, evaluated at all points x of the field.
+    // Erased points are the lost blocks and recovery positions past recovery_count. It's the per-codeword setup
+    // of leo_decode(), that depends only on the erasure pattern, computed with the same two transforms
+    static void ErrorLocator(unsigned original_count, unsigned recovery_count, const void* const* original,
+                             const void* const* recovery, std::vector<unsigned>& locator)
+    {
+        const unsigned m = leopard::NextPow2(recovery_count);
+        locator.assign(Field::kOrder, 0);
+        for (unsigned i = 0; i < m; ++i)
+            locator[i] = (i >= recovery_count  ||  ! recovery[i]);
+        for (unsigned i = 0; i < original_count; ++i)
+            locator[m+i] = ! original[i];
+
+        const std::vector<unsigned>& logs = LogsFWHT();
+        FWHT(locator);
+        for (unsigned x = 0; x < Field::kOrder; ++x)
+            locator[x] = unsigned(uint64_t(locator[x]) * logs[x] % Field::kModulus);
+        FWHT(locator);
+    }
+
+    // Prepare recovery of original blocks that are nullptr. Return false if there is not enough blocks for recovery
+    bool Init(unsigned original_count, unsigned recovery_count, const void* const* original, const void* const* recovery)
+    {
+        const unsigned m = leopard::NextPow2(recovery_count);
+        const unsigned n = leopard::NextPow2(m + original_count);
+
+        // The polynomial has order n-m, so we need exactly n-m known points: all original blocks that aren't lost,
+        // zeroes following them, and a recovery block per each lost original block
+        std::vector<unsigned> known(Field::kOrder, 0), sources;
+        Recover.clear();
+        Sources.clear();
+        for (unsigned i = 0; i < original_count; ++i)
+        {
+            if (original[i]) {
+                known[m+i] = 1;
+                sources.push_back(m+i);
+                Sources.push_back(original[i]);
+            } else {
+                Recover.push_back(i);
+            }
+        }
+        for (unsigned x = m + original_count; x < n; ++x)
+            known[x] = 1;
+        for (unsigned i = 0; i < recovery_count  &&  sources.size() < original_count; ++i)
+        {
+            if (recovery[i]) {
+                known[i] = 1;
+                sources.push_back(i);
+                Sources.push_back(recovery[i]);
+            }
+        }
+        if (sources.size() < original_count)
+            return false;
+
+        // Lagrange coefficient of the point s for the point e is Prod(e-t)/(e-s) / Prod(s-t),
+        // where both products are taken over all known points t, except for t==s in the second one.
+        // In GF(2^k), x-y == x^y, so the logarithm of each product is the dyadic convolution
+        // conv[y] = Sum(Log(y^t)) over known t, computed with Walsh-Hadamard transform.
+        // The inverse transform is the same as the forward one, since kOrder == 1 modulo kModulus
+        const std::vector<unsigned>& logs = LogsFWHT();
+        FWHT(known);
+        for (unsigned x = 0; x < Field::kOrder; ++x)
+            known[x] = unsigned(uint64_t(known[x]) * logs[x] % Field::kModulus);
+        FWHT(known);
+        const std::vector<unsigned>& conv = known;
+
+        LogCoef.resize(Recover.size() * sources.size());
+        for (size_t r = 0; r < Recover.size(); ++r)
+        {
+            unsigned e = m + Recover[r];
+            for (size_t s = 0; s < sources.size(); ++s)
+            {
+                unsigned log_e_s = Field::Log(e ^ sources[s]) % Field::kModulus;
+                LogCoef[r*sources.size()+s] = (conv[e] + 2*Field::kModulus - log_e_s - conv[sources[s]]) % Field::kModulus;
+            }
+        }
+        return true;
+    }
+
+    // Recover original blocks Recover[r] into output[r], using temp block as workspace
+    void Decode(uint64_t buffer_bytes, void** output, void* temp)
+    {
+        // Read each source block once and add it to all recovered blocks
+        for (size_t s = 0; s < Sources.size(); ++s)
+        {
+            for (size_t r = 0; r < Recover.size(); ++r)
+            {
+                unsigned log_m = LogCoef[r*Sources.size()+s];
+                if (s == 0) {
+                    Field::MulMem(output[r], Sources[s], log_m, buffer_bytes);
+                } else {
+                    Field::MulMem(temp, Sources[s], log_m, buffer_bytes);
+                    leopard::xor_mem(output[r], temp, buffer_bytes);
+                }
+            }
+        }
+    }
+};
+
+
 // Perform single encoding operation, return false if it fails
 bool leopard_benchmark_encode(
     ECC_bench_params params,
@@ -40,10 +369,8 @@ bool leopard_benchmark_encode(
 {
     // Generate recovery data
     encode_time.BeginCall();
-    LeopardResult encodeResult = leo_encode(
-        params.BlockBytes,
-        params.OriginalCount,
-        params.RecoveryCount,
+    LeopardResult encodeResult = leopard_encode(
+        params,
         encode_work_count,
         original_data,
         parity_data
@@ -60,6 +387,102 @@ bool leopard_benchmark_encode(
 }
 
 
+// Stripe encoder reusing its workspace for all stripes (FFT tables are built once by leo_init).
+// Recovery data are written to the first RecoveryCount work blocks, so we point them directly to the output,
+// and keep only the remaining work blocks in our own workspace. The decoder workspace is allocated on the first decoding
+class LeopardStripeCodec : public StripeCodec
+{
+public:
+    explicit LeopardStripeCodec(ECC_bench_params params)
+        : Params(params),
+          EncodeWorkCount(leo_encode_work_count(params.OriginalCount, params.RecoveryCount)),
+          DecodeWorkCount(leo_decode_work_count(params.OriginalCount, params.RecoveryCount)),
+          Work((EncodeWorkCount - params.RecoveryCount) * params.BlockBytes),
+          OriginalData(params.OriginalCount),
+          RecoveryData(params.RecoveryCount),
+          WorkData(EncodeWorkCount),
+          DecodeWorkData(DecodeWorkCount)
+    {
+        for (unsigned i = params.RecoveryCount; i < EncodeWorkCount; ++i)
+            WorkData[i] = Work.data() + (i - params.RecoveryCount) * params.BlockBytes;
+    }
+
+    bool Encode(uint8_t* original, uint8_t* recovery) override
+    {
+        for (int i = 0; i < Params.OriginalCount; ++i)
+            OriginalData[i] = original + i * Params.BlockBytes;
+        for (int i = 0; i < Params.RecoveryCount; ++i)
+            WorkData[i] = recovery + i * Params.BlockBytes;
+
+        LeopardResult encodeResult = leopard_encode(
+            Params,
+            EncodeWorkCount,
+            &OriginalData[0],
+            &WorkData[0]);
+
+        if (encodeResult != Leopard_Success) {
+            printf("  leo_encode failed: %s\n", leo_result_string(encodeResult));
+            return false;
+        }
+        return true;
+    }
+
+    // leo_decode() writes recovered original block i into the work block i, so it's copied to its place
+    bool Decode(uint8_t* original, uint8_t* recovery, const std::vector<char>& lost) override
+    {
+        if (! DecodeWork) {
+            DecodeWork.reset(new AlignedBuffer(DecodeWorkCount * Params.BlockBytes));
+            for (unsigned i = 0; i < DecodeWorkCount; ++i)
+                DecodeWorkData[i] = DecodeWork->data() + i * Params.BlockBytes;
+        }
+        for (int i = 0; i < Params.OriginalCount; ++i)
+            OriginalData[i] = (lost[i]? nullptr : original + i * Params.BlockBytes);
+        for (int i = 0; i < Params.RecoveryCount; ++i)
+            RecoveryData[i] = (lost[Params.OriginalCount + i]? nullptr : recovery + i * Params.BlockBytes);
+
+        LeopardResult decodeResult = leopard_decode(
+            Params,
+            DecodeWorkCount,
+            &OriginalData[0],
+            &RecoveryData[0],
+            &DecodeWorkData[0]);
+
+        if (decodeResult != Leopard_Success)
+            return false;
+        for (int i = 0; i < Params.OriginalCount; ++i) {
+            if (lost[i])
+                memcpy(original + i * Params.BlockBytes, DecodeWorkData[i], Params.BlockBytes);
+        }
+        return true;
+    }
+
+private:
+    ECC_bench_params Params;
+    unsigned EncodeWorkCount, DecodeWorkCount;
+    AlignedBuffer Work;
+    std::unique_ptr<AlignedBuffer> DecodeWork;
+    std::vector<void*> OriginalData, RecoveryData, WorkData, DecodeWorkData;
+};
+
+
+std::unique_ptr<StripeCodec> leopard_create_stripe_codec(ECC_bench_params params)
+{
+    if (leo_init()) {
+        printf("leo_init failed\n");
+        return nullptr;
+    }
+    leopard_limit_isa(params.Isa);
+    if (leo_encode_work_count(params.OriginalCount, params.RecoveryCount) == 0)  // 0 means unsupported data+parity combination
+        return nullptr;
+    return std::unique_ptr<StripeCodec>(new LeopardStripeCodec(params));
+}
+
+std::unique_ptr<StripeEncoder> leopard_create_stripe_encoder(ECC_bench_params params)
+{
+    return leopard_create_stripe_codec(params);
+}
+
+
 // Perform single decoding operation, return false if it fails
 bool leopard_benchmark_decode(
     ECC_bench_params params,
@@ -70,10 +493,8 @@ bool leopard_benchmark_decode(
     OperationTimer& decode_time)
 {
     decode_time.BeginCall();
-    LeopardResult decodeResult = leo_decode(
-        params.BlockBytes,
-        params.OriginalCount,
-        params.RecoveryCount,
+    LeopardResult decodeResult = leopard_decode(
+        params,
         decode_work_count,
         originalFileData_losing_one,
         recoveryBlocks,
@@ -90,38 +511,22 @@ bool leopard_benchmark_decode(
 }
 
 
-// Benchmark library and print results, return false if anything failed
-bool leopard_benchmark_main(ECC_bench_params params, uint8_t* buffer)
+// Timers of all operations
+struct LeopardTimers
 {
-    // Total encode/decode times
-    OperationTimer encode_time, decode_one_time, decode_all_time;
+    OperationTimer encode, decode_one, decode_all;
+};
 
-    if (leo_init()) {
-        printf("leo_init failed\n");
-        return false;
-    }
 
+// Run all benchmark trials on a single codeword, return false if anything failed
+bool leopard_benchmark_trials(
+    ECC_bench_params params,
+    uint8_t* buffer,
+    LeopardTimers& timers)
+{
     size_t encode_work_count = leo_encode_work_count(params.OriginalCount, params.RecoveryCount);
     size_t decode_work_count = leo_decode_work_count(params.OriginalCount, params.RecoveryCount);
 
-    if (encode_work_count == 0)  // 0 means unsupported data+parity combination
-        return false;
-
-    // Print CPU SIMD extensions used to accelerate library in this run
-    // (depends on compilation options such as -mavx2 and actual CPU)
-    printf("Leopard (%s, %d-bit):\n",
-#ifndef GF256_TARGET_MOBILE
-#  ifdef GF256_TRY_AVX2
-        leopard::CpuHasAVX2? "avx2":
-#  endif
-        leopard::CpuHasSSSE3? "ssse3":
-#endif
-#if defined(GF256_TRY_NEON)
-        leopard::CpuHasNeon64? "neon64":
-        leopard::CpuHasNeon? "neon":
-#endif
-        "", sizeof(size_t)*8);
-
     // Pointers to data
     std::vector<uint8_t*> original_data(params.OriginalCount);
     std::vector<uint8_t*> original_data_losing_one(params.OriginalCount);
@@ -157,26 +562,336 @@ bool leopard_benchmark_main(ECC_bench_params params, uint8_t* buffer)
     void** originalFileData_losing_most_possible = (void**)&original_data_losing_most_possible[0];
 
     // Repeat benchmark multiple times to improve its accuracy
-    for (int trial = 0; trial < params.Trials; ++trial)
+    for (TrialLoop trial(params); trial.Next(); )
     {
         if (! leopard_benchmark_encode(params, encode_work_count,
-                originalFileData, recoveryBlocks, encode_time)) {
+                originalFileData, recoveryBlocks, timers.encode)) {
             return false;
         }
         if (! leopard_benchmark_decode(params, decode_work_count,
-                originalFileData_losing_one, recoveryBlocks, decoderWorkArea, decode_one_time)) {
+                originalFileData_losing_one, recoveryBlocks, decoderWorkArea, timers.decode_one)) {
             return false;
         }
         if (! leopard_benchmark_decode(params, decode_work_count,
-                originalFileData_losing_most_possible, recoveryBlocks, decoderWorkArea, decode_all_time)) {
+                originalFileData_losing_most_possible, recoveryBlocks, decoderWorkArea, timers.decode_all)) {
             return false;
         }
     }
 
+    return true;
+}
+
+
+// leo_decode() computes the error locator polynomial for the erasure pattern and then processes the data in a single call,
+// so we measure its setup as the same computation performed by LeopardMatrixDecoder::ErrorLocator()
+template <typename Field>
+bool leopard_benchmark_setup_field(ECC_bench_params params)
+{
+    size_t max_lost = std::min(params.OriginalCount, params.RecoveryCount);
+    LeopardMatrixDecoder<Field>::LogsFWHT();   // one-time setup
+
+    // Only the presence of blocks matters, so all of them point to the same place
+    static const uint8_t present = 0;
+    std::vector<const void*> losing_one(params.OriginalCount, &present), losing_most_possible(params.OriginalCount, &present);
+    std::vector<const void*> recovery(params.RecoveryCount, &present);
+    losing_one[0] = nullptr;
+    for (size_t i = 0; i < max_lost; ++i)
+        losing_most_possible[i] = nullptr;
+
+    OperationTimer decode_one_setup, decode_all_setup;
+    std::vector<unsigned> locator;
+    for (TrialLoop trial(params); trial.Next(); )
+    {
+        decode_one_setup.BeginCall();
+        LeopardMatrixDecoder<Field>::ErrorLocator(params.OriginalCount, params.RecoveryCount, &losing_one[0], &recovery[0], locator);
+        decode_one_setup.EndCall();
+
+        decode_all_setup.BeginCall();
+        LeopardMatrixDecoder<Field>::ErrorLocator(params.OriginalCount, params.RecoveryCount, &losing_most_possible[0], &recovery[0], locator);
+        decode_all_setup.EndCall();
+    }
+
+    decode_one_setup.PrintTime("decode one setup");
+    decode_all_setup.PrintTime("decode all setup");
+    return true;
+}
+
+
+// Perform single hybrid decoding operation: matrix decoding for less than `crossover` lost blocks,
+// and leo_decode() for larger amounts. Return false if it fails
+template <typename Field>
+bool leopard_benchmark_hybrid_decode(
+    ECC_bench_params params,
+    size_t decode_work_count,
+    void** originalFileData,
+    void** originalFileData_losing,
+    size_t lost,
+    void** recoveryBlocks,
+    void** decoderWorkArea,
+    size_t crossover,
+    OperationTimer& decode_time)
+{
+    if (lost >= crossover)
+        return leopard_benchmark_decode(params, decode_work_count,
+                   originalFileData_losing, recoveryBlocks, decoderWorkArea, decode_time);
+
+    // Recovered blocks are written to the decoder work area, and its last block is used as temporary buffer
+    decode_time.BeginCall();
+    LeopardMatrixDecoder<Field> decoder;
+    if (! decoder.Init(params.OriginalCount, params.RecoveryCount, originalFileData_losing, recoveryBlocks)) {
+        printf("  Leopard matrix decoder failed: not enough blocks for recovery\n");
+        return false;
+    }
+    decoder.Decode(params.BlockBytes, decoderWorkArea, decoderWorkArea[decode_work_count-1]);
+    decode_time.EndCall();
+
+    // Check the recovered data, but only once since it's slow
+    if (! decode_time.Checked) {
+        decode_time.Checked = true;
+        for (size_t r = 0; r < decoder.Recover.size(); ++r) {
+            if (memcmp(decoderWorkArea[r], originalFileData[decoder.Recover[r]], params.BlockBytes)) {
+                printf("  Leopard matrix decoder failed: recovered block %d doesn't match original data\n", int(decoder.Recover[r]));
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+// Find the smallest number of lost blocks for which matrix decoding is slower than leo_decode(),
+// or 0 if any decoding fails
+template <typename Field>
+size_t leopard_hybrid_crossover(
+    ECC_bench_params params,
+    size_t decode_work_count,
+    void** originalFileData,
+    void** recoveryBlocks,
+    void** decoderWorkArea)
+{
+    const int REPEATS = 3;   // use the best time of a few runs
+    size_t max_lost = std::min(params.OriginalCount, params.RecoveryCount);
+    std::vector<void*> losing(params.OriginalCount);
+
+    // Lose the first `lost` original blocks
+    auto lose = [&](size_t lost) {
+        for (unsigned i = 0; i < params.OriginalCount; ++i)
+            losing[i] = (i < lost? nullptr : originalFileData[i]);
+    };
+
+    // FFT decoding time doesn't depend on the number of lost blocks
+    OperationTimer fft_time(0);   // no warmup, since only the best time is used
+    lose(max_lost);
+    for (int i = 0; i < REPEATS; ++i)
+        if (! leopard_benchmark_decode(params, decode_work_count, &losing[0], recoveryBlocks, decoderWorkArea, fft_time))
+            return 0;
+
+    // A failed matrix decoding stops the search, and the crossover is reported as 0
+    bool failed = false;
+    auto matrix_is_faster = [&](size_t lost) {
+        if (failed)
+            return false;
+        OperationTimer matrix_time(0);
+        lose(lost);
+        for (int i = 0; i < REPEATS; ++i)
+            if (! leopard_benchmark_hybrid_decode<Field>(params, decode_work_count, originalFileData,
+                      &losing[0], lost, recoveryBlocks, decoderWorkArea, SIZE_MAX, matrix_time)) {
+                failed = true;
+                return false;
+            }
+        return matrix_time.MinCallUsec < fft_time.MinCallUsec;
+    };
+
+    // Exponential search followed by binary search
+    size_t faster = 0, slower = 1;
+    while (slower <= max_lost  &&  matrix_is_faster(slower)) {
+        faster = slower;
+        slower *= 2;
+    }
+    if (slower > max_lost) {
+        if (faster == max_lost  ||  matrix_is_faster(max_lost))
+            return failed? 0 : max_lost+1;
+        slower = max_lost;
+    }
+    while (slower - faster > 1) {
+        size_t middle = (faster + slower) / 2;
+        if (matrix_is_faster(middle))
+            faster = middle;
+        else
+            slower = middle;
+    }
+    return failed? 0 : slower;
+}
+
+
+// Benchmark hybrid decoder that employs matrix decoding when it's faster than leo_decode()
+template <typename Field>
+bool leopard_benchmark_hybrid_field(ECC_bench_params params, uint8_t* buffer)
+{
+    size_t encode_work_count = leo_encode_work_count(params.OriginalCount, params.RecoveryCount);
+    size_t decode_work_count = leo_decode_work_count(params.OriginalCount, params.RecoveryCount);
+    size_t max_lost = std::min(params.OriginalCount, params.RecoveryCount);
+
+    // Pointers to data
+    std::vector<void*> original_data(params.OriginalCount);
+    std::vector<void*> original_data_losing_one(params.OriginalCount);
+    std::vector<void*> original_data_losing_most_possible(params.OriginalCount);
+    std::vector<void*> encode_work_data(encode_work_count);
+    std::vector<void*> decode_work_data(decode_work_count);
+
+    for (unsigned i = 0; i < params.OriginalCount; ++i) {
+        original_data[i] = buffer;
+        original_data_losing_one[i] = (i==0? nullptr : buffer);
+        original_data_losing_most_possible[i] = (i < max_lost? nullptr : buffer);
+        buffer += params.BlockBytes;
+    }
+    for (unsigned i = 0; i < encode_work_count; ++i) {
+        encode_work_data[i] = buffer;
+        buffer += params.BlockBytes;
+    }
+    for (unsigned i = 0; i < decode_work_count; ++i) {
+        decode_work_data[i] = buffer;
+        buffer += params.BlockBytes;
+    }
+
+    void** originalFileData = &original_data[0];
+    void** recoveryBlocks   = &encode_work_data[0];
+    void** decoderWorkArea  = &decode_work_data[0];
+
+    // Recovery data for decoding
+    OperationTimer encode_time;
+    if (! leopard_benchmark_encode(params, encode_work_count, originalFileData, recoveryBlocks, encode_time))
+        return false;
+
+    // One-time setup of the matrix decoder isn't a part of the timed decoding
+    LeopardMatrixDecoder<Field>::LogsFWHT();
+
+    size_t crossover = leopard_hybrid_crossover<Field>(params, decode_work_count, originalFileData, recoveryBlocks, decoderWorkArea);
+    if (crossover == 0)
+        return false;
+    printf("  hybrid crossover: matrix decoding for up to %d lost blocks\n", int(crossover-1));
+
+    // Repeat benchmark multiple times to improve its accuracy
+    OperationTimer decode_one_time, decode_all_time;
+    for (TrialLoop trial(params); trial.Next(); )
+    {
+        if (! leopard_benchmark_hybrid_decode<Field>(params, decode_work_count, originalFileData,
+                &original_data_losing_one[0], 1, recoveryBlocks, decoderWorkArea, crossover, decode_one_time)) {
+            return false;
+        }
+        if (! leopard_benchmark_hybrid_decode<Field>(params, decode_work_count, originalFileData,
+                &original_data_losing_most_possible[0], max_lost, recoveryBlocks, decoderWorkArea, crossover, decode_all_time)) {
+            return false;
+        }
+    }
+
+    decode_one_time.Print("decode one hybrid", params.BlockBytes);
+    decode_all_time.Print("decode all hybrid", params.RecoveryDataBytes());
+
+    return true;
+}
+
+
+// Select the same field as leopard_decode() does
+bool leopard_benchmark_hybrid(ECC_bench_params params, uint8_t* buffer)
+{
+    switch (leopard_field_bits(params)) {
+#ifdef LEO_HAS_FF8
+        case 8:   return leopard_benchmark_hybrid_field<LeopardFF8>(params, buffer);
+#endif
+#ifdef LEO_HAS_FF16
+        case 16:  return leopard_benchmark_hybrid_field<LeopardFF16>(params, buffer);
+#endif
+        default:  return false;
+    }
+}
+
+
+// Select the same field as leopard_decode() does
+bool leopard_benchmark_setup(ECC_bench_params params)
+{
+    switch (leopard_field_bits(params)) {
+#ifdef LEO_HAS_FF8
+        case 8:   return leopard_benchmark_setup_field<LeopardFF8>(params);
+#endif
+#ifdef LEO_HAS_FF16
+        case 16:  return leopard_benchmark_setup_field<LeopardFF16>(params);
+#endif
+        default:  return false;
+    }
+}
+
+
+// Benchmark library and print results, return false if anything failed
+bool leopard_benchmark_main(ECC_bench_params params, uint8_t* buffer)
+{
+    // Total encode/decode times
+    LeopardTimers timers;
+
+    // One-time setup: only the first leo_init() call builds the FFT tables
+    OperationTimer init_time(0);
+    init_time.BeginCall();
+    if (leo_init()) {
+        printf("leo_init failed\n");
+        return false;
+    }
+    init_time.EndCall();
+    leopard_limit_isa(params.Isa);
+
+    size_t encode_work_count = leo_encode_work_count(params.OriginalCount, params.RecoveryCount);
+
+    if (encode_work_count == 0)  // 0 means unsupported data+parity combination
+        return false;
+
+    // Print CPU SIMD extensions used to accelerate library in this run
+    // (depends on compilation options such as -mavx2, actual CPU and --isa option), and the field
+    printf("Leopard (%s, %d-bit, GF(2^%d)):\n",
+#ifndef GF256_TARGET_MOBILE
+#  ifdef GF256_TRY_AVX2
+        leopard::CpuHasAVX2? "avx2":
+#  endif
+        leopard::CpuHasSSSE3? "ssse3":
+#endif
+#if defined(GF256_TRY_NEON)
+        leopard::CpuHasNeon64? "neon64":
+        leopard::CpuHasNeon? "neon":
+#endif
+        "scalar", sizeof(size_t)*8, leopard_field_bits(params));
+    init_time.PrintTime("init");
+
+    if (! leopard_benchmark_trials(params, buffer, timers)) {
+        return false;
+    }
+
     // Benchmark reports for each operation
-    encode_time.Print("encode", params.OriginalFileBytes());
-    decode_one_time.Print("decode one", params.BlockBytes);
-    decode_all_time.Print("decode all", params.RecoveryDataBytes());
+    timers.encode.Print("encode", params.OriginalFileBytes());
+    timers.decode_one.Print("decode one", params.BlockBytes);
+    timers.decode_all.Print("decode all", params.RecoveryDataBytes());
+
+    if (! leopard_benchmark_setup(params)) {
+        return false;
+    }
+
+    if (! leopard_benchmark_hybrid(params, buffer)) {
+        return false;
+    }
+
+    // Repeat the same benchmark on multiple cores simultaneously, each thread processing its own codeword
+    if (params.Threads > 1)
+    {
+        if (! run_scaling_on_threads(params, buffer, timers,
+                [&](uint8_t* thread_buffer, LeopardTimers& thread_timers) {
+                    return leopard_benchmark_trials(params, thread_buffer, thread_timers);
+                },
+                {{"encode", &LeopardTimers::encode, params.OriginalFileBytes()},
+                 {"decode one", &LeopardTimers::decode_one, uint64_t(params.BlockBytes)},
+                 {"decode all", &LeopardTimers::decode_all, params.RecoveryDataBytes()}})) {
+            return false;
+        }
+    }
 
     return true;
 }
+
+ISA_BUILD_END
@@ -3,6 +3,7 @@
 //
 
 #include <cstdio>
+#include <cstring>
 #include <cmath>
 #include <memory>
 
@@ -13,15 +14,43 @@
 #include "WirehairCodec.cpp"
 #include "wirehair.cpp"
 
+ISA_BUILD_BEGIN
 
-// Perform single encoding operation, return false if it fails
-bool wirehair_benchmark_encode(
+
+// Extra workspace used by the benchmark on top of place required for original data: recovery blocks.
+// Codec objects allocate their own memory proportional to the original data size
+size_t wirehair_extra_space(ECC_bench_params params)
+{
+    return params.RecoveryDataBytes();
+}
+
+
+// Encoder solves the matrix into its own intermediate blocks, about one per original block, and generates recovery blocks from them
+size_t wirehair_encode_working_set(ECC_bench_params params)
+{
+    return 2 * params.OriginalFileBytes() + params.RecoveryDataBytes();
+}
+
+// Wirehair uses the same GF(2^8) arithmetic as CM256, with scalar, SSSE3 and AVX2 code paths
+bool wirehair_has_isa(int isa)
+{
+    return cm256_has_isa(isa);
+}
+
+
+// From 2 to 64000 data blocks
+bool wirehair_supports(ECC_bench_params params)
+{
+    return params.OriginalCount >= 2  &&  params.OriginalCount <= 64000;
+}
+
+
+// Create the encoder for the original data, i.e. solve the Wirehair matrix, return false if it fails
+bool wirehair_encoder_setup(
     ECC_bench_params params,
     uint8_t* originalFileData,
-    uint8_t* recoveryBlocks,
     WirehairCodec& encoder)
 {
-    // Create encoder
     encoder = wirehair_encoder_create(
         encoder,                     // [Optional] Pointer to prior codec object
         originalFileData,            // Pointer to message
@@ -32,31 +61,183 @@ bool wirehair_benchmark_encode(
         printf("wirehair_encoder_create failed\n");
         return false;
     }
+    return true;
+}
+
+
+// Generate i-th recovery block with the ready encoder, return false if it fails.
+// wirehair_encode() only reads the encoder state, so distinct blocks may be generated by multiple threads simultaneously
+bool wirehair_encode_block(
+    ECC_bench_params params,
+    uint8_t* recoveryBlocks,
+    WirehairCodec encoder,
+    int i)
+{
+    auto blockId   = i + params.OriginalCount;
+    auto blockSize = params.BlockBytes;
+    auto blockPtr  = recoveryBlocks + i * blockSize;
+
+    // Encode a packet
+    uint32_t writeLen = 0;
+    WirehairResult encodeResult = wirehair_encode(
+        encoder,     // Pointer to codec from wirehair_encoder_create()
+        blockId,     // Identifier of block to generate
+        blockPtr,    // Pointer to output block data
+        blockSize,   // Bytes in the output buffer
+        &writeLen);  // Number of bytes written <= blockBytes
+
+    if (encodeResult != Wirehair_Success  ||  writeLen != blockSize)
+    {
+        printf("wirehair_encode failed: %s\n", wirehair_result_string(encodeResult));
+        return false;
+    }
+    return true;
+}
+
+
+// Generate all recovery blocks with the ready encoder, distributing them over the pool threads if it's provided.
+// Return false if it fails
+bool wirehair_encode_blocks(
+    ECC_bench_params params,
+    uint8_t* recoveryBlocks,
+    WirehairCodec encoder,
+    ThreadPool* pool = nullptr)
+{
+    if (pool) {
+        return pool->Run(params.RecoveryCount, [&](size_t i) {
+            return wirehair_encode_block(params, recoveryBlocks, encoder, int(i));
+        });
+    }
+
+    for (int i = 0; i < params.RecoveryCount; ++i) {
+        if (! wirehair_encode_block(params, recoveryBlocks, encoder, i))
+            return false;
+    }
+    return true;
+}
+
+
+// Perform single encoding operation, return false if it fails
+bool wirehair_benchmark_encode(
+    ECC_bench_params params,
+    uint8_t* originalFileData,
+    uint8_t* recoveryBlocks,
+    WirehairCodec& encoder,
+    ThreadPool* pool = nullptr)
+{
+    return wirehair_encoder_setup(params, originalFileData, encoder)
+       &&  wirehair_encode_blocks(params, recoveryBlocks, encoder, pool);
+}
+
+
+// Stripe encoder reusing the codec object for all stripes, and generating recovery blocks
+// on params.WirehairThreads threads. The decoder receives the available blocks in order until it can recover the data,
+// so it fails if the available blocks aren't enough for the fountain code
+class WirehairStripeCodec : public StripeCodec
+{
+public:
+    explicit WirehairStripeCodec(ECC_bench_params params)
+        : Params(params),
+          Pool(params.WirehairThreads > 1?  new ThreadPool(params.WirehairThreads) : nullptr)
+    {}
+
+    ~WirehairStripeCodec()
+    {
+        wirehair_free(Encoder);
+        wirehair_free(Decoder);
+    }
+
+    bool Encode(uint8_t* original, uint8_t* recovery) override
+    {
+        // Wirehair encoder setup depends on the data, so it's performed for each stripe
+        return wirehair_benchmark_encode(Params, original, recovery, Encoder, Pool.get());
+    }
 
-    // Generate recovery data
-    for (int i = 0; i < params.RecoveryCount; ++i)
+    bool Decode(uint8_t* original, uint8_t* recovery, const std::vector<char>& lost) override
     {
-        auto blockId   = i + params.OriginalCount;
-        auto blockSize = params.BlockBytes;
-        auto blockPtr  = recoveryBlocks + i * blockSize;
-
-        // Encode a packet
-        uint32_t writeLen = 0;
-        WirehairResult encodeResult = wirehair_encode(
-            encoder,     // Pointer to codec from wirehair_encoder_create()
-            blockId,     // Identifier of block to generate
-            blockPtr,    // Pointer to output block data
-            blockSize,   // Bytes in the output buffer
-            &writeLen);  // Number of bytes written <= blockBytes
-
-        if (encodeResult != Wirehair_Success  ||  writeLen != blockSize)
+        Decoder = wirehair_decoder_create(Decoder, Params.OriginalFileBytes(), Params.BlockBytes);
+        if (! Decoder)
+            return false;
+
+        int total = Params.OriginalCount + Params.RecoveryCount;
+        WirehairResult decodeResult = Wirehair_NeedMore;
+        for (int blockId = 0;  blockId < total  &&  decodeResult == Wirehair_NeedMore;  ++blockId)
         {
-            printf("wirehair_encode failed: %s\n", wirehair_result_string(encodeResult));
+            if (lost[blockId])
+                continue;
+            uint8_t* blockPtr = (blockId < Params.OriginalCount?  original + blockId * Params.BlockBytes
+                                                               :  recovery + (blockId - Params.OriginalCount) * Params.BlockBytes);
+            decodeResult = wirehair_decode(Decoder, blockId, blockPtr, Params.BlockBytes);
+        }
+        if (decodeResult != Wirehair_Success)
             return false;
+
+        for (int blockId = 0; blockId < Params.OriginalCount; ++blockId)
+        {
+            if (! lost[blockId])
+                continue;
+            uint32_t writeLen = 0;
+            WirehairResult recoverResult = wirehair_recover_block(Decoder, blockId, original + blockId * Params.BlockBytes, &writeLen);
+            if (recoverResult != Wirehair_Success  ||  writeLen != Params.BlockBytes)
+                return false;
         }
+        return true;
     }
 
-    return true;
+    void BeginReceive(ECC_bench_params params, uint8_t* original, uint8_t* recovery) override
+    {
+        StripeCodec::BeginReceive(params, original, recovery);
+        Decoder = wirehair_decoder_create(Decoder, Params.OriginalFileBytes(), Params.BlockBytes);
+    }
+
+    // Each block is fed to the decoder immediately. Original blocks are also stored in place,
+    // so only the missing ones are recovered once the decoder succeeds
+    ReceiveResult Receive(int id, const uint8_t* block) override
+    {
+        if (! Decoder)
+            return RECEIVE_FAILED;
+        if (id < Params.OriginalCount)
+            StoreReceived(id, block);
+
+        WirehairResult decodeResult = wirehair_decode(Decoder, id, block, Params.BlockBytes);
+        if (decodeResult == Wirehair_NeedMore)
+            return RECEIVE_NEED_MORE;
+        if (decodeResult != Wirehair_Success)
+            return RECEIVE_FAILED;
+
+        for (int blockId = 0; blockId < Params.OriginalCount; ++blockId)
+        {
+            if (! NotReceived[blockId])
+                continue;
+            uint32_t writeLen = 0;
+            WirehairResult recoverResult = wirehair_recover_block(Decoder, blockId, ReceiveOriginal + blockId * Params.BlockBytes, &writeLen);
+            if (recoverResult != Wirehair_Success  ||  writeLen != Params.BlockBytes)
+                return RECEIVE_FAILED;
+        }
+        return RECEIVE_DONE;
+    }
+
+private:
+    ECC_bench_params Params;
+    WirehairCodec Encoder = nullptr, Decoder = nullptr;
+    std::unique_ptr<ThreadPool> Pool;
+};
+
+
+std::unique_ptr<StripeCodec> wirehair_create_stripe_codec(ECC_bench_params params)
+{
+    const WirehairResult initResult = wirehair_init();
+    if (initResult != Wirehair_Success) {
+        printf("wirehair_init failed: %s\n", wirehair_result_string(initResult));
+        return nullptr;
+    }
+    gf256_limit_isa(params.Isa);
+    return std::unique_ptr<StripeCodec>(new WirehairStripeCodec(params));
+}
+
+std::unique_ptr<StripeEncoder> wirehair_create_stripe_encoder(ECC_bench_params params)
+{
+    return wirehair_create_stripe_codec(params);
 }
 
 
@@ -65,8 +246,12 @@ bool wirehair_benchmark_decode_one_block(
     ECC_bench_params params,
     uint8_t* originalFileData,
     uint8_t* recoveryBlocks,
-    WirehairCodec& decoder)
+    WirehairCodec& decoder,
+    OperationTimer& solve_time,
+    OperationTimer& recover_time)
 {
+    solve_time.BeginCall();
+
     // Create decoder
     decoder = wirehair_decoder_create(
         decoder,                     // Codec object to reuse
@@ -111,6 +296,9 @@ bool wirehair_benchmark_decode_one_block(
 
 
 recover:
+    solve_time.EndCall();
+    recover_time.BeginCall();
+
     // Now let's recover the first data block
     auto blockId  = 0;
     auto blockPtr = originalFileData;
@@ -127,6 +315,7 @@ recover:
         printf("wirehair_recover_block failed: %s\n", wirehair_result_string(recoverResult));
         return false;
     }
+    recover_time.EndCall();
 
 /* Altenatively, we can recover the entire original data that works only slightly slower
    (probably because it memcpy's more data):
@@ -146,8 +335,12 @@ bool wirehair_benchmark_decode_all_blocks(
     ECC_bench_params params,
     uint8_t* originalFileData,
     uint8_t* recoveryBlocks,
-    WirehairCodec& decoder)
+    WirehairCodec& decoder,
+    OperationTimer& solve_time,
+    OperationTimer& recover_time)
 {
+    solve_time.BeginCall();
+
     // Create decoder
     decoder = wirehair_decoder_create(
         decoder,                     // Codec object to reuse
@@ -192,6 +385,9 @@ bool wirehair_benchmark_decode_all_blocks(
 
 
 recover:
+    solve_time.EndCall();
+    recover_time.BeginCall();
+
     // Now let's recover the entire buffer
     WirehairResult recoverResult = wirehair_recover(
         decoder,                    // Pointer to codec from wirehair_decoder_create()
@@ -203,24 +399,29 @@ recover:
         printf("wirehair_recover failed: %s\n", wirehair_result_string(recoverResult));
         return false;
     }
+    recover_time.EndCall();
 
     return true;
 }
 
 
-// Benchmark library and print results, return false if anything failed
-bool wirehair_benchmark_main(ECC_bench_params params, uint8_t* buffer)
+// Timers of all operations: encoding is split into the encoder setup (matrix solution) and generation of recovery blocks,
+// decoding is split into the solution from received blocks and recovery of lost blocks.
+// Unlike the encoder setup, the decoder solution processes the block data too, so it isn't a pure setup
+struct WirehairTimers
 {
-    // Initialize the library
-    const WirehairResult initResult = wirehair_init();
-    if (initResult != Wirehair_Success) {
-        printf("wirehair_init failed: %s\n", wirehair_result_string(initResult));
-        return false;
-    }
+    OperationTimer encode, encode_setup, encode_blocks;
+    OperationTimer decode_one, decode_one_solve, decode_one_recover;
+    OperationTimer decode_all, decode_all_solve, decode_all_recover;
+};
 
-    // Introduce himself
-    printf("Wirehair (%d-bit):\n", sizeof(size_t)*8);
 
+// Run all benchmark trials on a single codeword, return false if anything failed
+bool wirehair_benchmark_trials(
+    ECC_bench_params params,
+    uint8_t* buffer,
+    WirehairTimers& timers)
+{
     // Automatically free codecs memory
     struct FreeCodecs{
         WirehairCodec encoder = nullptr, decoder_one = nullptr, decoder_all = nullptr;
@@ -236,33 +437,156 @@ bool wirehair_benchmark_main(ECC_bench_params params, uint8_t* buffer)
     auto originalFileData = buffer;
     auto recoveryBlocks   = buffer + params.OriginalFileBytes();
 
-    // Total encode/decode times
-    OperationTimer encode_time, decode_one_time, decode_all_time;
-
     // Repeat benchmark multiple times to improve its accuracy
-    for (int trial = 0; trial < params.Trials; ++trial)
+    for (TrialLoop trial(params); trial.Next(); )
+    {
+        timers.encode.BeginCall();
+        timers.encode_setup.BeginCall();
+        if (! wirehair_encoder_setup(params, originalFileData, codecs.encoder)) {
+            return false;
+        }
+        timers.encode_setup.EndCall();
+        timers.encode_blocks.BeginCall();
+        if (! wirehair_encode_blocks(params, recoveryBlocks, codecs.encoder)) {
+            return false;
+        }
+        timers.encode_blocks.EndCall();
+        timers.encode.EndCall();
+        timers.decode_one.BeginCall();
+        if (! wirehair_benchmark_decode_one_block(params, originalFileData, recoveryBlocks, codecs.decoder_one,
+                                                  timers.decode_one_solve, timers.decode_one_recover)) {
+            return false;
+        }
+        timers.decode_one.EndCall();
+        timers.decode_all.BeginCall();
+        if (! wirehair_benchmark_decode_all_blocks(params, originalFileData, recoveryBlocks, codecs.decoder_all,
+                                                   timers.decode_all_solve, timers.decode_all_recover)) {
+            return false;
+        }
+        timers.decode_all.EndCall();
+    }
+
+    return true;
+}
+
+
+// Benchmark generation of recovery blocks on params.WirehairThreads threads sharing the same encoder,
+// and check that they are the same as generated by a single thread. Return false if anything failed
+bool wirehair_benchmark_parallel_encode(ECC_bench_params params, uint8_t* buffer)
+{
+    // Automatically free codec memory
+    struct FreeCodec{
+        WirehairCodec encoder = nullptr;
+        ~FreeCodec()  { wirehair_free(encoder); }
+    } codec;
+
+    auto originalFileData = buffer;
+    auto recoveryBlocks   = buffer + params.OriginalFileBytes();
+    std::vector<uint8_t> expected(params.RecoveryDataBytes());
+
+    ThreadPool pool(params.WirehairThreads);
+    OperationTimer encode_time, encode_blocks_time;
+
+    for (TrialLoop trial(params); trial.Next(); )
     {
+        if (trial.Trial == 1) {
+            if (! wirehair_benchmark_encode(params, originalFileData, recoveryBlocks, codec.encoder)) {
+                return false;
+            }
+            memcpy(expected.data(), recoveryBlocks, expected.size());
+            memset(recoveryBlocks, 0, expected.size());
+        }
+
         encode_time.BeginCall();
-        if (! wirehair_benchmark_encode(params, originalFileData, recoveryBlocks, codecs.encoder)) {
+        if (! wirehair_encoder_setup(params, originalFileData, codec.encoder)) {
             return false;
         }
-        encode_time.EndCall();
-        decode_one_time.BeginCall();
-        if (! wirehair_benchmark_decode_one_block(params, originalFileData, recoveryBlocks, codecs.decoder_one)) {
+        encode_blocks_time.BeginCall();
+        if (! wirehair_encode_blocks(params, recoveryBlocks, codec.encoder, &pool)) {
             return false;
         }
-        decode_one_time.EndCall();
-        decode_all_time.BeginCall();
-        if (! wirehair_benchmark_decode_all_blocks(params, originalFileData, recoveryBlocks, codecs.decoder_all)) {
+        encode_blocks_time.EndCall();
+        encode_time.EndCall();
+
+        if (trial.Trial == 1  &&  memcmp(expected.data(), recoveryBlocks, expected.size())) {
+            printf("  Wirehair parallel encoder failed: recovery blocks don't match the single-threaded encoder\n");
             return false;
         }
-        decode_all_time.EndCall();
+    }
+
+    char operation[64];
+    snprintf(operation, sizeof(operation), "encode x%d", pool.Threads());
+    encode_time.Print(operation, params.OriginalFileBytes());
+    snprintf(operation, sizeof(operation), "encode blocks x%d", pool.Threads());
+    encode_blocks_time.Print(operation, params.OriginalFileBytes());
+    return true;
+}
+
+
+// Benchmark library and print results, return false if anything failed
+bool wirehair_benchmark_main(ECC_bench_params params, uint8_t* buffer)
+{
+    // Initialize the library, timing it as the one-time setup
+    OperationTimer init_time(0);
+    init_time.BeginCall();
+    const WirehairResult initResult = wirehair_init();
+    if (initResult != Wirehair_Success) {
+        printf("wirehair_init failed: %s\n", wirehair_result_string(initResult));
+        return false;
+    }
+    init_time.EndCall();
+    gf256_limit_isa(params.Isa);
+
+    // Introduce himself, with CPU SIMD extensions used by GF(2^8) arithmetic in this run
+    printf("Wirehair (%s, %d-bit):\n",
+#ifndef GF256_TARGET_MOBILE
+#  ifdef GF256_TRY_AVX2
+        CpuHasAVX2? "avx2":
+#  endif
+        CpuHasSSSE3? "ssse3":
+#endif
+        "scalar", sizeof(size_t)*8);
+    init_time.PrintTime("init");
+
+    WirehairTimers timers;
+    if (! wirehair_benchmark_trials(params, buffer, timers)) {
+        return false;
     }
 
     // Benchmark reports for each operation
-    encode_time.Print("encode", params.OriginalFileBytes());
-    decode_one_time.Print("decode one", params.BlockBytes);
-    decode_all_time.Print("decode all", params.RecoveryDataBytes());
+    timers.encode.Print("encode", params.OriginalFileBytes());
+    timers.encode_setup.PrintTime("encode setup");
+    timers.encode_blocks.Print("encode blocks", params.OriginalFileBytes());
+    timers.decode_one.Print("decode one", params.BlockBytes);
+    timers.decode_one_solve.PrintTime("decode one solve");
+    timers.decode_one_recover.Print("decode one recover", params.BlockBytes);
+    timers.decode_all.Print("decode all", params.RecoveryDataBytes());
+    timers.decode_all_solve.PrintTime("decode all solve");
+    timers.decode_all_recover.Print("decode all recover", params.RecoveryDataBytes());
+
+    // Generate recovery blocks of the same codeword on multiple threads
+    if (params.WirehairThreads > 1)
+    {
+        if (! wirehair_benchmark_parallel_encode(params, buffer)) {
+            return false;
+        }
+    }
+
+    // Repeat the same benchmark on multiple cores simultaneously, each thread processing its own codeword
+    if (params.Threads > 1)
+    {
+        if (! run_scaling_on_threads(params, buffer, timers,
+                [&](uint8_t* thread_buffer, WirehairTimers& thread_timers) {
+                    return wirehair_benchmark_trials(params, thread_buffer, thread_timers);
+                },
+                {{"encode", &WirehairTimers::encode, params.OriginalFileBytes()},
+                 {"decode one", &WirehairTimers::decode_one, uint64_t(params.BlockBytes)},
+                 {"decode all", &WirehairTimers::decode_all, params.RecoveryDataBytes()}})) {
+            return false;
+        }
+    }
 
     return true;
 }
+
+ISA_BUILD_END
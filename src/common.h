@@ -1,67 +1,425 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "isa_build.h"
 #include "cm256.h"
 #include "../unit_test/SiameseTools.h"
 
 
+// Instruction sets used by library kernels, in increasing order
+enum ISA { ISA_SCALAR, ISA_SSSE3, ISA_AVX2, ISA_AVX512, ISA_COUNT };
+
+// Names of instruction sets, as accepted by --isa option
+extern const char* isa_names[ISA_COUNT];
+
+// The most advanced instruction set supported by CPU and OS (ISA_SCALAR on non-x86 CPUs), and GFNI support
+int cpu_isa();
+bool cpu_has_gfni();
+
+
 struct ECC_bench_params : cm256_encoder_params
 {
     // Repeat benchmark multiple times to improve its accuracy
     int Trials;
 
     // Size of the original file
-    size_t OriginalFileBytes() { return OriginalCount * BlockBytes;}
+    size_t OriginalFileBytes() { return size_t(OriginalCount) * BlockBytes;}
 
     // Size of the original file
-    size_t RecoveryDataBytes() { return RecoveryCount * BlockBytes;}
+    size_t RecoveryDataBytes() { return size_t(RecoveryCount) * BlockBytes;}
+
+    // Number of threads running the benchmark simultaneously, each one on its own codeword
+    int Threads;
+
+    // Size of the workspace used by a single thread (buffer contains Threads such workspaces)
+    size_t WorkspaceBytes;
+
+    // If non-zero, each trial loop (TrialLoop) runs trials until this time is spent, but no more than Trials of them
+    uint64_t TimeBudgetUsec;
+
+    // The most advanced instruction set that library kernels may use
+    int Isa;
+
+    // FastECC word size: 32 for GF(0xFFF00001), 64 for GF(0xFFFFFFFF00000001)
+    int FastECCBits;
+
+    // FastECC NTT layout: 0 for depth-first recursion over whole blocks,
+    // otherwise the cache size for the tiled NTT processing groups of blocks in column tiles
+    size_t FastECCTileBytes;
+
+    // Number of threads generating Wirehair recovery blocks of a single codeword
+    int WirehairThreads;
+
+    // Leopard field: 8 for GF(2^8), 16 for GF(2^16), 0 to let the library choose the smallest field fitting the codeword
+    int LeopardBits;
+};
+
+
+// Encoder of a long stream, processing it stripe by stripe (OriginalCount blocks each)
+// and keeping precomputed tables and workspace between stripes
+class StripeEncoder
+{
+public:
+    virtual ~StripeEncoder() {}
+
+    // Encode a single stripe of OriginalCount consecutive blocks into RecoveryCount consecutive blocks
+    // at `recovery`, which may point directly into memory-mapped file. Return false on failure
+    virtual bool Encode(uint8_t* original, uint8_t* recovery) = 0;
+};
+
+// Stripe encoder that can also recover lost blocks of the stripe it encoded last
+class StripeCodec : public StripeEncoder
+{
+public:
+    // Recover lost original blocks of the stripe from OriginalCount blocks at `original` and RecoveryCount blocks at `recovery`.
+    // lost[i] is non-zero for each lost block: original block i for i < OriginalCount, otherwise recovery block i-OriginalCount.
+    // Lost blocks hold garbage on input, lost original blocks hold the recovered data on return,
+    // and the remaining recovery blocks may be overwritten. Return false if the blocks can't be recovered
+    virtual bool Decode(uint8_t* original, uint8_t* recovery, const std::vector<char>& lost) = 0;
+
+    // Streaming receiver: blocks of the stripe encoded last arrive one at a time, in any order, and some never arrive.
+    // BeginReceive() starts receiving the stripe into buffers at `original` and `recovery`, and Receive() accepts
+    // a single block numbered as in Decode(), returning RECEIVE_DONE once all original blocks are available.
+    // By default, blocks are buffered until OriginalCount of them have arrived, and then Decode() is called.
+    // Fountain codes override it to decode incrementally
+    enum ReceiveResult { RECEIVE_NEED_MORE, RECEIVE_DONE, RECEIVE_FAILED };
+    virtual void BeginReceive(ECC_bench_params params, uint8_t* original, uint8_t* recovery);
+    virtual ReceiveResult Receive(int id, const uint8_t* block);
+
+protected:
+    ECC_bench_params ReceiveParams;
+    uint8_t* ReceiveOriginal = nullptr;
+    uint8_t* ReceiveRecovery = nullptr;
+    std::vector<char> NotReceived;   // the `lost` argument of Decode()
+    int ReceivedCount = 0;
+
+    // Copy the block into its place in the receive buffers
+    void StoreReceived(int id, const uint8_t* block);
 };
 
+// Functions of each library: a build of the libraries sees its own ones, and the rest of the program sees all builds
+ISA_BUILD_BEGIN
+#include "libraries.h"
+ISA_BUILD_END
+#ifndef ISA_BUILD
+namespace isa_avx2 {
+#include "libraries.h"
+}
+namespace isa_avx512 {
+#include "libraries.h"
+}
+#endif
+
+// Encode the file stripe by stripe and print sustained speed and peak memory usage, return false if anything failed
+bool stream_benchmark_main(ECC_bench_params params, const char* filename, const char* name, StripeEncoder* encoder);
+
+// Encode the input file mapped into memory, writing recovery blocks directly into the mapped output file.
+// Print sustained speed including page faults and writeback, return false if anything failed
+bool mmap_benchmark_main(ECC_bench_params params, const char* input_filename, const char* output_filename,
+                         const char* name, StripeEncoder* encoder);
 
-// Benchmark each library and print results, return false if anything failed
-bool cm256_benchmark_main(ECC_bench_params params, uint8_t* buffer);
-bool leopard_benchmark_main(ECC_bench_params params, uint8_t* buffer);
-bool fastecc_benchmark_main(ECC_bench_params params, uint8_t* buffer);
-bool wirehair_benchmark_main(ECC_bench_params params, uint8_t* buffer);
+// Decode the codeword with random erasure patterns drawn from the seeded RNG: uniformly placed, bursts,
+// and the worst case for the codecs. Each recovered codeword is compared with the original data outside of the timed region.
+// Print decoding speed for each pattern type, return false if anything failed
+bool erasures_benchmark_main(ECC_bench_params params, uint8_t* buffer, unsigned seed, const char* name, StripeCodec* codec);
 
-// Extra workspace used by each library on top of place required for original data
-size_t leopard_extra_space(ECC_bench_params params);
-size_t fastecc_extra_space(ECC_bench_params params);
+// Receive the codeword block by block in random order, losing each block with probability `loss`.
+// Print latency of each received block and time to recover the data after the last required block,
+// return false if anything failed
+bool receiver_benchmark_main(ECC_bench_params params, uint8_t* buffer, double loss, const char* name, StripeCodec* codec);
 
-// Write benchmark results to logfile
-void write_to_logfile(const char* operation, int invocations, double microseconds_per_call, double megabytes_per_second);
+// Encode batches of B interleaved codewords by a single call, for each B in batches.
+// Print encoding speed for each batch size, return false if anything failed
+bool batch_benchmark_main(ECC_bench_params params, const std::vector<int>& batches, const char* name,
+                          std::unique_ptr<StripeEncoder> (*create_stripe_encoder)(ECC_bench_params));
+
+// Read stripes of the input file with io_uring, encode them on params.Threads worker threads and write block i
+// of each stripe into the file output_prefix.i, keeping up to `depth` stripes in flight (0 = automatic).
+// Print end-to-end speed vs compute-only speed, return false if anything failed
+bool pipeline_benchmark_main(ECC_bench_params params, const char* input_filename, const char* output_prefix,
+                             bool direct, int depth, const char* name,
+                             std::unique_ptr<StripeEncoder> (*create_stripe_encoder)(ECC_bench_params));
+
+// Find the block size with the best encoding speed for the library, checking sizes around the points
+// where its working set fits into L2 and L3 caches. Print results, return false if nothing was measured
+bool autotune_main(ECC_bench_params& params, const char* name,
+                   size_t (*encode_working_set)(ECC_bench_params),
+                   std::unique_ptr<StripeEncoder> (*create_stripe_encoder)(ECC_bench_params));
+
+// Statistics of the operation time over all measured calls. Min and percentiles are computed over all calls,
+// while mean and stddev exclude outliers, i.e. calls slower than Q3 + 3*IQR (e.g. preempted by another process)
+struct TimingStats
+{
+    double MinUsec;
+    double MedianUsec;
+    double P90Usec;
+    double P99Usec;
+    double MeanUsec;
+    double StddevUsec;
+    double MegabytesPerSecondAtMedian;
+    int Outliers;
+};
+
+// Write benchmark results to logfile, with optional statistics
+void write_to_logfile(const char* operation, int invocations, double microseconds_per_call, double megabytes_per_second,
+                      const TimingStats* stats = nullptr);
+
+// Run benchmark(thread, thread_buffer) on params.Threads threads simultaneously, each thread pinned
+// to its own CPU core and working in its own workspace. Return false if benchmark failed in any thread
+bool run_on_threads(ECC_bench_params params, uint8_t* buffer, std::function<bool(int,uint8_t*)> benchmark);
+
+// Pin the current thread to the given CPU core
+void pin_thread_to_core(int core);
+
+
+// Worker threads splitting a single operation into independent jobs, e.g. generation of recovery blocks.
+// Threads are started once and wait for the work between calls, so Run() doesn't pay for the thread creation
+class ThreadPool
+{
+public:
+    // Start threads-1 workers, pinned to cores 1..threads-1. The thread calling Run() is the remaining worker
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+
+    // Run job(i) for i in [0, count) on all threads, return false if any job failed.
+    // Jobs are handed out one by one, so threads that are done with their jobs take more of them
+    bool Run(size_t count, std::function<bool(size_t)> job);
+
+    int Threads() const  { return int(Workers.size()) + 1; }
+
+private:
+    void WorkerLoop(int core);
+    void Work();
+
+    std::vector<std::thread> Workers;
+    std::mutex Mutex;
+    std::condition_variable Started, Finished;
+    uint64_t Generation = 0;         // incremented by each Run() to wake up the workers
+    int Busy = 0;                    // workers still running the current Run()
+    bool Stopping = false;
+
+    std::function<bool(size_t)> Job;
+    size_t Count = 0;
+    std::atomic<size_t> Next{0};
+    std::atomic<bool> Failed{false};
+};
+
+
+// Hardware performance counters of the current thread, enabled by --perf option.
+// Counters are opened on the first Start() in the thread that uses them (see perf_counters.cpp)
+class PerfCounters
+{
+public:
+    enum { CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, BRANCH_MISSES, COUNT };
+
+    static bool Enabled;
+
+    PerfCounters()  {}
+    PerfCounters(const PerfCounters&)  {}   // the copy opens its own counters
+    PerfCounters& operator=(const PerfCounters&)  { return *this; }
+    ~PerfCounters();
+
+    // Remember counter values at the start of the operation
+    void Start();
+    // Add counter increments since Start() to Totals, unless it's a warmup call
+    void Stop(bool measured);
+    void Reset();
+    // Print cycles/byte, IPC and misses per KB of data processed by all measured calls,
+    // or cycles and misses per call if the operation doesn't process data by itself
+    void Print(uint64_t bytes_processed, uint64_t calls);
+
+    uint64_t Totals[COUNT] = {};
+
+private:
+    bool Read(uint64_t* values);
+    void Open();
+
+    bool Opened = false;
+    int Leader = -1;          // group leader file descriptor, -1 if counters are unavailable
+    int Fds[COUNT] = {-1, -1, -1, -1, -1};
+    int Slots[COUNT] = {-1, -1, -1, -1, -1};   // index of each counter in the group read, -1 if unavailable
+    uint64_t Begin[COUNT] = {};
+};
 
 
 //-----------------------------------------------------------------------------
 class OperationTimer
 {
 public:
+    // Number of initial calls of each timer that aren't measured, while CPU caches are cold and CPU frequency isn't settled yet
+    static int WarmupCalls;
+    // Number of measured calls expected for each timer, used to preallocate place for samples
+    static int ExpectedCalls;
+
+    explicit OperationTimer(int warmup_calls = WarmupCalls)  : Warmup(warmup_calls), WarmupLeft(warmup_calls)
+    {
+        Samples.reserve(ExpectedCalls);
+    }
     void BeginCall()
     {
+        Perf.Start();
         t0 = siamese::GetTimeUsec();
     }
     void EndCall()
     {
         const uint64_t t1 = siamese::GetTimeUsec();
         const uint64_t delta = t1 - t0;
+        t0 = 0;
+        Perf.Stop(WarmupLeft == 0);
+        if (WarmupLeft > 0) {
+            --WarmupLeft;
+            return;
+        }
         if (++Invocations == 1)
             MaxCallUsec = MinCallUsec = delta;
-        else if (MaxCallUsec < delta)
+        if (MaxCallUsec < delta)
             MaxCallUsec = delta;
-        else if (MinCallUsec > delta)
+        if (MinCallUsec > delta)
             MinCallUsec = delta;
         TotalUsec += delta;
-        t0 = 0;
+        Samples.push_back(delta);
     }
     void Reset()
     {
         t0 = 0;
         Invocations = 0;
         TotalUsec = 0;
+        WarmupLeft = Warmup;
+        Samples.clear();
+        Perf.Reset();
+    }
+    // Add measured calls of another timer, e.g. of the same operation performed by another thread
+    void Merge(const OperationTimer& other)
+    {
+        if (other.Invocations == 0)
+            return;
+        MaxCallUsec = (Invocations? std::max(MaxCallUsec, other.MaxCallUsec) : other.MaxCallUsec);
+        MinCallUsec = (Invocations? std::min(MinCallUsec, other.MinCallUsec) : other.MinCallUsec);
+        Invocations += other.Invocations;
+        TotalUsec += other.TotalUsec;
+        Samples.insert(Samples.end(), other.Samples.begin(), other.Samples.end());
+        for (int i = 0; i < PerfCounters::COUNT; ++i)
+            Perf.Totals[i] += other.Perf.Totals[i];
+    }
+
+    // Statistics of measured calls
+    TimingStats Stats()
+    {
+        TimingStats stats = {};
+        if (Samples.empty())
+            return stats;
+
+        std::vector<uint64_t> sorted(Samples);
+        std::sort(sorted.begin(), sorted.end());
+        // Nearest-rank percentile
+        auto percentile = [&](double p) {
+            size_t rank = size_t(std::ceil(p * sorted.size()));
+            return double(sorted[rank? rank-1 : 0]);
+        };
+
+        // Tukey's far-out fence, with IQR no less than the timer resolution, so identical samples don't make the rest outliers
+        double q1 = percentile(0.25), q3 = percentile(0.75);
+        double fence = q3 + 3 * std::max(q3 - q1, 1.0);
+        double sum = 0, sum_squares = 0;
+        size_t count = 0;
+        for (uint64_t sample : Samples)
+            if (sample <= fence)
+                sum += sample, ++count;
+        double mean = sum / count;
+        for (uint64_t sample : Samples)
+            if (sample <= fence)
+                sum_squares += (sample - mean) * (sample - mean);
+
+        stats.MinUsec    = double(sorted.front());
+        stats.MedianUsec = percentile(0.5);
+        stats.P90Usec    = percentile(0.9);
+        stats.P99Usec    = percentile(0.99);
+        stats.MeanUsec   = mean;
+        stats.StddevUsec = std::sqrt(sum_squares / count);
+        stats.Outliers   = int(Samples.size() - count);
+        return stats;
     }
+
+    // Print median time and speed at the median time, followed by other statistics.
+    // Median and percentiles aren't affected by a few outliers, unlike the mean
     void Print(const char* operation, uint64_t bytes_processed_per_call)
     {
-        double microseconds_per_call = double(TotalUsec) / Invocations;
+        if (Invocations == 0) {
+            printf("  %s: no measured calls\n", operation);
+            return;
+        }
+        TimingStats stats = Stats();
+        double microseconds_per_call = stats.MeanUsec;
         double megabytes_per_second = bytes_processed_per_call / microseconds_per_call;
-        printf("  %s: %.0lf usec, %.0lf MB/s\n", operation, microseconds_per_call, megabytes_per_second);
-        write_to_logfile(operation, Invocations, microseconds_per_call, megabytes_per_second);
+        stats.MegabytesPerSecondAtMedian = bytes_processed_per_call / stats.MedianUsec;
+        printf("  %s: %.0lf usec, %.0lf MB/s (min %.0lf, p90 %.0lf, p99 %.0lf, mean %.0lf, stddev %.0lf usec%s)\n",
+            operation, stats.MedianUsec, stats.MegabytesPerSecondAtMedian,
+            stats.MinUsec, stats.P90Usec, stats.P99Usec, microseconds_per_call, stats.StddevUsec, OutliersNote(stats).c_str());
+        write_to_logfile(operation, Invocations, microseconds_per_call, megabytes_per_second, &stats);
+        Perf.Print(bytes_processed_per_call * Invocations, Invocations);
+    }
+
+    // Print time of the operation that doesn't process data by itself, such as setup of the decoder
+    void PrintTime(const char* operation)
+    {
+        if (Invocations == 0) {
+            printf("  %s: no measured calls\n", operation);
+            return;
+        }
+        TimingStats stats = Stats();
+        double microseconds_per_call = stats.MeanUsec;
+        printf("  %s: %.0lf usec (min %.0lf, p90 %.0lf, p99 %.0lf, mean %.0lf, stddev %.0lf usec%s)\n",
+            operation, stats.MedianUsec,
+            stats.MinUsec, stats.P90Usec, stats.P99Usec, microseconds_per_call, stats.StddevUsec, OutliersNote(stats).c_str());
+        write_to_logfile(operation, Invocations, microseconds_per_call, 0, &stats);
+        Perf.Print(0, Invocations);
+    }
+
+    // ", N outliers" if any calls were excluded from mean and stddev
+    static std::string OutliersNote(const TimingStats& stats)
+    {
+        return stats.Outliers? ", " + std::to_string(stats.Outliers) + " outliers" : "";
+    }
+
+    // Print aggregate speed of the operation performed by all threads simultaneously
+    // and its scaling efficiency relative to the single-threaded run, both computed from median times like in Print().
+    // Threads without measured calls (e.g. when all trials were warmup) are skipped
+    static void PrintScaling(const char* operation, OperationTimer& single_thread,
+                             std::vector<OperationTimer>& threads, uint64_t bytes_processed_per_call)
+    {
+        double megabytes_per_second = 0, microseconds_per_call = 0;
+        int invocations = 0, measured_threads = 0;
+        for (auto& timer : threads) {
+            if (timer.Invocations == 0)
+                continue;
+            double median_usec = std::max(timer.Stats().MedianUsec, 1.0);   // not less than the timer resolution
+            megabytes_per_second += bytes_processed_per_call / median_usec;
+            microseconds_per_call += median_usec;
+            invocations += int(timer.Invocations);
+            ++measured_threads;
+        }
+        if (single_thread.Invocations == 0  ||  measured_threads == 0) {
+            printf("  %s x%d: no measured calls\n", operation, int(threads.size()));
+            return;
+        }
+        microseconds_per_call /= measured_threads;
+        double single_thread_speed = bytes_processed_per_call / std::max(single_thread.Stats().MedianUsec, 1.0);
+        double efficiency = megabytes_per_second / (single_thread_speed * measured_threads);
+        printf("  %s x%d: %.0lf usec, %.0lf MB/s, %.0lf%% scaling efficiency\n",
+            operation, int(threads.size()), microseconds_per_call, megabytes_per_second, efficiency*100);
+
+        char threaded_operation[100];
+        snprintf(threaded_operation, sizeof(threaded_operation), "%s x%d", operation, int(threads.size()));
+        write_to_logfile(threaded_operation, invocations, microseconds_per_call, megabytes_per_second);
     }
 
     uint64_t t0 = 0;
@@ -69,8 +427,48 @@ public:
     uint64_t TotalUsec = 0;
     uint64_t MaxCallUsec = 0;
     uint64_t MinCallUsec = 0;
+    int Warmup;
+    int WarmupLeft;
+    std::vector<uint64_t> Samples;   // time of each measured call
+    PerfCounters Perf;
+    // Set by benchmarks that check results of the operation only once, since it's slow.
+    // Unlike Invocations == 1, it doesn't depend on the number of warmup calls
+    bool Checked = false;
 };
 
+// Operation reported by run_scaling_on_threads(): its name, its timer in the Timers struct and bytes processed per call
+template <typename Timers>
+struct ScalingReport
+{
+    const char* Operation;
+    OperationTimer Timers::* Timer;
+    uint64_t BytesPerCall;
+};
+
+// Run benchmark(thread_buffer, thread_timers) on params.Threads threads by run_on_threads(), each thread filling its own
+// Timers struct, and print PrintScaling() of each reported operation relative to single_thread. Return false if benchmark failed
+template <typename Timers, typename Benchmark>
+bool run_scaling_on_threads(ECC_bench_params params, uint8_t* buffer, Timers& single_thread, Benchmark benchmark,
+                            std::initializer_list<ScalingReport<Timers>> reports)
+{
+    std::vector<Timers> thread_timers(params.Threads);
+
+    if (! run_on_threads(params, buffer, [&](int thread, uint8_t* thread_buffer) {
+            return benchmark(thread_buffer, thread_timers[thread]);
+        })) {
+        return false;
+    }
+
+    for (auto& report : reports)
+    {
+        std::vector<OperationTimer> times;
+        for (auto& t : thread_timers)
+            times.push_back(t.*report.Timer);
+        OperationTimer::PrintScaling(report.Operation, single_thread.*report.Timer, times, report.BytesPerCall);
+    }
+    return true;
+}
+
 
 // Round x up to 2^i
 inline uint64_t NextPow2(uint64_t x)
@@ -82,3 +480,87 @@ inline uint64_t NextPow2(uint64_t x)
 		;
 	return uint64_t(1) << i;
 }
+
+
+// Loop over benchmark trials: for (TrialLoop trial(params); trial.Next(); ) {...}
+// Runs params.Trials trials, or stops earlier when params.TimeBudgetUsec is spent (but runs at least one trial)
+class TrialLoop
+{
+public:
+    explicit TrialLoop(const ECC_bench_params& params)
+        : Trials(params.Trials), TimeBudgetUsec(params.TimeBudgetUsec), StartUsec(siamese::GetTimeUsec())  {}
+
+    bool Next()
+    {
+        if (Trial >= Trials)
+            return false;
+        if (TimeBudgetUsec  &&  Trial > 0  &&  siamese::GetTimeUsec() - StartUsec >= TimeBudgetUsec)
+            return false;
+        ++Trial;
+        return true;
+    }
+
+    int Trial = 0;   // number of trials started so far
+
+private:
+    int Trials;
+    uint64_t TimeBudgetUsec;
+    uint64_t StartUsec;
+};
+
+
+// Memory buffer aligned for compatibility with all benchmarked libraries
+class AlignedBuffer
+{
+public:
+    explicit AlignedBuffer(size_t bytes)  : Storage(bytes + ALIGNMENT)  {}
+    uint8_t* data()  { return (uint8_t*) ((uintptr_t(&Storage[0]) + ALIGNMENT - 1) & ~uintptr_t(ALIGNMENT - 1)); }
+
+private:
+    static const size_t ALIGNMENT = 64;   // at least 16 for SSE intrinsics, and at least 64 for Leopard
+    std::vector<uint8_t> Storage;
+};
+
+
+// Pages of the shared workspace, selected by --pages option: whatever the system gives by default, 4 KB pages only,
+// transparent huge pages, and preallocated 2 MB or 1 GB huge pages (hugetlbfs)
+enum Pages { PAGES_DEFAULT, PAGES_4K, PAGES_THP, PAGES_2M, PAGES_1G, PAGES_COUNT };
+extern const char* page_names[PAGES_COUNT];
+
+// Placement of the workspace of each thread, selected by --numa option: pages are touched first by the main thread,
+// by a thread running on the core of the benchmark thread, or additionally bound by mbind to the NUMA node of that core
+enum Placement { PLACEMENT_DEFAULT, PLACEMENT_FIRST_TOUCH, PLACEMENT_BIND, PLACEMENT_COUNT };
+extern const char* placement_names[PLACEMENT_COUNT];
+
+// Workspaces of all benchmark threads, allocated as a single memory area
+class Workspace
+{
+public:
+    Workspace()  {}
+    ~Workspace();
+
+    // Allocate `threads` workspaces of `bytes` each and call init(thread, workspace) for each one,
+    // on the core of that thread unless placement is PLACEMENT_DEFAULT, so bytes should be a multiple of PageBytes(pages)
+    // in this case. Print the reason and return false if memory with such pages isn't available
+    bool Allocate(size_t bytes, int threads, int pages, int placement, std::function<void(int,uint8_t*)> init);
+
+    uint8_t* data()  { return Data; }
+    size_t size()  { return Bytes; }
+
+    // Bytes of the workspace actually backed by huge pages
+    size_t HugePageBytes();
+
+    // NUMA node of the core of each thread, -1 if unknown
+    std::vector<int> Nodes;
+
+    static size_t PageBytes(int pages);
+
+private:
+    Workspace(const Workspace&) = delete;
+    Workspace& operator=(const Workspace&) = delete;
+
+    uint8_t* Mapping = nullptr;
+    size_t MappingBytes = 0;
+    uint8_t* Data = nullptr;
+    size_t Bytes = 0;
+};
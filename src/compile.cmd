@@ -1,2 +1,4 @@
-g++ -o bench_avx2 -mavx2 -DSIMD=AVX2 -mtune=skylake -O3 -s main.cpp benchmark_cm256.cpp ../external/cm256/src/cm256.cpp benchmark_leopard.cpp benchmark_fastecc.cpp benchmark_wirehair.cpp -I../external/cm256/include -I../external/leopard -I../external/FastECC -I../external/wirehair -I../external/wirehair/include
-g++ -o bench_sse4 -msse4 -DSIMD=SSE2 -mtune=skylake -O3 -s main.cpp benchmark_cm256.cpp ../external/cm256/src/cm256.cpp benchmark_leopard.cpp benchmark_fastecc.cpp benchmark_wirehair.cpp -I../external/cm256/include -I../external/leopard -I../external/FastECC -I../external/wirehair -I../external/wirehair/include
+g++ -r -o isa_ssse3.o -mssse3 -mtune=skylake -O3 benchmark_cm256.cpp benchmark_gf256tables.cpp benchmark_gf65536.cpp benchmark_leopard.cpp benchmark_fastecc.cpp benchmark_wirehair.cpp -I../external/cm256/include -I../external/leopard -I../external/FastECC -I../external/wirehair -I../external/wirehair/include
+g++ -r -o isa_avx2.o -mavx2 -DISA_BUILD=avx2 -mtune=skylake -O3 benchmark_cm256.cpp benchmark_gf256tables.cpp benchmark_gf65536.cpp benchmark_leopard.cpp benchmark_fastecc.cpp benchmark_wirehair.cpp -I../external/cm256/include -I../external/leopard -I../external/FastECC -I../external/wirehair -I../external/wirehair/include
+g++ -r -o isa_avx512.o -mavx512f -mavx512bw -DISA_BUILD=avx512 -mtune=skylake -O3 benchmark_cm256.cpp benchmark_gf256tables.cpp benchmark_gf65536.cpp benchmark_leopard.cpp benchmark_fastecc.cpp benchmark_wirehair.cpp -I../external/cm256/include -I../external/leopard -I../external/FastECC -I../external/wirehair -I../external/wirehair/include
+g++ -o bench -mtune=skylake -O3 -s main.cpp stream.cpp erasures.cpp receiver.cpp batch.cpp pipeline.cpp workspace.cpp perf_counters.cpp autotune.cpp isa_ssse3.o isa_avx2.o isa_avx512.o -I../external/cm256/include -I../external/leopard -I../external/FastECC -I../external/wirehair -I../external/wirehair/include
@@ -0,0 +1,149 @@
+//
+// Decoding benchmark with random erasure patterns: each trial loses a different set of blocks,
+// and recovered data are compared against the original data after each decoding
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include "common.h"
+
+
+// Kinds of erasure patterns, each one losing params.RecoveryCount blocks of the stripe
+enum ErasurePattern
+{
+    ERASURE_UNIFORM,   // any blocks
+    ERASURE_BURST,     // consecutive blocks, e.g. a failed disk shelf or a lost run of packets
+    ERASURE_WORST,     // as much original blocks as possible, so decoder has to recover the most data
+    ERASURE_PATTERNS
+};
+// ERASURE_WORST is the same generic pattern for all libraries. It's the worst case for the matrix codecs, whose decoding time
+// grows with the number of lost original blocks, but not necessarily for the others: FFT-based decoders take about the same time
+// for any pattern, and Wirehair decoding depends on which blocks of its sparse matrix are missing
+
+static const char* erasure_pattern_name[ERASURE_PATTERNS] = {"uniform", "burst", "worst"};
+
+
+// Mark params.RecoveryCount blocks out of the stripe as lost
+static void draw_erasures(ECC_bench_params params, ErasurePattern pattern, std::mt19937& rng, std::vector<char>& lost)
+{
+    int total = params.OriginalCount + params.RecoveryCount;
+    std::fill(lost.begin(), lost.end(), 0);
+
+    // Choose k of n positions starting at first, using partial Fisher-Yates shuffle
+    std::vector<int> positions;
+    auto choose = [&](int first, int n, int k) {
+        positions.resize(n);
+        for (int i = 0; i < n; ++i)
+            positions[i] = first + i;
+        for (int i = 0; i < k; ++i) {
+            int j = std::uniform_int_distribution<int>(i, n - 1)(rng);
+            std::swap(positions[i], positions[j]);
+            lost[positions[i]] = 1;
+        }
+    };
+
+    switch (pattern)
+    {
+    case ERASURE_UNIFORM:
+        choose(0, total, params.RecoveryCount);
+        break;
+
+    case ERASURE_BURST: {
+        int start = std::uniform_int_distribution<int>(0, total - params.RecoveryCount)(rng);
+        std::fill(lost.begin() + start, lost.begin() + start + params.RecoveryCount, 1);
+        break;
+    }
+
+    case ERASURE_WORST: {
+        int lost_originals = std::min(params.OriginalCount, params.RecoveryCount);
+        choose(0, params.OriginalCount, lost_originals);
+        choose(params.OriginalCount, params.RecoveryCount, params.RecoveryCount - lost_originals);
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+
+// Decode random erasure patterns of each kind and print distribution of decoding speeds, return false if anything failed.
+// Only the decoding itself is timed; restoring the stripe before each trial and checking recovered data are not
+bool erasures_benchmark_main(ECC_bench_params params, uint8_t* buffer, unsigned seed, const char* name, StripeCodec* codec)
+{
+    if (! codec) {   // library doesn't support these params or can't decode stripes
+        printf("%s erasures: skipped\n", name);
+        return false;
+    }
+
+    printf("%s erasures (seed %u):\n", name, seed);
+
+    // Pristine copy of the stripe, and its working copy damaged by each trial
+    uint8_t* pristine_original = buffer;
+    AlignedBuffer pristine_recovery(params.RecoveryDataBytes());
+    AlignedBuffer original(params.OriginalFileBytes()), recovery(params.RecoveryDataBytes());
+
+    if (! codec->Encode(pristine_original, pristine_recovery.data())) {
+        printf("  encoding failed\n");
+        return false;
+    }
+
+    std::mt19937 rng(seed);
+    std::vector<char> lost(params.OriginalCount + params.RecoveryCount);
+
+    for (int pattern = 0; pattern < ERASURE_PATTERNS; ++pattern)
+    {
+        OperationTimer decode_time;
+        int unrecoverable = 0, recovery_only = 0;
+
+        for (TrialLoop trial(params); trial.Next(); )
+        {
+            draw_erasures(params, ErasurePattern(pattern), rng, lost);
+
+            if (std::find(lost.begin(), lost.begin() + params.OriginalCount, 1) == lost.begin() + params.OriginalCount) {
+                ++recovery_only;   // nothing to decode
+                continue;
+            }
+
+            // Restore the stripe and overwrite lost blocks with garbage, so decoder can't get away with not recovering them
+            memcpy(original.data(), pristine_original, params.OriginalFileBytes());
+            memcpy(recovery.data(), pristine_recovery.data(), params.RecoveryDataBytes());
+            for (int i = 0; i < params.OriginalCount + params.RecoveryCount; ++i) {
+                if (! lost[i])
+                    continue;
+                uint8_t* block = (i < params.OriginalCount?  original.data() + i * params.BlockBytes
+                                                          :  recovery.data() + (i - params.OriginalCount) * params.BlockBytes);
+                memset(block, 0xEE, params.BlockBytes);
+            }
+
+            decode_time.BeginCall();
+            bool succeeded = codec->Decode(original.data(), recovery.data(), lost);
+            decode_time.EndCall();
+
+            // Only fountain codes may fail with RecoveryCount blocks lost
+            if (! succeeded) {
+                ++unrecoverable;
+                continue;
+            }
+
+            for (int i = 0; i < params.OriginalCount; ++i) {
+                if (memcmp(original.data() + i * params.BlockBytes, pristine_original + i * params.BlockBytes, params.BlockBytes)) {
+                    printf("  %s decoding recovered wrong data in block %d (trial %d)\n", erasure_pattern_name[pattern], i, trial.Trial);
+                    return false;
+                }
+            }
+        }
+
+        char operation[64];
+        snprintf(operation, sizeof(operation), "decode %s", erasure_pattern_name[pattern]);
+        decode_time.Print(operation, params.OriginalFileBytes());
+        if (unrecoverable || recovery_only)
+            printf("  %s: %d unrecoverable patterns, %d patterns without lost original blocks\n",
+                erasure_pattern_name[pattern], unrecoverable, recovery_only);
+    }
+
+    return true;
+}
@@ -0,0 +1,74 @@
+//
+// Builds of the benchmarked libraries for each instruction set.
+// CM256, Leopard and Wirehair choose their SIMD code paths at compile time, as do SSSE3 and AVX2 kernels of our codecs,
+// so benchmark_*.cpp are compiled once per instruction set with its own -m options (see compile.cmd):
+// the SSSE3 build into the global namespace, and the AVX2 and AVX-512 builds, with ISA_BUILD defined as avx2 or avx512,
+// into namespaces isa_avx2 and isa_avx512. The rest of the program is compiled for the baseline instruction set,
+// all builds are linked into a single executable, and main.cpp runs the build matching the instruction set selected at runtime
+//
+#pragma once
+
+#ifdef ISA_BUILD
+
+#define ISA_BUILD_CONCAT2(x, y)  x##_##y
+#define ISA_BUILD_CONCAT(x, y)   ISA_BUILD_CONCAT2(x, y)
+
+// Benchmark code of the build is put into its own namespace
+#define ISA_BUILD_BEGIN  namespace ISA_BUILD_CONCAT(isa, ISA_BUILD) {
+#define ISA_BUILD_END    }
+
+// Library sources declare C functions and include system headers, so they can't be put into the namespace.
+// Instead, their global symbols are renamed, e.g. cm256_encode to cm256_encode_avx2
+#define ISA_BUILD_NAME(name)  ISA_BUILD_CONCAT(name, ISA_BUILD)
+
+// GF(2^8) arithmetic shared by CM256 and Wirehair
+#define GF256Ctx              ISA_BUILD_NAME(GF256Ctx)
+#define CpuHasAVX2            ISA_BUILD_NAME(CpuHasAVX2)
+#define CpuHasSSSE3           ISA_BUILD_NAME(CpuHasSSSE3)
+#define CpuHasNeon            ISA_BUILD_NAME(CpuHasNeon)
+#define CpuHasNeon64          ISA_BUILD_NAME(CpuHasNeon64)
+#define gf256_init_           ISA_BUILD_NAME(gf256_init_)
+#define gf256_add_mem         ISA_BUILD_NAME(gf256_add_mem)
+#define gf256_add2_mem        ISA_BUILD_NAME(gf256_add2_mem)
+#define gf256_addset_mem      ISA_BUILD_NAME(gf256_addset_mem)
+#define gf256_mul_mem         ISA_BUILD_NAME(gf256_mul_mem)
+#define gf256_muladd_mem      ISA_BUILD_NAME(gf256_muladd_mem)
+#define gf256_div_mem         ISA_BUILD_NAME(gf256_div_mem)
+#define gf256_memswap         ISA_BUILD_NAME(gf256_memswap)
+
+// CM256
+#define cm256_init_           ISA_BUILD_NAME(cm256_init_)
+#define cm256_encode          ISA_BUILD_NAME(cm256_encode)
+#define cm256_encode_block    ISA_BUILD_NAME(cm256_encode_block)
+#define cm256_decode          ISA_BUILD_NAME(cm256_decode)
+#define CM256Decoder          ISA_BUILD_NAME(CM256Decoder)
+
+// Leopard, whose internals are in namespace leopard
+#define leopard               ISA_BUILD_NAME(leopard)
+#define leo_init_             ISA_BUILD_NAME(leo_init_)
+#define leo_result_string     ISA_BUILD_NAME(leo_result_string)
+#define leo_encode_work_count ISA_BUILD_NAME(leo_encode_work_count)
+#define leo_encode            ISA_BUILD_NAME(leo_encode)
+#define leo_decode_work_count ISA_BUILD_NAME(leo_decode_work_count)
+#define leo_decode            ISA_BUILD_NAME(leo_decode)
+
+// Wirehair, whose internals are in namespace wirehair
+#define wirehair                         ISA_BUILD_NAME(wirehair)
+#define wirehair_init_                   ISA_BUILD_NAME(wirehair_init_)
+#define wirehair_result_string           ISA_BUILD_NAME(wirehair_result_string)
+#define wirehair_encoder_create          ISA_BUILD_NAME(wirehair_encoder_create)
+#define wirehair_encode                  ISA_BUILD_NAME(wirehair_encode)
+#define wirehair_decoder_create          ISA_BUILD_NAME(wirehair_decoder_create)
+#define wirehair_decode                  ISA_BUILD_NAME(wirehair_decode)
+#define wirehair_recover                 ISA_BUILD_NAME(wirehair_recover)
+#define wirehair_recover_block           ISA_BUILD_NAME(wirehair_recover_block)
+#define wirehair_decoder_becomes_encoder ISA_BUILD_NAME(wirehair_decoder_becomes_encoder)
+#define wirehair_free                    ISA_BUILD_NAME(wirehair_free)
+
+#else
+
+// The SSSE3 build, as well as the rest of the program, is in the global namespace
+#define ISA_BUILD_BEGIN
+#define ISA_BUILD_END
+
+#endif
@@ -0,0 +1,73 @@
+//
+// Functions of each benchmarked library, implemented in benchmark_*.cpp.
+// There is no include guard, since common.h includes this file once per build of the libraries: into the global namespace
+// for the SSSE3 build, and into namespaces isa_avx2 and isa_avx512 for the other builds (see isa_build.h)
+//
+
+// Benchmark each library and print results, return false if anything failed
+bool cm256_benchmark_main(ECC_bench_params params, uint8_t* buffer);
+bool leopard_benchmark_main(ECC_bench_params params, uint8_t* buffer);
+bool fastecc_benchmark_main(ECC_bench_params params, uint8_t* buffer);
+bool wirehair_benchmark_main(ECC_bench_params params, uint8_t* buffer);
+bool gf256tables_benchmark_main(ECC_bench_params params, uint8_t* buffer);
+bool gf65536_benchmark_main(ECC_bench_params params, uint8_t* buffer);
+
+// Check whether each library supports the parameters
+bool cm256_supports(ECC_bench_params params);
+bool leopard_supports(ECC_bench_params params);
+bool fastecc_supports(ECC_bench_params params);
+bool wirehair_supports(ECC_bench_params params);
+bool gf256tables_supports(ECC_bench_params params);
+bool gf65536_supports(ECC_bench_params params);
+
+// Check whether each library has a code path for the instruction set in this build
+bool cm256_has_isa(int isa);
+bool gf256tables_has_isa(int isa);
+bool leopard_has_isa(int isa);
+bool fastecc_has_isa(int isa);
+bool wirehair_has_isa(int isa);
+bool gf65536_has_isa(int isa);
+
+// Restrict SIMD code paths of GF(2^8) arithmetic shared by CM256 and Wirehair to the instruction set.
+// Should be called after library initialization
+void gf256_limit_isa(int isa);
+
+// Extra workspace used by each library on top of place required for original data
+size_t cm256_extra_space(ECC_bench_params params);
+size_t leopard_extra_space(ECC_bench_params params);
+size_t fastecc_extra_space(ECC_bench_params params);
+size_t wirehair_extra_space(ECC_bench_params params);
+size_t gf256tables_extra_space(ECC_bench_params params);
+size_t gf65536_extra_space(ECC_bench_params params);
+
+// Memory touched by a single encoding, including original and recovery data, used by autotune.
+// Unlike extra space, it doesn't include decoder workspace
+size_t cm256_encode_working_set(ECC_bench_params params);
+size_t leopard_encode_working_set(ECC_bench_params params);
+size_t fastecc_encode_working_set(ECC_bench_params params);
+size_t wirehair_encode_working_set(ECC_bench_params params);
+size_t gf256tables_encode_working_set(ECC_bench_params params);
+size_t gf65536_encode_working_set(ECC_bench_params params);
+
+// CM256 encoding matrix and erasure patterns, shared with the table-driven GF(2^8) codec (benchmark_gf256tables.cpp)
+uint8_t cm256_matrix_element(int original_count, int x_i, int y_j);
+void cm256_lose_one_block(ECC_bench_params params, uint8_t* originalFileData, uint8_t* recoveryBlocks, cm256_block* blocks);
+void cm256_lose_all_blocks(ECC_bench_params params, uint8_t* originalFileData, uint8_t* recoveryBlocks, cm256_block* blocks);
+bool cm256_lose_blocks(ECC_bench_params params, uint8_t* originalFileData, uint8_t* recoveryBlocks,
+                       const std::vector<char>& lost, cm256_block* blocks);
+
+// Create stripe encoder of each library, return nullptr if library doesn't support these params
+std::unique_ptr<StripeEncoder> cm256_create_stripe_encoder(ECC_bench_params params);
+std::unique_ptr<StripeEncoder> leopard_create_stripe_encoder(ECC_bench_params params);
+std::unique_ptr<StripeEncoder> fastecc_create_stripe_encoder(ECC_bench_params params);
+std::unique_ptr<StripeEncoder> wirehair_create_stripe_encoder(ECC_bench_params params);
+std::unique_ptr<StripeEncoder> gf256tables_create_stripe_encoder(ECC_bench_params params);
+std::unique_ptr<StripeEncoder> gf65536_create_stripe_encoder(ECC_bench_params params);
+
+// The same encoders, that also decode. Return nullptr if library doesn't support these params
+std::unique_ptr<StripeCodec> cm256_create_stripe_codec(ECC_bench_params params);
+std::unique_ptr<StripeCodec> leopard_create_stripe_codec(ECC_bench_params params);
+std::unique_ptr<StripeCodec> fastecc_create_stripe_codec(ECC_bench_params params);
+std::unique_ptr<StripeCodec> wirehair_create_stripe_codec(ECC_bench_params params);
+std::unique_ptr<StripeCodec> gf256tables_create_stripe_codec(ECC_bench_params params);
+std::unique_ptr<StripeCodec> gf65536_create_stripe_codec(ECC_bench_params params);
@@ -1,7 +1,27 @@
+#include <cmath>
 #include <cstdio>
+#include <cstring>
+#include <string>
 #include <thread>
 #include "common.h"
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__))  &&  (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define HAVE_CPUID
+static void cpuid(unsigned leaf, unsigned* regs)  { __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]); }
+static uint64_t xgetbv()  { unsigned low, high;  __asm__ ("xgetbv" : "=a"(low), "=d"(high) : "c"(0));  return low | (uint64_t(high) << 32); }
+#elif defined(_MSC_VER)  &&  (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define HAVE_CPUID
+static void cpuid(unsigned leaf, unsigned* regs)  { __cpuidex((int*) regs, leaf, 0); }
+static uint64_t xgetbv()  { return _xgetbv(0); }
+#endif
+
 #include "../unit_test/SiameseTools.cpp"
 
 #define BUFSIZE_ALIGNMENT 64  /* at least 16 for SSE intrinsics, and at least 64 for Leopard */
@@ -17,20 +37,283 @@ const char *library = "";
 // File to save benchmark results
 FILE* logfile = NULL;
 
-// Write benchmark results to logfile
-void write_to_logfile(const char* operation, int invocations, double microseconds_per_call, double megabytes_per_second)
+// File to encode in streaming mode
+const char* stream_filename = NULL;
+
+// Files mapped into memory in mmap mode
+const char* mmap_filename = NULL;
+const char* mmap_output_filename = NULL;
+
+// Pipeline mode: file to encode, prefix of output files, O_DIRECT and number of stripes in flight
+const char* pipeline_filename = NULL;
+const char* pipeline_output_prefix = NULL;
+bool pipeline_direct = false;
+int pipeline_depth = 0;
+
+// Search for the best block size instead of using chunk_size
+bool autotune = false;
+
+// Seed of random erasure patterns in erasures mode, 0 if this mode is disabled
+unsigned erasures_seed = 0;
+
+// Receiver mode: blocks arrive one at a time and each one is lost with probability receiver_loss
+bool receiver = false;
+double receiver_loss = 0;
+
+// Batch mode: numbers of codewords encoded by a single call
+std::vector<int> batches;
+
+// Files to save consolidated results of all benchmarked configurations
+const char* csv_filename = NULL;
+const char* json_filename = NULL;
+
+// Values of data_blocks, parity_blocks and chunk_size to benchmark, all their combinations are tested
+std::vector<int> original_counts, recovery_counts, block_sizes;
+
+// Pages of the workspace to benchmark, set by --pages option, and placement of each thread's workspace on NUMA nodes
+std::vector<int> page_kinds = {PAGES_DEFAULT};
+bool pages_set = false;
+int placement = PLACEMENT_DEFAULT;
+
+// Instruction sets to benchmark, set by --isa option. By default, the most advanced one supported by CPU
+std::vector<int> isas;
+bool isa_set = false;
+
+const char* isa_names[ISA_COUNT] = {"scalar", "ssse3", "avx2", "avx512"};
+
+// Timer settings, see OperationTimer
+int OperationTimer::WarmupCalls = 0;
+int OperationTimer::ExpectedCalls = 0;
+
+// Single benchmark result
+struct BenchResult
 {
+    int OriginalCount, RecoveryCount, BlockBytes;
+    std::string Library, Operation;
+    int Invocations;
+    double MicrosecondsPerCall, MegabytesPerSecond;
+    bool HasStats;
+    TimingStats Stats;
+};
+
+// Results of all benchmarked configurations
+std::vector<BenchResult> results;
+
+// Write benchmark results to logfile, with optional statistics:
+// min, median, p90, p99 and stddev of time per call in usec, and MB/s at the median time
+void write_to_logfile(const char* operation, int invocations, double microseconds_per_call, double megabytes_per_second,
+                      const TimingStats* stats)
+{
+    BenchResult result = {params.OriginalCount, params.RecoveryCount, params.BlockBytes, library, operation,
+                          invocations, microseconds_per_call, megabytes_per_second, stats != nullptr, {}};
+    if (stats)
+        result.Stats = *stats;
+    results.push_back(result);
+
     if (logfile)
     {
-        fprintf(logfile, "%d,%d,%d,%s,%s,%d,%lf,%lf\n",
+        fprintf(logfile, "%d,%d,%d,%s,%s,%d,%lf,%lf",
             params.OriginalCount, params.RecoveryCount, params.BlockBytes,
             library, operation,
             invocations, microseconds_per_call, megabytes_per_second);
+        if (stats)
+            fprintf(logfile, ",%lf,%lf,%lf,%lf,%lf,%lf",
+                stats->MinUsec, stats->MedianUsec, stats->P90Usec, stats->P99Usec, stats->StddevUsec,
+                stats->MegabytesPerSecondAtMedian);
+        else
+            fprintf(logfile, ",,,,,,");
+        fprintf(logfile, "\n");
         fflush(logfile);
     }
 }
 
 
+// Write results of all benchmarked configurations as CSV table with header
+void write_csv(const char* filename)
+{
+    FILE* f = fopen(filename, "w");
+    if (! f) {
+        printf("Can't create %s\n", filename);
+        return;
+    }
+    fprintf(f, "data_blocks,parity_blocks,chunk_size,library,operation,invocations,usec,MBps,"
+               "min_usec,median_usec,p90_usec,p99_usec,stddev_usec,median_MBps,outliers\n");
+    for (auto& r : results) {
+        fprintf(f, "%d,%d,%d,%s,%s,%d,%lf,%lf", r.OriginalCount, r.RecoveryCount, r.BlockBytes,
+            r.Library.c_str(), r.Operation.c_str(), r.Invocations, r.MicrosecondsPerCall, r.MegabytesPerSecond);
+        if (r.HasStats)
+            fprintf(f, ",%lf,%lf,%lf,%lf,%lf,%lf,%d\n", r.Stats.MinUsec, r.Stats.MedianUsec, r.Stats.P90Usec,
+                r.Stats.P99Usec, r.Stats.StddevUsec, r.Stats.MegabytesPerSecondAtMedian, r.Stats.Outliers);
+        else
+            fprintf(f, ",,,,,,,\n");
+    }
+    fclose(f);
+}
+
+
+// Write results of all benchmarked configurations as JSON array of objects.
+// Infinite speeds (operations faster than timer resolution) are written as null
+void write_json(const char* filename)
+{
+    FILE* f = fopen(filename, "w");
+    if (! f) {
+        printf("Can't create %s\n", filename);
+        return;
+    }
+    auto number = [](double x) {
+        char buf[64];
+        if (std::isfinite(x))  snprintf(buf, sizeof(buf), "%.3lf", x);
+        else                   snprintf(buf, sizeof(buf), "null");
+        return std::string(buf);
+    };
+    fprintf(f, "[\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        auto& r = results[i];
+        fprintf(f, "  {\"data_blocks\": %d, \"parity_blocks\": %d, \"chunk_size\": %d, \"library\": \"%s\", \"operation\": \"%s\", "
+                   "\"invocations\": %d, \"usec\": %s, \"MBps\": %s",
+            r.OriginalCount, r.RecoveryCount, r.BlockBytes, r.Library.c_str(), r.Operation.c_str(),
+            r.Invocations, number(r.MicrosecondsPerCall).c_str(), number(r.MegabytesPerSecond).c_str());
+        if (r.HasStats)
+            fprintf(f, ", \"min_usec\": %s, \"median_usec\": %s, \"p90_usec\": %s, \"p99_usec\": %s, \"stddev_usec\": %s, \"median_MBps\": %s, \"outliers\": %d",
+                number(r.Stats.MinUsec).c_str(), number(r.Stats.MedianUsec).c_str(), number(r.Stats.P90Usec).c_str(),
+                number(r.Stats.P99Usec).c_str(), number(r.Stats.StddevUsec).c_str(), number(r.Stats.MegabytesPerSecondAtMedian).c_str(), r.Stats.Outliers);
+        fprintf(f, "}%s\n", i+1 < results.size()? "," : "");
+    }
+    fprintf(f, "]\n");
+    fclose(f);
+}
+
+
+// Parse list of values, such as "10,20,50-100:10,256-4096*2", i.e. comma-separated numbers and ranges,
+// where range from-to may have additive (:step) or multiplicative (*factor) step, by default 1
+std::vector<int> parse_list(const char* arg)
+{
+    std::vector<int> values;
+    for (const char* item = arg; *item; )
+    {
+        char* end;
+        int from = strtol(item, &end, 10), to = from, step = 1;
+        char step_type = ':';
+        if (*end == '-') {
+            to = strtol(end+1, &end, 10);
+            if (*end == ':'  ||  *end == '*') {
+                step_type = *end;
+                step = strtol(end+1, &end, 10);
+            }
+        }
+        if (step < 1  ||  (step_type == '*'  &&  (step < 2  ||  from < 1)))
+            step = (step_type == '*'? 2 : 1);
+        for (int x = from; x <= to; x = (step_type == '*'? x*step : x+step))
+            values.push_back(x);
+        item = (*end == ','? end+1 : end);
+        if (*end  &&  *end != ',')   // garbage in the list
+            break;
+    }
+    return values;
+}
+
+
+// CPU features required by library kernels
+struct CpuFeatures
+{
+    int Isa;
+    bool Gfni;
+};
+
+// Detect CPU features with CPUID, and check that OS saves the registers on context switch (XCR0)
+static CpuFeatures detect_cpu()
+{
+    CpuFeatures cpu = {ISA_SCALAR, false};
+#ifdef HAVE_CPUID
+    unsigned regs[4];   // eax, ebx, ecx, edx
+    cpuid(0, regs);
+    unsigned max_leaf = regs[0];
+
+    cpuid(1, regs);
+    bool ssse3 = (regs[2] & (1 << 9)) != 0,  osxsave = (regs[2] & (1 << 27)) != 0,  avx = (regs[2] & (1 << 28)) != 0;
+    if (! ssse3)
+        return cpu;
+    cpu.Isa = ISA_SSSE3;
+    if (! osxsave  ||  ! avx  ||  max_leaf < 7)
+        return cpu;
+
+    uint64_t xcr0 = xgetbv();
+    cpuid(7, regs);
+    bool avx2 = (regs[1] & (1 << 5)) != 0,  avx512f = (regs[1] & (1 << 16)) != 0,  avx512bw = (regs[1] & (1u << 30)) != 0;
+    if (avx2  &&  (xcr0 & 0x06) == 0x06)   // XMM and YMM registers
+        cpu.Isa = ISA_AVX2;
+    if (cpu.Isa == ISA_AVX2  &&  avx512f  &&  avx512bw  &&  (xcr0 & 0xE6) == 0xE6)   // plus opmask and ZMM registers
+        cpu.Isa = ISA_AVX512;
+    cpu.Gfni = (regs[2] & (1 << 8)) != 0;
+#endif
+    return cpu;
+}
+
+int cpu_isa()
+{
+    static const CpuFeatures cpu = detect_cpu();
+    return cpu.Isa;
+}
+
+bool cpu_has_gfni()
+{
+    static const CpuFeatures cpu = detect_cpu();
+    return cpu.Gfni;
+}
+
+
+// Parse list of instruction sets, e.g. "ssse3,avx2", or "all" for all instruction sets supported by CPU
+std::vector<int> parse_isa_list(const char* arg)
+{
+    std::vector<int> values;
+    std::string list = arg;
+    for (size_t start = 0; start <= list.size(); )
+    {
+        size_t end = std::min(list.find(',', start), list.size());
+        std::string name = list.substr(start, end - start);
+        start = end + 1;
+
+        int isa = 0;
+        while (isa < ISA_COUNT  &&  name != isa_names[isa])
+            ++isa;
+        if (name == "all")
+            for (isa = 0; isa <= cpu_isa(); ++isa)
+                values.push_back(isa);
+        else if (isa < ISA_COUNT)
+            values.push_back(isa);
+        else if (! name.empty())
+            printf("Unknown instruction set: %s\n", name.c_str());
+    }
+    return values;
+}
+
+
+// Parse comma-separated list of page kinds, e.g. "default,thp,2m", or "all"
+std::vector<int> parse_pages_list(const char* arg)
+{
+    std::vector<int> values;
+    std::string list = arg;
+    for (size_t start = 0; start <= list.size(); )
+    {
+        size_t end = std::min(list.find(',', start), list.size());
+        std::string name = list.substr(start, end - start);
+        start = end + 1;
+
+        int pages = 0;
+        while (pages < PAGES_COUNT  &&  name != page_names[pages])
+            ++pages;
+        if (name == "all")
+            for (pages = 0; pages < PAGES_COUNT; ++pages)
+                values.push_back(pages);
+        else if (pages < PAGES_COUNT)
+            values.push_back(pages);
+        else if (! name.empty())
+            printf("Unknown page kind: %s\n", name.c_str());
+    }
+    return values;
+}
+
+
 // Parse ECC parameters from cmdline
 void parse_cmdline(int argc, char** argv)
 {
@@ -46,18 +329,310 @@ void parse_cmdline(int argc, char** argv)
     // Repeat benchmark multiple times to improve its accuracy
     params.Trials = 1000;
 
-    if (argc==1) printf("Usage: bench data_blocks parity_blocks chunk_size trials logfile\n");
-    if (argc>1)  params.OriginalCount = atoi(argv[1]);
-    if (argc>2)  params.RecoveryCount = atoi(argv[2]);
-    if (argc>3)  params.BlockBytes    = atoi(argv[3]);
-    if (argc>4)  params.Trials        = atoi(argv[4]);
-    if (argc>5)  logfile              = fopen(argv[5],"a");
+    // Single-threaded benchmark by default
+    params.Threads = 1;
+
+    // Run params.Trials trials by default
+    params.TimeBudgetUsec = 0;
+
+    // FastECC with 32-bit words and recursive NTT by default
+    params.FastECCBits = 32;
+    params.FastECCTileBytes = 0;
+
+    // Leopard chooses its field itself
+    params.LeopardBits = 0;
+
+    // Wirehair recovery blocks are generated by the benchmark thread only
+    params.WirehairThreads = 1;
+    bool trials_set = false;
+
+    if (argc==1) printf("Usage: bench [--threads N] [--warmup N] [--perf] [--stream FILE] [--mmap FILE [--mmap-output FILE]]\n"
+                        "             [--time-budget SEC] [--csv FILE] [--json FILE] [--autotune] [--isa LIST]\n"
+                        "             [--fastecc-bits 32|64] [--fastecc-tile KB] [--wirehair-threads N] [--erasures SEED]\n"
+                        "             [--receiver LOSS] [--leopard-bits 8|16] [--batch LIST]\n"
+                        "             [--pipeline FILE [--pipeline-output PREFIX] [--pipeline-depth N] [--direct]]\n"
+                        "             [--pages LIST] [--numa first-touch|bind]\n"
+                        "             data_blocks parity_blocks chunk_size trials logfile\n"
+                        "data_blocks, parity_blocks and chunk_size may be lists and ranges, e.g. 10,20,50-100:10,256-4096*2\n"
+                        "--isa selects instruction sets to benchmark: scalar, ssse3, avx2, avx512 or all, e.g. --isa ssse3,avx2\n"
+                        "--pages selects workspace pages to benchmark: default, 4k, thp, 2m, 1g or all, e.g. --pages 4k,thp,2m\n");
+
+    // Options start with "--" and may be placed anywhere, other arguments are positional
+    int arg = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strncmp(argv[i], "--", 2) == 0)
+        {
+            const char* option = argv[i] + 2;
+            const char* value = strchr(option, '=');
+            size_t option_len = value? value - option : strlen(option);
+            auto is_option = [&](const char* name) {
+                return option_len == strlen(name)  &&  strncmp(option, name, option_len) == 0;
+            };
+
+            // Flags don't have a value
+            bool is_flag = is_option("perf")  ||  is_option("autotune")  ||  is_option("direct");
+            if (value)  value++;
+            else if (!is_flag  &&  i+1 < argc)  value = argv[++i];
+            else  value = "";
+
+            if (is_option("threads"))
+                params.Threads = std::max(atoi(value), 1);
+            else if (is_option("warmup"))
+                OperationTimer::WarmupCalls = std::max(atoi(value), 0);
+            else if (is_option("perf"))
+                PerfCounters::Enabled = true;
+            else if (is_option("autotune"))
+                autotune = true;
+            else if (is_option("erasures"))
+                erasures_seed = std::max(atoi(value), 1);
+            else if (is_option("receiver")) {
+                receiver = true;
+                receiver_loss = std::min(std::max(atof(value), 0.0), 0.99);
+            }
+            else if (is_option("stream"))
+                stream_filename = value;
+            else if (is_option("mmap"))
+                mmap_filename = value;
+            else if (is_option("mmap-output"))
+                mmap_output_filename = value;
+            else if (is_option("pipeline"))
+                pipeline_filename = value;
+            else if (is_option("pipeline-output"))
+                pipeline_output_prefix = value;
+            else if (is_option("pipeline-depth"))
+                pipeline_depth = std::max(atoi(value), 0);
+            else if (is_option("direct"))
+                pipeline_direct = true;
+            else if (is_option("time-budget"))
+                params.TimeBudgetUsec = uint64_t(std::max(atof(value), 0.0) * 1e6);
+            else if (is_option("csv"))
+                csv_filename = value;
+            else if (is_option("json"))
+                json_filename = value;
+            else if (is_option("batch"))
+                batches = parse_list(value);
+            else if (is_option("leopard-bits"))
+                params.LeopardBits = (atoi(value) == 8? 8 : atoi(value) == 16? 16 : 0);
+            else if (is_option("fastecc-bits")) {
+                if (strcmp(value, "32") == 0  ||  strcmp(value, "64") == 0)
+                    params.FastECCBits = atoi(value);
+                else
+                    printf("Unknown FastECC word size: %s\n", value);
+            }
+            else if (is_option("fastecc-tile"))
+                params.FastECCTileBytes = size_t(std::max(atoi(value), 0)) << 10;
+            else if (is_option("wirehair-threads"))
+                params.WirehairThreads = std::max(atoi(value), 1);
+            else if (is_option("pages")) {
+                page_kinds = parse_pages_list(value);
+                pages_set = true;
+            }
+            else if (is_option("numa")) {
+                placement = PLACEMENT_DEFAULT;
+                while (placement < PLACEMENT_COUNT  &&  strcmp(value, placement_names[placement]) != 0)
+                    ++placement;
+                if (placement == PLACEMENT_COUNT) {
+                    printf("Unknown NUMA placement: %s\n", value);
+                    placement = PLACEMENT_DEFAULT;
+                }
+            }
+            else if (is_option("isa")) {
+                isas = parse_isa_list(value);
+                isa_set = true;
+            }
+            else
+                printf("Unknown option: %s\n", argv[i]);
+            continue;
+        }
+
+        switch (++arg)
+        {
+            case 1:  original_counts = parse_list(argv[i]);  break;
+            case 2:  recovery_counts = parse_list(argv[i]);  break;
+            case 3:  block_sizes     = parse_list(argv[i]);  break;
+            case 4:  params.Trials   = atoi(argv[i]);  trials_set = true;  break;
+            case 5:  logfile         = fopen(argv[i],"a");  break;
+        }
+    }
+
+    if (original_counts.empty())  original_counts.push_back(params.OriginalCount);
+    if (recovery_counts.empty())  recovery_counts.push_back(params.RecoveryCount);
+    if (block_sizes.empty())      block_sizes.push_back(params.BlockBytes);
+    if (isas.empty())             isas.push_back(cpu_isa());
+    if (page_kinds.empty())       page_kinds.push_back(PAGES_DEFAULT);
+
+    // With time budget, number of trials is limited only by the budget, unless it's explicitly specified
+    if (params.TimeBudgetUsec  &&  ! trials_set)
+        params.Trials = 1000000;
+
+    // Preallocate place for timing samples of all trials, but not too much in the time budget mode
+    OperationTimer::ExpectedCalls = std::min(std::max(params.Trials, 0), 100000);
+}
 
-    // Round up for compatibility with all benchmarked libraries
-    params.BlockBytes = align_up(params.BlockBytes, BUFSIZE_ALIGNMENT);
 
-    printf("Params: data_blocks=%d parity_blocks=%d chunk_size=%d trials=%d\n",
+// Print parameters of the benchmarked configuration
+void print_params()
+{
+    printf("Params: data_blocks=%d parity_blocks=%d chunk_size=%d trials=%d",
         params.OriginalCount, params.RecoveryCount, params.BlockBytes, params.Trials);
+    if (params.TimeBudgetUsec)
+        printf(" time_budget=%g", params.TimeBudgetUsec / 1e6);
+    if (params.Threads > 1)
+        printf(" threads=%d", params.Threads);
+    if (OperationTimer::WarmupCalls > 0)
+        printf(" warmup=%d", OperationTimer::WarmupCalls);
+    if (PerfCounters::Enabled)
+        printf(" perf");
+    if (stream_filename)
+        printf(" stream=%s", stream_filename);
+    if (mmap_filename)
+        printf(" mmap=%s", mmap_filename);
+    if (pipeline_filename)
+        printf(" pipeline=%s", pipeline_filename);
+    if (pipeline_depth)
+        printf(" pipeline_depth=%d", pipeline_depth);
+    if (pipeline_direct)
+        printf(" direct");
+    if (autotune)
+        printf(" autotune");
+    if (erasures_seed)
+        printf(" erasures=%u", erasures_seed);
+    if (receiver)
+        printf(" receiver_loss=%g", receiver_loss);
+    if (! batches.empty()) {
+        printf(" batch=");
+        for (size_t i = 0; i < batches.size(); ++i)
+            printf("%s%d", i? "," : "", batches[i]);
+    }
+    if (params.LeopardBits)
+        printf(" leopard_bits=%d", params.LeopardBits);
+    if (params.FastECCBits != 32)
+        printf(" fastecc_bits=%d", params.FastECCBits);
+    if (params.FastECCTileBytes)
+        printf(" fastecc_tile=%dK", int(params.FastECCTileBytes >> 10));
+    if (params.WirehairThreads > 1)
+        printf(" wirehair_threads=%d", params.WirehairThreads);
+    if (pages_set) {
+        printf(" pages=");
+        for (size_t i = 0; i < page_kinds.size(); ++i)
+            printf("%s%s", i? "," : "", page_names[page_kinds[i]]);
+    }
+    if (placement != PLACEMENT_DEFAULT)
+        printf(" numa=%s", placement_names[placement]);
+    printf(" isa=");
+    for (size_t i = 0; i < isas.size(); ++i)
+        printf("%s%s", i? "," : "", isa_names[isas[i]]);
+    printf("\n");
+}
+
+
+// Pin the current thread to the given CPU core
+void pin_thread_to_core(int core)
+{
+    core %= std::max(std::thread::hardware_concurrency(), 1u);
+#ifdef _WIN32
+    ::SetThreadAffinityMask(::GetCurrentThread(), DWORD_PTR(1) << core);
+#elif defined(__linux__)
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(core, &cpuset);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+#endif
+}
+
+
+// Run benchmark(thread, thread_buffer) on params.Threads threads simultaneously, each thread pinned
+// to its own CPU core and working in its own workspace. Return false if benchmark failed in any thread
+bool run_on_threads(ECC_bench_params params, uint8_t* buffer, std::function<bool(int,uint8_t*)> benchmark)
+{
+    std::vector<std::thread> threads;
+    std::vector<char> succeeded(params.Threads, false);
+
+    for (int i = 0; i < params.Threads; ++i)
+    {
+        threads.emplace_back([&, i]() {
+            pin_thread_to_core(i);
+            succeeded[i] = benchmark(i, buffer + i * params.WorkspaceBytes);
+        });
+    }
+
+    bool result = true;
+    for (int i = 0; i < params.Threads; ++i)
+    {
+        threads[i].join();
+        result = result && succeeded[i];
+    }
+    return result;
+}
+
+
+ThreadPool::ThreadPool(int threads)
+{
+    for (int i = 1; i < threads; ++i)
+        Workers.emplace_back([this, i]() { WorkerLoop(i); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Stopping = true;
+    }
+    Started.notify_all();
+    for (auto& worker : Workers)
+        worker.join();
+}
+
+bool ThreadPool::Run(size_t count, std::function<bool(size_t)> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Job = job;
+        Count = count;
+        Next = 0;
+        Failed = false;
+        Busy = int(Workers.size());
+        Generation++;
+    }
+    Started.notify_all();
+
+    Work();
+
+    std::unique_lock<std::mutex> lock(Mutex);
+    Finished.wait(lock, [this]() { return Busy == 0; });
+    return ! Failed;
+}
+
+// Take jobs until all of them are handed out
+void ThreadPool::Work()
+{
+    for (size_t i; (i = Next++) < Count; ) {
+        if (! Job(i))
+            Failed = true;
+    }
+}
+
+void ThreadPool::WorkerLoop(int core)
+{
+    pin_thread_to_core(core);
+    uint64_t generation = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(Mutex);
+            Started.wait(lock, [&]() { return Stopping  ||  Generation != generation; });
+            if (Stopping)
+                return;
+            generation = Generation;
+        }
+
+        Work();
+
+        std::lock_guard<std::mutex> lock(Mutex);
+        if (--Busy == 0)
+            Finished.notify_one();
+    }
 }
 
 
@@ -69,41 +644,248 @@ void occupy_cpu_core()
     ::SetPriorityClass(::GetCurrentProcess(), HIGH_PRIORITY_CLASS);
     ::SetThreadPriority(::GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
 #endif
+    // Single-threaded baseline should run on a fixed core too, in order to compare it with pinned threads.
+    // With NUMA placement, its workspace is placed on the node of core 0, so it has to run there
+    if (params.Threads > 1  ||  placement != PLACEMENT_DEFAULT)
+        pin_thread_to_core(0);
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
 }
 
 
-// Benchmark all libraries using parameters provided on cmdline
-int main(int argc, char** argv)
+// Benchmarked libraries
+struct ECC_library
 {
-    // Setup benchmark configuration based on cmdline options
-    parse_cmdline(argc, argv);
+    const char* name;
+    bool (*supports)(ECC_bench_params params);
+    bool (*benchmark_main)(ECC_bench_params params, uint8_t* buffer);
+    std::unique_ptr<StripeEncoder> (*create_stripe_encoder)(ECC_bench_params params);
+    std::unique_ptr<StripeCodec> (*create_stripe_codec)(ECC_bench_params params);
+    size_t (*extra_space)(ECC_bench_params params);
+    size_t (*encode_working_set)(ECC_bench_params params);
+    bool (*has_isa)(int isa);
+};
+
+// Entry of the library table with functions of the library build in namespace ns
+#define ECC_LIBRARY(name, ns, lib)  {name, ns::lib##_supports, ns::lib##_benchmark_main, ns::lib##_create_stripe_encoder, \
+    ns::lib##_create_stripe_codec, ns::lib##_extra_space, ns::lib##_encode_working_set, ns::lib##_has_isa}
+
+#define ECC_LIBRARIES(ns)  {                        \
+    ECC_LIBRARY("CM256",       ns, cm256),          \
+    ECC_LIBRARY("GF256Tables", ns, gf256tables),    \
+    ECC_LIBRARY("GF65536",     ns, gf65536),        \
+    ECC_LIBRARY("Leopard",     ns, leopard),        \
+    ECC_LIBRARY("FastECC",     ns, fastecc),        \
+    ECC_LIBRARY("Wirehair",    ns, wirehair),       \
+}
+
+// Libraries compiled for each instruction set (see isa_build.h): the SSSE3 build in the global namespace,
+// and the AVX2 and AVX-512 builds in namespaces isa_avx2 and isa_avx512
+const ECC_library libraries[][6] = {ECC_LIBRARIES(), ECC_LIBRARIES(isa_avx2), ECC_LIBRARIES(isa_avx512)};
+
+// Build of the libraries benchmarked with the instruction set, as index in libraries[].
+// Scalar code paths are run by the SSSE3 build
+static int library_build(int isa)
+{
+    return isa >= ISA_AVX512? 2 : isa >= ISA_AVX2? 1 : 0;
+}
+
+
+// Benchmark all libraries with the current params, working in the buffer (for in-memory modes).
+// pages >= 0 labels the results with the kind of workspace pages
+void benchmark_libraries(uint8_t* buffer, int pages)
+{
+    std::string output_filename = mmap_output_filename? mmap_output_filename :
+                                  mmap_filename? std::string(mmap_filename) + ".parity" : "";
+    std::string pipeline_prefix = pipeline_output_prefix? pipeline_output_prefix :
+                                  pipeline_filename? std::string(pipeline_filename) + ".shard" : "";
 
-    // Alloc single buffer large enough for any operation in any tested library
-    size_t bufsize = params.OriginalFileBytes() +
-                         std::max(params.RecoveryDataBytes(),   // CM256/Wirehair extra space
-                         std::max(leopard_extra_space(params),
-                                  fastecc_extra_space(params)));
-    auto buffer = new uint8_t[bufsize + BUFSIZE_ALIGNMENT];
+    // Benchmark each library with each instruction set, skipping those that can't handle these params
+    for (int isa : isas)
+    {
+        params.Isa = isa;
+        for (auto& lib : libraries[library_build(isa)])
+        {
+            // With --isa option, results are labeled with the instruction set, e.g. CM256/avx2,
+            // and libraries are benchmarked only with the instruction sets they have code paths for
+            std::string name = lib.name;
+            if (isa_set)
+                name = name + "/" + isa_names[isa];
+            // Similarly, with --pages option, e.g. CM256/2m or CM256/avx2/2m
+            if (pages >= 0)
+                name = name + "/" + page_names[pages];
+            library = name.c_str();
 
-    // Align buffer start for compatibility with all benchmarked libraries
-    buffer = (uint8_t*) align_up(uintptr_t(buffer), BUFSIZE_ALIGNMENT);
+            if (isa > cpu_isa()) {
+                printf("%s: skipped, %s isn't supported by CPU\n", library, isa_names[isa]);
+                write_to_logfile("skipped", 0, 0, 0);
+                continue;
+            }
+            if (isa_set  &&  ! lib.has_isa(isa)) {
+                printf("%s: skipped, no %s code path in this build\n", library, isa_names[isa]);
+                write_to_logfile("skipped", 0, 0, 0);
+                continue;
+            }
+            if (! lib.supports(params)) {
+                printf("%s: skipped, unsupported parameters\n", library);
+                write_to_logfile("skipped", 0, 0, 0);
+                continue;
+            }
 
-    // Fill place allocated for the file contents with random numbers.
-    // It's critical to fill it with non-repeating data
-    // since some libraries rely on table lookups
-    // and can get unfair speedup on repeated data.
-    for (size_t i = 0; i < params.OriginalFileBytes(); ++i) {
-        buffer[i] = (uint8_t)((i*123456791) >> 13);
+            if (autotune)
+                // Autotune mode: search for the best block size
+                autotune_main(params, library, lib.encode_working_set, lib.create_stripe_encoder);
+            else if (stream_filename)
+                // Streaming mode: encode the file stripe by stripe, instead of benchmarking a single codeword in memory
+                stream_benchmark_main(params, stream_filename, library, lib.create_stripe_encoder(params).get());
+            else if (mmap_filename)
+                // Mmap mode: encode the mapped input file, writing recovery data directly into the mapped output file
+                mmap_benchmark_main(params, mmap_filename, output_filename.c_str(), library, lib.create_stripe_encoder(params).get());
+            else if (pipeline_filename)
+                // Pipeline mode: overlap file reads, encoding on worker threads, and writes of data and parity files
+                pipeline_benchmark_main(params, pipeline_filename, pipeline_prefix.c_str(), pipeline_direct, pipeline_depth,
+                                        library, lib.create_stripe_encoder);
+            else if (erasures_seed)
+                // Erasures mode: decode random erasure patterns and check recovered data
+                erasures_benchmark_main(params, buffer, erasures_seed, library, lib.create_stripe_codec(params).get());
+            else if (receiver)
+                // Receiver mode: decode blocks as they arrive one by one
+                receiver_benchmark_main(params, buffer, receiver_loss, library, lib.create_stripe_codec(params).get());
+            else if (! batches.empty())
+                // Batch mode: encode multiple interleaved codewords by a single call
+                batch_benchmark_main(params, batches, library, lib.create_stripe_encoder);
+            else
+                lib.benchmark_main(params, buffer);
+        }
     }
+    library = "";
+}
+
+
+// Print speed of each operation with each kind of pages relative to the first kind, comparing results
+// of the current configuration starting at first_result. Speeds are taken at the median time, as OperationTimer prints them
+void print_pages_delta(size_t first_result)
+{
+    // Operations taking less than a microsecond have infinite speed, and can't be compared
+    auto speed = [](const BenchResult& r)  {
+        double speed = (r.HasStats? r.Stats.MegabytesPerSecondAtMedian : r.MegabytesPerSecond);
+        return std::isfinite(speed)? speed : 0;
+    };
+    std::string base_suffix = std::string("/") + page_names[page_kinds[0]];
+
+    printf("Speed vs %s pages:\n", page_names[page_kinds[0]]);
+    for (size_t k = 1; k < page_kinds.size(); ++k)
+    {
+        std::string suffix = std::string("/") + page_names[page_kinds[k]];
+        std::string current;   // library of the line being printed
+        for (size_t i = first_result; i < results.size(); ++i)
+        {
+            const BenchResult& r = results[i];
+            if (r.Library.size() <= suffix.size()  ||  r.Library.compare(r.Library.size() - suffix.size(), suffix.size(), suffix) != 0
+                ||  speed(r) <= 0)
+                continue;
+
+            std::string base_library = r.Library.substr(0, r.Library.size() - suffix.size()) + base_suffix;
+            for (size_t j = first_result; j < results.size(); ++j)
+            {
+                const BenchResult& base = results[j];
+                if (base.Library != base_library  ||  base.Operation != r.Operation  ||  speed(base) <= 0)
+                    continue;
+                printf("%s%s %+.1lf%%", r.Library == current? ", " : current.empty()? "  " : "\n  ",
+                    (r.Library == current? r.Operation : r.Library + ": " + r.Operation).c_str(),
+                    (speed(r) / speed(base) - 1) * 100);
+                current = r.Library;
+                break;
+            }
+        }
+        if (! current.empty())
+            printf("\n");
+    }
+}
+
 
-    // Benchmark each library
+// Benchmark all libraries with the current params, once for each kind of workspace pages in the in-memory modes
+void benchmark_configuration()
+{
+    print_params();
+
+    bool in_memory = ! stream_filename  &&  ! mmap_filename  &&  ! pipeline_filename  &&  ! autotune  &&  batches.empty();
+    if (! in_memory) {
+        benchmark_libraries(nullptr, -1);
+        return;
+    }
+
+    size_t first_result = results.size();
+    for (int pages : page_kinds)
+    {
+        // Alloc single buffer large enough for any operation in any tested library
+        size_t extra_space = 0;
+        for (auto& lib : libraries[0])
+            extra_space = std::max(extra_space, lib.extra_space(params));
+        size_t bufsize = params.OriginalFileBytes() + extra_space;
+        // Each thread works in its own copy of the workspace, starting at a page boundary if it's placed on NUMA node
+        // of the thread. Buffer start is aligned for compatibility with all benchmarked libraries
+        size_t alignment = (placement != PLACEMENT_DEFAULT? Workspace::PageBytes(pages) : BUFSIZE_ALIGNMENT);
+        params.WorkspaceBytes = align_up(bufsize, alignment);
+
+        // Fill place allocated for the file contents with random numbers.
+        // It's critical to fill it with non-repeating data
+        // since some libraries rely on table lookups
+        // and can get unfair speedup on repeated data.
+        Workspace workspace;
+        bool allocated = workspace.Allocate(params.WorkspaceBytes, params.Threads, pages, placement, [&](int, uint8_t* original) {
+            for (size_t i = 0; i < params.OriginalFileBytes(); ++i) {
+                original[i] = (uint8_t)((i*123456791) >> 13);
+            }
+        });
+        if (! allocated)
+            continue;
+
+        if (pages_set  ||  placement != PLACEMENT_DEFAULT) {
+            printf("Workspace with %s pages: %.1lf MB, %.0lf%% in huge pages", page_names[pages],
+                workspace.size() / 1e6, 100.0 * workspace.HugePageBytes() / workspace.size());
+            if (placement != PLACEMENT_DEFAULT) {
+                printf(", %s on NUMA nodes", placement_names[placement]);
+                for (size_t i = 0; i < workspace.Nodes.size(); ++i)
+                    printf("%s%d", i? "," : " ", workspace.Nodes[i]);
+            }
+            printf("\n");
+        }
+
+        benchmark_libraries(workspace.data(), pages_set? pages : -1);
+    }
+
+    if (page_kinds.size() > 1)
+        print_pages_delta(first_result);
+}
+
+
+// Benchmark all libraries using parameters provided on cmdline
+int main(int argc, char** argv)
+{
+    // Setup benchmark configuration based on cmdline options
+    parse_cmdline(argc, argv);
     occupy_cpu_core();
-    library = "CM256";    cm256_benchmark_main(params, buffer);
-    library = "Leopard";  leopard_benchmark_main(params, buffer);
-    library = "FastECC";  fastecc_benchmark_main(params, buffer);
-    library = "Wirehair"; wirehair_benchmark_main(params, buffer);
 
+    // Benchmark all combinations of data_blocks, parity_blocks and chunk_size
+    for (int block_size : block_sizes)
+    {
+        for (int original_count : original_counts)
+        {
+            for (int recovery_count : recovery_counts)
+            {
+                params.OriginalCount = original_count;
+                params.RecoveryCount = recovery_count;
+                // Round up for compatibility with all benchmarked libraries
+                params.BlockBytes = align_up(block_size, BUFSIZE_ALIGNMENT);
+                if (params.OriginalCount < 1  ||  params.RecoveryCount < 1  ||  params.BlockBytes < 1)
+                    continue;
+                benchmark_configuration();
+            }
+        }
+    }
+
+    if (csv_filename)   write_csv(csv_filename);
+    if (json_filename)  write_json(json_filename);
     if (logfile)  fclose(logfile);
     return 0;
 }
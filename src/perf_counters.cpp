@@ -0,0 +1,155 @@
+//
+// Hardware performance counters: cycles, instructions, L1D/LLC misses and branch misses of the current thread.
+// Implemented with perf_event_open on Linux, other systems report that counters are unavailable
+//
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+#include "common.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+bool PerfCounters::Enabled = false;
+
+
+// Report unavailable counters only once per run
+static void report_unavailable(const char* reason)
+{
+    static bool reported = false;
+    if (! reported) {
+        printf("  perf counters unavailable: %s\n", reason);
+        reported = true;
+    }
+}
+
+
+void PerfCounters::Open()
+{
+    Opened = true;
+#ifdef __linux__
+    static const struct { uint32_t type; uint64_t config; } events[COUNT] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},   // last level cache
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    };
+
+    // All counters are read at once as a group led by the cycles counter.
+    // Counters unsupported by the CPU are skipped, but the group can't exist without its leader
+    int slots = 0;
+    for (int i = 0; i < COUNT; ++i)
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[i].type;
+        attr.config = events[i].config;
+        attr.exclude_kernel = 1;   // allowed with the default perf_event_paranoid setting
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+
+        // Count the current thread on any CPU
+        Fds[i] = int(syscall(__NR_perf_event_open, &attr, 0, -1, Leader, 0));
+        if (Fds[i] < 0) {
+            if (i == CYCLES) {
+                report_unavailable(strerror(errno));
+                return;
+            }
+            continue;
+        }
+        if (i == CYCLES)
+            Leader = Fds[i];
+        Slots[i] = slots++;
+    }
+#else
+    report_unavailable("not supported on this OS");
+#endif
+}
+
+
+PerfCounters::~PerfCounters()
+{
+#ifdef __linux__
+    for (int i = 0; i < COUNT; ++i)
+        if (Fds[i] >= 0)
+            close(Fds[i]);
+#endif
+}
+
+
+// Read current values of all available counters, return false on failure
+bool PerfCounters::Read(uint64_t* values)
+{
+#ifdef __linux__
+    uint64_t buffer[1+COUNT];   // number of counters followed by their values
+    if (read(Leader, buffer, sizeof(buffer)) <= 0)
+        return false;
+    for (int i = 0; i < COUNT; ++i)
+        values[i] = (Slots[i] >= 0? buffer[1+Slots[i]] : 0);
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+void PerfCounters::Start()
+{
+    if (! Enabled)
+        return;
+    if (! Opened)
+        Open();
+    if (Leader >= 0  &&  ! Read(Begin))
+        Leader = -1;
+}
+
+
+void PerfCounters::Stop(bool measured)
+{
+    uint64_t end[COUNT];
+    if (! Enabled  ||  Leader < 0  ||  ! Read(end))
+        return;
+    if (measured)
+        for (int i = 0; i < COUNT; ++i)
+            Totals[i] += end[i] - Begin[i];
+}
+
+
+void PerfCounters::Reset()
+{
+    memset(Totals, 0, sizeof(Totals));
+}
+
+
+void PerfCounters::Print(uint64_t bytes_processed, uint64_t calls)
+{
+    if (! Enabled  ||  Leader < 0  ||  Totals[CYCLES] == 0  ||  calls == 0)
+        return;
+
+    char misses[3][32];
+    int counters[3] = {L1D_MISSES, LLC_MISSES, BRANCH_MISSES};
+    for (int i = 0; i < 3; ++i) {
+        if (Slots[counters[i]] < 0)
+            snprintf(misses[i], sizeof(misses[i]), "n/a");
+        else if (bytes_processed)
+            snprintf(misses[i], sizeof(misses[i]), "%.2lf", Totals[counters[i]] * 1024.0 / bytes_processed);
+        else
+            snprintf(misses[i], sizeof(misses[i]), "%.0lf", double(Totals[counters[i]]) / calls);
+    }
+
+    double ipc = (Slots[INSTRUCTIONS] >= 0? double(Totals[INSTRUCTIONS]) / Totals[CYCLES] : 0);
+    if (bytes_processed)
+        printf("    perf: %.2lf cycles/byte, IPC %.2lf, per KB: %s L1D misses, %s LLC misses, %s branch misses\n",
+            double(Totals[CYCLES]) / bytes_processed, ipc, misses[0], misses[1], misses[2]);
+    else
+        printf("    perf: %.0lf cycles, IPC %.2lf, per call: %s L1D misses, %s LLC misses, %s branch misses\n",
+            double(Totals[CYCLES]) / calls, ipc, misses[0], misses[1], misses[2]);
+}
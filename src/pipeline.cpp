@@ -0,0 +1,506 @@
+//
+// Pipeline benchmark: read stripes from a file with io_uring, encode them on worker threads
+// and write data and parity blocks into data_blocks+parity_blocks separate files, with all three stages overlapped
+//
+
+#include <cstdio>
+#include <cstring>
+#include <deque>
+
+#include "common.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+// Asynchronous reads and writes with io_uring, driven by raw syscalls, so liburing isn't required.
+// If the kernel doesn't support io_uring, operations are performed synchronously by Prep(),
+// and their completions are returned by Peek() in the same way
+class PipelineIO
+{
+public:
+    ~PipelineIO()
+    {
+        if (SqRing && SqRing != MAP_FAILED)  munmap(SqRing, SqRingBytes);
+        if (CqRing && CqRing != MAP_FAILED  &&  CqRing != SqRing)  munmap(CqRing, CqRingBytes);
+        if (Sqes && Sqes != MAP_FAILED)  munmap(Sqes, SqesBytes);
+        if (Fd >= 0)  close(Fd);
+    }
+
+    // Set up the ring with at least `entries` submission entries, return false if io_uring isn't available
+    bool Init(unsigned entries)
+    {
+        struct io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        Fd = int(syscall(__NR_io_uring_setup, entries, &p));
+        if (Fd < 0)
+            return false;
+
+        SqRingBytes = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        CqRingBytes = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        if (p.features & IORING_FEAT_SINGLE_MMAP)
+            SqRingBytes = CqRingBytes = std::max(SqRingBytes, CqRingBytes);
+        SqesBytes = p.sq_entries * sizeof(struct io_uring_sqe);
+
+        SqRing = mmap(NULL, SqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Fd, IORING_OFF_SQ_RING);
+        CqRing = (p.features & IORING_FEAT_SINGLE_MMAP)?  SqRing :
+                 mmap(NULL, CqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Fd, IORING_OFF_CQ_RING);
+        Sqes = (struct io_uring_sqe*) mmap(NULL, SqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Fd, IORING_OFF_SQES);
+        if (SqRing == MAP_FAILED  ||  CqRing == MAP_FAILED  ||  Sqes == MAP_FAILED)
+            return false;
+
+        uint8_t* sq = (uint8_t*) SqRing;
+        uint8_t* cq = (uint8_t*) CqRing;
+        SqHead  = (unsigned*)(sq + p.sq_off.head);
+        SqTail  = (unsigned*)(sq + p.sq_off.tail);
+        SqMask  = *(unsigned*)(sq + p.sq_off.ring_mask);
+        SqArray = (unsigned*)(sq + p.sq_off.array);
+        SqEntries = p.sq_entries;
+        CqHead  = (unsigned*)(cq + p.cq_off.head);
+        CqTail  = (unsigned*)(cq + p.cq_off.tail);
+        CqMask  = *(unsigned*)(cq + p.cq_off.ring_mask);
+        Cqes    = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+        UseRing = true;
+        return true;
+    }
+
+    // Without io_uring, completions of operations performed by Prep() are waiting for Peek()
+    bool HasCompletions()  { return ! Completions.empty(); }
+
+    // Queue read (IORING_OP_READ) or write (IORING_OP_WRITE) of len bytes at offset, return false on failure
+    bool Prep(int opcode, int fd, void* buf, unsigned len, uint64_t offset, uint64_t user_data)
+    {
+        if (! UseRing) {
+            ssize_t res = (opcode == IORING_OP_READ?  pread(fd, buf, len, offset) : pwrite(fd, buf, len, offset));
+            Completions.push_back({user_data, int(res < 0? -errno : res)});
+            ++InFlight;
+            return true;
+        }
+
+        unsigned tail = *SqTail;
+        if (tail - __atomic_load_n(SqHead, __ATOMIC_ACQUIRE) == SqEntries  &&  ! Submit(0))   // full, pass entries to the kernel
+            return false;
+
+        unsigned index = tail & SqMask;
+        struct io_uring_sqe* sqe = &Sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode    = uint8_t(opcode);
+        sqe->fd        = fd;
+        sqe->addr      = uint64_t(uintptr_t(buf));
+        sqe->len       = len;
+        sqe->off       = offset;
+        sqe->user_data = user_data;
+        SqArray[index] = index;
+        __atomic_store_n(SqTail, tail + 1, __ATOMIC_RELEASE);
+        ++ToSubmit;
+        ++InFlight;
+        return true;
+    }
+
+    // Submit queued operations and wait for at least `wait` completions, return false on failure
+    bool Submit(unsigned wait)
+    {
+        if (! UseRing)
+            return true;
+        for (;;) {
+            int submitted = int(syscall(__NR_io_uring_enter, Fd, ToSubmit, wait, wait? IORING_ENTER_GETEVENTS : 0, NULL, 0));
+            if (submitted >= 0) {
+                ToSubmit -= unsigned(submitted);
+                return true;
+            }
+            if (errno != EINTR)
+                return false;
+        }
+    }
+
+    // Get the next completed operation, return false if there are none
+    bool Peek(uint64_t& user_data, int& res)
+    {
+        if (! UseRing) {
+            if (Completions.empty())
+                return false;
+            user_data = Completions.front().first;
+            res = Completions.front().second;
+            Completions.pop_front();
+            --InFlight;
+            return true;
+        }
+
+        unsigned head = *CqHead;
+        if (head == __atomic_load_n(CqTail, __ATOMIC_ACQUIRE))
+            return false;
+        const struct io_uring_cqe* cqe = &Cqes[head & CqMask];
+        user_data = cqe->user_data;
+        res = cqe->res;
+        __atomic_store_n(CqHead, head + 1, __ATOMIC_RELEASE);
+        --InFlight;
+        return true;
+    }
+
+    // Wait for completion of all queued operations, discarding their results, so their buffers can be freed.
+    // Return false on failure
+    bool Drain()
+    {
+        uint64_t user_data;
+        int res;
+        while (InFlight > 0) {
+            if (! Submit(1))
+                return false;
+            while (Peek(user_data, res)) {}
+        }
+        return true;
+    }
+
+private:
+    bool UseRing = false;
+    int Fd = -1;
+    void* SqRing = nullptr;
+    void* CqRing = nullptr;
+    struct io_uring_sqe* Sqes = nullptr;
+    size_t SqRingBytes = 0, CqRingBytes = 0, SqesBytes = 0;
+    unsigned *SqHead = nullptr, *SqTail = nullptr, *SqArray = nullptr, *CqHead = nullptr, *CqTail = nullptr;
+    unsigned SqMask = 0, CqMask = 0, SqEntries = 0, ToSubmit = 0;
+    size_t InFlight = 0;   // operations queued by Prep() and not returned by Peek() yet
+    struct io_uring_cqe* Cqes = nullptr;
+    std::deque<std::pair<uint64_t,int>> Completions;   // without io_uring
+};
+
+
+// Page-aligned buffer, as required by O_DIRECT
+class PageAlignedBuffer
+{
+public:
+    explicit PageAlignedBuffer(size_t bytes)
+    {
+        if (posix_memalign((void**) &Data, PAGE, std::max<size_t>(bytes, 1)) != 0)
+            Data = nullptr;
+    }
+    ~PageAlignedBuffer()  { free(Data); }
+    uint8_t* data()  { return Data; }
+
+    static const size_t PAGE = 4096;
+
+private:
+    uint8_t* Data = nullptr;
+};
+
+
+// Open the file with O_DIRECT if requested and possible, otherwise without it. Set `direct` to the mode used
+static int open_file(const char* filename, int flags, bool& direct)
+{
+    if (direct) {
+        int fd = open(filename, flags | O_DIRECT, 0644);
+        if (fd >= 0)
+            return fd;
+        direct = false;   // e.g. tmpfs doesn't support O_DIRECT
+    }
+    return open(filename, flags, 0644);
+}
+
+
+// Stripe in the ring of buffers
+struct PipelineSlot
+{
+    PipelineSlot(ECC_bench_params params)  : Data(params.OriginalFileBytes()), Parity(params.RecoveryDataBytes())  {}
+
+    PageAlignedBuffer Data, Parity;
+    uint64_t Stripe = 0;
+    int PendingWrites = 0;
+};
+
+
+// Operation kinds, stored in user_data of io_uring entries together with the slot index
+enum { PIPELINE_READ, PIPELINE_WRITE, PIPELINE_EVENT };
+
+
+// Read stripes from the input file, encode them on params.Threads worker threads, and write block i of each stripe
+// into the file output_prefix.i, for i in 0..data_blocks+parity_blocks-1. Up to `depth` stripes are processed at once:
+// the I/O thread (the current one) reads stripes into free slots of the ring, passes read stripes to the workers,
+// and writes encoded stripes. Workers notify it via eventfd, whose read is always pending in io_uring.
+// Print end-to-end speed (including fdatasync of output files) and compute-only speed, return false if anything failed
+bool pipeline_benchmark_main(ECC_bench_params params, const char* input_filename, const char* output_prefix,
+                             bool direct, int depth, const char* name,
+                             std::unique_ptr<StripeEncoder> (*create_stripe_encoder)(ECC_bench_params))
+{
+    int workers = std::max(params.Threads, 1);
+    depth = (depth > 0? depth : 2*workers + 2);
+
+    // Each worker has its own encoder, since encoders keep their workspace between stripes
+    std::vector<std::unique_ptr<StripeEncoder>> encoders;
+    for (int i = 0; i < workers; ++i) {
+        encoders.push_back(create_stripe_encoder(params));
+        if (! encoders.back())   // library doesn't support these params
+            return false;
+    }
+
+    int blocks = params.OriginalCount + params.RecoveryCount;
+    const size_t stripe_bytes = params.OriginalFileBytes();
+
+    // O_DIRECT requires sizes and offsets of all operations to be aligned
+    bool direct_input  = direct  &&  stripe_bytes % PageAlignedBuffer::PAGE == 0;
+    bool direct_output = direct  &&  params.BlockBytes % PageAlignedBuffer::PAGE == 0;
+
+    int input = open_file(input_filename, O_RDONLY, direct_input);
+    struct stat st;
+    if (input < 0  ||  fstat(input, &st) != 0) {
+        printf("%s pipeline: can't open %s\n", name, input_filename);
+        if (input >= 0)  close(input);
+        return false;
+    }
+    uint64_t file_bytes = st.st_size;
+    uint64_t stripes = (file_bytes + stripe_bytes - 1) / stripe_bytes;
+
+    std::vector<int> outputs(blocks, -1);
+    bool failed = false;
+    for (int i = 0; i < blocks  &&  ! failed; ++i) {
+        std::string filename = std::string(output_prefix) + "." + std::to_string(i);
+        outputs[i] = open_file(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, direct_output);
+        if (outputs[i] < 0) {
+            printf("%s pipeline: can't create %s\n", name, filename.c_str());
+            failed = true;
+        }
+    }
+    auto close_files = [&]() {
+        close(input);
+        for (int fd : outputs)
+            if (fd >= 0)  close(fd);
+    };
+    if (failed  ||  stripes == 0) {
+        if (stripes == 0)
+            printf("%s pipeline: %s is empty\n", name, input_filename);
+        close_files();
+        return false;
+    }
+
+    // Room for reads, writes and the eventfd read of all slots, so normally the ring never overflows
+    PipelineIO io;
+    int event = eventfd(0, 0);
+    bool use_ring = event >= 0  &&  io.Init(std::min(32768u, unsigned(depth * (blocks + 1) + 1)));
+    uint64_t event_value = 0;
+
+    printf("%s pipeline (%s, input%s, output%s, %d workers, %d stripes in flight):\n", name,
+        use_ring? "io_uring" : "pread/pwrite", direct_input? " O_DIRECT" : "", direct_output? " O_DIRECT" : "", workers, depth);
+
+    std::vector<std::unique_ptr<PipelineSlot>> slots;
+    std::vector<int> free_slots;
+    for (int i = 0; i < depth; ++i) {
+        slots.emplace_back(new PipelineSlot(params));
+        if (! slots.back()->Data.data()  ||  ! slots.back()->Parity.data()) {
+            printf("  can't allocate buffers\n");
+            close_files();
+            if (event >= 0)  close(event);
+            return false;
+        }
+        free_slots.push_back(depth - 1 - i);
+    }
+
+    // Stripes waiting for encoding and encoded ones, shared with the workers
+    std::mutex mutex;
+    std::condition_variable work_ready, work_done;
+    std::deque<int> to_encode, encoded;
+    bool stop = false, encode_failed = false;
+    std::vector<OperationTimer> encode_times(workers);
+    std::vector<uint64_t> idle_usec(workers, 0);
+
+    // Files should come from the disk, rather than from the page cache filled by the previous run
+    posix_fadvise(input, 0, 0, POSIX_FADV_DONTNEED);
+    uint64_t start = siamese::GetTimeUsec();
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < workers; ++w)
+        threads.emplace_back([&, w]() {
+            for (;;) {
+                int slot;
+                {
+                    uint64_t wait_start = siamese::GetTimeUsec();
+                    std::unique_lock<std::mutex> lock(mutex);
+                    work_ready.wait(lock, [&]() { return stop  ||  ! to_encode.empty(); });
+                    if (stop)
+                        return;
+                    slot = to_encode.front();
+                    to_encode.pop_front();
+                    idle_usec[w] += siamese::GetTimeUsec() - wait_start;
+                }
+
+                encode_times[w].BeginCall();
+                bool succeeded = encoders[w]->Encode(slots[slot]->Data.data(), slots[slot]->Parity.data());
+                encode_times[w].EndCall();
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    encode_failed = encode_failed  ||  ! succeeded;
+                    encoded.push_back(slot);
+                }
+                if (use_ring) {
+                    uint64_t one = 1;
+                    if (write(event, &one, sizeof(one)) != sizeof(one))
+                        work_done.notify_one();
+                } else {
+                    work_done.notify_one();
+                }
+            }
+        });
+
+    auto user_data = [](int kind, int slot)  { return (uint64_t(slot) << 8) | uint64_t(kind); };
+    uint64_t next_stripe = 0, stripes_done = 0;
+    const char* error = nullptr;
+    if (use_ring  &&  ! io.Prep(IORING_OP_READ, event, &event_value, sizeof(event_value), 0, user_data(PIPELINE_EVENT, 0)))
+        error = "io_uring submission failed";
+
+    while (! error  &&  stripes_done < stripes)
+    {
+        // Read the next stripes into free slots
+        while (! free_slots.empty()  &&  next_stripe < stripes  &&  ! error) {
+            int slot = free_slots.back();
+            free_slots.pop_back();
+            slots[slot]->Stripe = next_stripe++;
+            if (! io.Prep(IORING_OP_READ, input, slots[slot]->Data.data(), unsigned(stripe_bytes),
+                          slots[slot]->Stripe * stripe_bytes, user_data(PIPELINE_READ, slot)))
+                error = "io_uring submission failed";
+        }
+
+        // Write encoded stripes, block i into the file i
+        std::deque<int> ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.swap(encoded);
+            if (encode_failed)
+                error = "encoding failed";
+        }
+        for (int slot : ready) {
+            PipelineSlot& s = *slots[slot];
+            s.PendingWrites = blocks;
+            for (int i = 0; i < blocks  &&  ! error; ++i) {
+                uint8_t* block = (i < params.OriginalCount?  s.Data.data() + i * params.BlockBytes
+                                                          :  s.Parity.data() + (i - params.OriginalCount) * params.BlockBytes);
+                if (! io.Prep(IORING_OP_WRITE, outputs[i], block, params.BlockBytes, s.Stripe * params.BlockBytes, user_data(PIPELINE_WRITE, slot)))
+                    error = "io_uring submission failed";
+            }
+        }
+        if (error)
+            break;
+
+        // Wait for any completion: of io_uring operations including eventfd read, or of the workers without io_uring
+        uint64_t data;
+        int res;
+        if (use_ring) {
+            if (! io.Submit(1))
+                error = "io_uring_enter failed";
+        } else if (ready.empty()  &&  ! io.HasCompletions()) {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_done.wait(lock, [&]() { return ! encoded.empty(); });
+        }
+
+        while (! error  &&  io.Peek(data, res))
+        {
+            int kind = int(data & 0xFF), slot = int(data >> 8);
+            if (kind == PIPELINE_EVENT) {
+                // Encoded stripes are taken at the next iteration, so just wait for the next notification
+                if (! io.Prep(IORING_OP_READ, event, &event_value, sizeof(event_value), 0, user_data(PIPELINE_EVENT, 0)))
+                    error = "io_uring submission failed";
+            } else if (kind == PIPELINE_READ) {
+                // The last stripe is shorter, and padded with zeroes
+                PipelineSlot& s = *slots[slot];
+                uint64_t expected = std::min<uint64_t>(stripe_bytes, file_bytes - s.Stripe * stripe_bytes);
+                if (res < 0  ||  uint64_t(res) != expected) {
+                    error = "read failed";
+                    break;
+                }
+                memset(s.Data.data() + expected, 0, stripe_bytes - expected);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    to_encode.push_back(slot);
+                }
+                work_ready.notify_one();
+            } else {
+                if (res != int(params.BlockBytes)) {
+                    error = "write failed";
+                    break;
+                }
+                if (--slots[slot]->PendingWrites == 0) {
+                    free_slots.push_back(slot);
+                    ++stripes_done;
+                }
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    work_ready.notify_all();
+    for (auto& thread : threads)
+        thread.join();
+
+    // On errors, reads and writes of the slots may still be in flight, and the eventfd read is always pending,
+    // so it's completed by our own notification, and all operations are waited for before the buffers are freed
+    if (use_ring) {
+        uint64_t one = 1;
+        if (write(event, &one, sizeof(one)) != sizeof(one)  ||  ! io.Drain()) {
+            if (! error)
+                error = "can't wait for pending I/O";
+            for (auto& slot : slots)   // the kernel may still access them
+                slot.release();
+        }
+    } else {
+        io.Drain();
+    }
+
+    // Written data are a part of the job
+    uint64_t sync_start = siamese::GetTimeUsec();
+    for (int fd : outputs)
+        if (! error  &&  fdatasync(fd) != 0)
+            error = "fdatasync failed";
+    uint64_t end = siamese::GetTimeUsec();
+    for (int fd : outputs)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close_files();
+    if (event >= 0)
+        close(event);
+
+    if (error) {
+        printf("  %s\n", error);
+        return false;
+    }
+
+    // Compute-only speed: encoding time of all workers, as if they were never waiting for I/O
+    OperationTimer encode_time;
+    uint64_t idle = 0;
+    for (int w = 0; w < workers; ++w) {
+        encode_time.Merge(encode_times[w]);
+        idle += idle_usec[w];
+    }
+    uint64_t encode_usec = encode_time.TotalUsec, encode_calls = encode_time.Invocations;
+    encode_time.Print("pipeline encode", stripe_bytes);
+    double compute_speed = encode_usec? double(stripe_bytes) * encode_calls / encode_usec * workers : 0;
+    write_to_logfile("pipeline compute", int(encode_calls), encode_calls? double(encode_usec) / encode_calls : 0, compute_speed);
+
+    double end_to_end_speed = file_bytes / double(end - start);
+    printf("  pipeline sustained: %.3lf GB in %.3lf sec (fdatasync %.3lf sec), %.3lf GB/s end-to-end vs %.3lf GB/s compute-only, "
+           "workers idle %.0lf%%\n",
+        file_bytes / 1e9, (end - start) / 1e6, (end - sync_start) / 1e6, end_to_end_speed / 1e3, compute_speed / 1e3,
+        100.0 * idle / (double(end - start) * workers));
+    write_to_logfile("pipeline sustained", int(stripes), double(end - start) / stripes, end_to_end_speed);
+
+    return true;
+}
+
+#else
+
+bool pipeline_benchmark_main(ECC_bench_params params, const char* input_filename, const char* output_prefix,
+                             bool direct, int depth, const char* name,
+                             std::unique_ptr<StripeEncoder> (*create_stripe_encoder)(ECC_bench_params))
+{
+    printf("%s pipeline: supported on Linux only\n", name);
+    return false;
+}
+
+#endif
@@ -0,0 +1,190 @@
+//
+// Streaming receiver benchmark: blocks of the codeword arrive one at a time, in random order and with random losses,
+// and the codec processes each block as soon as it arrives, as a network receiver does
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include "common.h"
+
+
+void StripeCodec::BeginReceive(ECC_bench_params params, uint8_t* original, uint8_t* recovery)
+{
+    ReceiveParams   = params;
+    ReceiveOriginal = original;
+    ReceiveRecovery = recovery;
+    NotReceived.assign(params.OriginalCount + params.RecoveryCount, 1);
+    ReceivedCount = 0;
+}
+
+void StripeCodec::StoreReceived(int id, const uint8_t* block)
+{
+    uint8_t* place = (id < ReceiveParams.OriginalCount?  ReceiveOriginal + id * ReceiveParams.BlockBytes
+                                                      :  ReceiveRecovery + (id - ReceiveParams.OriginalCount) * ReceiveParams.BlockBytes);
+    memcpy(place, block, ReceiveParams.BlockBytes);
+    NotReceived[id] = 0;
+    ++ReceivedCount;
+}
+
+// Block codes can't do anything until OriginalCount blocks have arrived
+StripeCodec::ReceiveResult StripeCodec::Receive(int id, const uint8_t* block)
+{
+    StoreReceived(id, block);
+    if (ReceivedCount < ReceiveParams.OriginalCount)
+        return RECEIVE_NEED_MORE;
+
+    // No need to decode if all original blocks have arrived
+    if (std::find(NotReceived.begin(), NotReceived.begin() + ReceiveParams.OriginalCount, 1) == NotReceived.begin() + ReceiveParams.OriginalCount)
+        return RECEIVE_DONE;
+    return Decode(ReceiveOriginal, ReceiveRecovery, NotReceived)?  RECEIVE_DONE : RECEIVE_FAILED;
+}
+
+
+// Current time in nanoseconds: the work per received block may be well below a microsecond
+static uint64_t get_time_nsec()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// Print distribution of times in nanoseconds as percentiles and power-of-2 histogram, and save it to logfile
+static void print_latency(const char* operation, std::vector<uint64_t>& nsec, uint64_t bytes_processed_per_call)
+{
+    if (nsec.empty()) {
+        printf("  %s: no calls\n", operation);
+        return;
+    }
+
+    // Statistics of OperationTimer, computed from nanosecond samples and scaled to microseconds
+    OperationTimer timer(0);
+    timer.Samples = nsec;
+    TimingStats stats = timer.Stats();
+    for (double* value : {&stats.MinUsec, &stats.MedianUsec, &stats.P90Usec, &stats.P99Usec, &stats.MeanUsec, &stats.StddevUsec})
+        *value /= 1e3;
+    stats.MegabytesPerSecondAtMedian = bytes_processed_per_call / stats.MedianUsec;
+
+    printf("  %s: %.3lf usec, %.0lf MB/s (min %.3lf, p90 %.3lf, p99 %.3lf, mean %.3lf, stddev %.3lf usec%s)\n",
+        operation, stats.MedianUsec, stats.MegabytesPerSecondAtMedian,
+        stats.MinUsec, stats.P90Usec, stats.P99Usec, stats.MeanUsec, stats.StddevUsec, OperationTimer::OutliersNote(stats).c_str());
+    write_to_logfile(operation, int(nsec.size()), stats.MeanUsec, bytes_processed_per_call / stats.MeanUsec, &stats);
+
+    std::sort(nsec.begin(), nsec.end());
+    // Histogram with buckets [2^i, 2^(i+1)) nanoseconds, skipping empty ones
+    printf("    histogram:");
+    for (size_t i = 0; i < nsec.size(); )
+    {
+        int bucket = 0;
+        while ((uint64_t(2) << bucket) <= nsec[i])
+            ++bucket;
+        size_t count = 0;
+        for (; i < nsec.size()  &&  nsec[i] < (uint64_t(2) << bucket); ++i)
+            ++count;
+        uint64_t limit = uint64_t(2) << bucket;
+        if (bucket < 10)
+            printf(" <%dns %.1lf%%", int(limit), 100.0 * count / nsec.size());
+        else
+            printf(" <%.0lfus %.1lf%%", limit / 1e3, 100.0 * count / nsec.size());
+    }
+    printf("\n");
+}
+
+
+// Receive the codeword block by block in random order, losing each block with probability `loss`.
+// Every trial sends all blocks until the codec recovers the data. The time of each Receive() call is measured separately:
+// calls that just accept a block are reported as `receive block`, and the call that completes the stripe
+// as `receive recover`, i.e. time to recover after the arrival of the last required block
+bool receiver_benchmark_main(ECC_bench_params params, uint8_t* buffer, double loss, const char* name, StripeCodec* codec)
+{
+    if (! codec) {   // library doesn't support these params or can't decode stripes
+        printf("%s receiver: skipped\n", name);
+        return false;
+    }
+
+    printf("%s receiver (%.0lf%% loss):\n", name, loss * 100);
+
+    // Blocks "on the wire", and receive buffers of the stripe
+    int total = params.OriginalCount + params.RecoveryCount;
+    uint8_t* sent_original = buffer;
+    AlignedBuffer sent_recovery(params.RecoveryDataBytes());
+    AlignedBuffer original(params.OriginalFileBytes()), recovery(params.RecoveryDataBytes());
+
+    if (! codec->Encode(sent_original, sent_recovery.data())) {
+        printf("  encoding failed\n");
+        return false;
+    }
+
+    std::mt19937 rng(1);   // the same arrival sequence for all libraries
+    std::bernoulli_distribution lost(loss);
+    std::vector<int> order(total);
+    std::vector<char> dropped(total);
+    std::vector<uint64_t> block_nsec, recover_nsec, stripe_nsec;
+    int unrecoverable = 0;
+    uint64_t blocks_used = 0;
+
+    for (TrialLoop trial(params); trial.Next(); )
+    {
+        for (int i = 0; i < total; ++i)
+            order[i] = i;
+        std::shuffle(order.begin(), order.end(), rng);
+        // Losses of all blocks are drawn upfront, so the RNG advances the same way whenever a library stops receiving
+        for (int i = 0; i < total; ++i)
+            dropped[i] = lost(rng);
+
+        // Leftovers of the previous trial shouldn't help
+        memset(original.data(), 0xEE, params.OriginalFileBytes());
+        memset(recovery.data(), 0xEE, params.RecoveryDataBytes());
+
+        uint64_t stripe_start = get_time_nsec();
+        codec->BeginReceive(params, original.data(), recovery.data());
+
+        StripeCodec::ReceiveResult result = StripeCodec::RECEIVE_NEED_MORE;
+        int arrived = 0;
+        for (int i = 0; i < total  &&  result == StripeCodec::RECEIVE_NEED_MORE; ++i)
+        {
+            int id = order[i];
+            if (dropped[i])
+                continue;
+            const uint8_t* block = (id < params.OriginalCount?  sent_original + id * params.BlockBytes
+                                                             :  sent_recovery.data() + (id - params.OriginalCount) * params.BlockBytes);
+            ++arrived;
+
+            uint64_t start = get_time_nsec();
+            result = codec->Receive(id, block);
+            uint64_t nsec = get_time_nsec() - start;
+
+            if (result == StripeCodec::RECEIVE_NEED_MORE)
+                block_nsec.push_back(nsec);
+            else if (result == StripeCodec::RECEIVE_DONE)
+                recover_nsec.push_back(nsec);
+        }
+        uint64_t stripe_end = get_time_nsec();
+
+        if (result == StripeCodec::RECEIVE_FAILED) {   // a codec error, rather than a loss statistic
+            printf("  receiver failed to recover the stripe after %d blocks (trial %d)\n", arrived, trial.Trial);
+            return false;
+        }
+        if (result == StripeCodec::RECEIVE_NEED_MORE) {   // too many blocks lost
+            ++unrecoverable;
+            continue;
+        }
+        stripe_nsec.push_back(stripe_end - stripe_start);
+        blocks_used += arrived;
+
+        if (memcmp(original.data(), sent_original, params.OriginalFileBytes())) {
+            printf("  receiver recovered wrong data (trial %d)\n", trial.Trial);
+            return false;
+        }
+    }
+
+    print_latency("receive block", block_nsec, params.BlockBytes);
+    print_latency("receive recover", recover_nsec, params.OriginalFileBytes());
+    print_latency("receive stripe", stripe_nsec, params.OriginalFileBytes());
+    printf("  %.2lf blocks received per stripe, %d unrecoverable stripes\n",
+        stripe_nsec.empty()? 0 : double(blocks_used) / stripe_nsec.size(), unrecoverable);
+    return true;
+}
@@ -0,0 +1,338 @@
+//
+// Streaming benchmarks: encode a file of any size stripe by stripe, either reading it
+// into a fixed small working set, or mapping input and output files into memory
+//
+
+#include <cstdio>
+#include <cstring>
+
+#include "common.h"
+
+#ifdef _WIN32
+#define PSAPI_VERSION 2   /* use K32GetProcessMemoryInfo from kernel32.dll */
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+// Reset peak RSS of the process to its current RSS, if supported by OS
+static void reset_peak_rss()
+{
+#ifdef __linux__
+    FILE* clear_refs = fopen("/proc/self/clear_refs", "w");
+    if (clear_refs) {
+        fputs("5", clear_refs);   // reset VmHWM, available since Linux 4.0
+        fclose(clear_refs);
+    }
+#endif
+}
+
+
+// Peak RSS of the process in bytes, or 0 if unknown
+static uint64_t peak_rss()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+    return 0;
+#else
+#  ifdef __linux__
+    // VmHWM takes into account reset_peak_rss(), unlike getrusage()
+    FILE* status = fopen("/proc/self/status", "r");
+    if (status) {
+        char line[256];
+        unsigned long long kbytes = 0;
+        while (fgets(line, sizeof(line), status))
+            if (sscanf(line, "VmHWM: %llu kB", &kbytes) == 1)
+                break;
+        fclose(status);
+        if (kbytes)
+            return kbytes * 1024;
+    }
+#  endif
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return uint64_t(usage.ru_maxrss) * 1024;   // kilobytes on Linux
+    return 0;
+#endif
+}
+
+
+// Number of page faults in the process so far
+static uint64_t page_faults()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PageFaultCount;
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return uint64_t(usage.ru_minflt) + usage.ru_majflt;
+    return 0;
+#endif
+}
+
+
+// Encode the file stripe by stripe and print sustained speed and peak memory usage, return false if anything failed.
+// Only the current stripe and its recovery blocks are kept in memory, and recovery blocks are discarded
+bool stream_benchmark_main(ECC_bench_params params, const char* filename, const char* name, StripeEncoder* encoder)
+{
+    if (! encoder)   // library doesn't support these params
+        return false;
+
+    printf("%s streaming:\n", name);
+
+    FILE* file = fopen(filename, "rb");
+    if (! file) {
+        printf("  can't open %s\n", filename);
+        return false;
+    }
+
+    AlignedBuffer stripe(params.OriginalFileBytes()), recovery(params.RecoveryDataBytes());
+    reset_peak_rss();
+
+    OperationTimer encode_time;
+    uint64_t file_bytes = 0, stripes = 0;
+    uint64_t start = siamese::GetTimeUsec();
+
+    for (;;)
+    {
+        size_t bytes = fread(stripe.data(), 1, params.OriginalFileBytes(), file);
+        if (bytes == 0)
+            break;
+        // The last stripe is padded with zeroes
+        memset(stripe.data() + bytes, 0, params.OriginalFileBytes() - bytes);
+        file_bytes += bytes;
+        ++stripes;
+
+        encode_time.BeginCall();
+        bool succeeded = encoder->Encode(stripe.data(), recovery.data());
+        encode_time.EndCall();
+
+        if (! succeeded) {
+            printf("  encoding of stripe %d failed\n", int(stripes-1));
+            fclose(file);
+            return false;
+        }
+    }
+
+    uint64_t total_usec = siamese::GetTimeUsec() - start;
+    fclose(file);
+
+    if (stripes == 0) {
+        printf("  %s is empty\n", filename);
+        return false;
+    }
+
+    // Encoding speed alone, and sustained speed including file reading
+    encode_time.Print("stream encode", params.OriginalFileBytes());
+
+    double megabytes_per_second = file_bytes / double(total_usec);
+    printf("  stream sustained: %.3lf GB in %.3lf sec, %.0lf MB/s, peak RSS %.1lf MB\n",
+        file_bytes / 1e9, total_usec / 1e6, megabytes_per_second, peak_rss() / 1e6);
+    write_to_logfile("stream sustained", int(stripes), double(total_usec) / stripes, megabytes_per_second);
+
+    return true;
+}
+
+
+// File mapped into memory
+class MappedFile
+{
+public:
+    ~MappedFile()  { Close(); }
+
+    // Map existing file for reading, return false on failure
+    bool OpenForReading(const char* filename)
+    {
+#ifdef _WIN32
+        File = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        LARGE_INTEGER size;
+        if (File == INVALID_HANDLE_VALUE  ||  ! GetFileSizeEx(File, &size))
+            return false;
+        Size = size.QuadPart;
+        return Size == 0  ||  Map(PAGE_READONLY, FILE_MAP_READ);
+#else
+        Fd = open(filename, O_RDONLY);
+        struct stat st;
+        if (Fd < 0  ||  fstat(Fd, &st) != 0)
+            return false;
+        Size = st.st_size;
+        return Size == 0  ||  Map(PROT_READ);
+#endif
+    }
+
+    // Create (or truncate) file of the given size and map it for writing, return false on failure
+    bool CreateForWriting(const char* filename, uint64_t size)
+    {
+        Size = size;
+#ifdef _WIN32
+        File = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (File == INVALID_HANDLE_VALUE)
+            return false;
+        return Size == 0  ||  Map(PAGE_READWRITE, FILE_MAP_WRITE);   // mapping extends the file to its size
+#else
+        Fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (Fd < 0  ||  ftruncate(Fd, Size) != 0)
+            return false;
+        return Size == 0  ||  Map(PROT_READ | PROT_WRITE);
+#endif
+    }
+
+    // Write modified pages to the disk, return false on failure
+    bool Flush()
+    {
+        if (! Data)
+            return true;
+#ifdef _WIN32
+        return FlushViewOfFile(Data, 0)  &&  FlushFileBuffers(File);
+#else
+        return msync(Data, Size, MS_SYNC) == 0;
+#endif
+    }
+
+    // Ask OS to evict file contents from the page cache, so the next run starts from the disk
+    void DropCache()
+    {
+#if defined(__linux__)
+        if (Fd >= 0)
+            posix_fadvise(Fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    }
+
+    void Close()
+    {
+#ifdef _WIN32
+        if (Data)  UnmapViewOfFile(Data);
+        if (Mapping)  CloseHandle(Mapping);
+        if (File != INVALID_HANDLE_VALUE)  CloseHandle(File);
+        Mapping = NULL;
+        File = INVALID_HANDLE_VALUE;
+#else
+        if (Data)  munmap(Data, Size);
+        if (Fd >= 0)  close(Fd);
+        Fd = -1;
+#endif
+        Data = nullptr;
+    }
+
+    uint8_t* Data = nullptr;
+    uint64_t Size = 0;
+
+private:
+#ifdef _WIN32
+    bool Map(DWORD protection, DWORD access)
+    {
+        Mapping = CreateFileMappingA(File, NULL, protection, DWORD(Size >> 32), DWORD(Size), NULL);
+        if (! Mapping)
+            return false;
+        Data = (uint8_t*) MapViewOfFile(Mapping, access, 0, 0, 0);
+        return Data != nullptr;
+    }
+
+    HANDLE File = INVALID_HANDLE_VALUE;
+    HANDLE Mapping = NULL;
+#else
+    bool Map(int protection)
+    {
+        void* data = mmap(NULL, Size, protection, MAP_SHARED, Fd, 0);
+        if (data == MAP_FAILED)
+            return false;
+        Data = (uint8_t*) data;
+        return true;
+    }
+
+    int Fd = -1;
+#endif
+};
+
+
+// Encode the input file mapped into memory, writing recovery blocks directly into the mapped output file.
+// Print sustained speed including page faults and writeback, return false if anything failed.
+// Blocks are passed to the library as pointers into the mapped files, without any memcpy,
+// except for the last incomplete stripe that is padded with zeroes in a separate buffer
+bool mmap_benchmark_main(ECC_bench_params params, const char* input_filename, const char* output_filename,
+                         const char* name, StripeEncoder* encoder)
+{
+    if (! encoder)   // library doesn't support these params
+        return false;
+
+    printf("%s mmap:\n", name);
+
+    MappedFile input, output;
+    if (! input.OpenForReading(input_filename)) {
+        printf("  can't map %s\n", input_filename);
+        return false;
+    }
+    if (input.Size == 0) {
+        printf("  %s is empty\n", input_filename);
+        return false;
+    }
+
+    uint64_t stripes = (input.Size + params.OriginalFileBytes() - 1) / params.OriginalFileBytes();
+    if (! output.CreateForWriting(output_filename, stripes * params.RecoveryDataBytes())) {
+        printf("  can't map %s\n", output_filename);
+        return false;
+    }
+
+    // Both files should come from the disk, rather than from the page cache filled by the previous run
+    input.DropCache();
+
+    OperationTimer encode_time;
+    uint64_t start_faults = page_faults();
+    uint64_t start = siamese::GetTimeUsec();
+
+    for (uint64_t stripe = 0; stripe < stripes; ++stripe)
+    {
+        uint8_t* original = input.Data + stripe * params.OriginalFileBytes();
+        uint8_t* recovery = output.Data + stripe * params.RecoveryDataBytes();
+
+        // The last stripe is padded with zeroes, since we can't access memory beyond the end of the file
+        std::unique_ptr<AlignedBuffer> last_stripe;
+        uint64_t bytes_left = input.Size - stripe * params.OriginalFileBytes();
+        if (bytes_left < params.OriginalFileBytes()) {
+            last_stripe.reset(new AlignedBuffer(params.OriginalFileBytes()));
+            memset(last_stripe->data(), 0, params.OriginalFileBytes());
+            memcpy(last_stripe->data(), original, bytes_left);
+            original = last_stripe->data();
+        }
+
+        encode_time.BeginCall();
+        bool succeeded = encoder->Encode(original, recovery);
+        encode_time.EndCall();
+
+        if (! succeeded) {
+            printf("  encoding of stripe %d failed\n", int(stripe));
+            return false;
+        }
+    }
+
+    // Writeback of recovery data is a part of the job
+    uint64_t writeback_start = siamese::GetTimeUsec();
+    if (! output.Flush()) {
+        printf("  can't write %s\n", output_filename);
+        return false;
+    }
+    uint64_t end = siamese::GetTimeUsec();
+    uint64_t faults = page_faults() - start_faults;
+    output.DropCache();
+
+    // Encoding speed including page faults, and sustained speed including writeback
+    encode_time.Print("mmap encode", params.OriginalFileBytes());
+
+    double megabytes_per_second = input.Size / double(end - start);
+    printf("  mmap sustained: %.3lf GB in %.3lf sec (writeback %.3lf sec), %.0lf MB/s, %.0lf page faults per stripe\n",
+        input.Size / 1e9, (end - start) / 1e6, (end - writeback_start) / 1e6, megabytes_per_second, double(faults) / stripes);
+    write_to_logfile("mmap sustained", int(stripes), double(end - start) / stripes, megabytes_per_second);
+
+    return true;
+}
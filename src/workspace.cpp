@@ -0,0 +1,183 @@
+//
+// Allocation of the shared workspace: 4 KB pages, transparent or preallocated huge pages,
+// and placement of the workspace of each thread on the NUMA node of its core
+//
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <string>
+
+#include "common.h"
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+#endif
+
+
+// Round x up to a multiple of alignment
+static size_t round_up(size_t x, size_t alignment)  { return (x + alignment - 1) / alignment * alignment; }
+
+
+const char* page_names[PAGES_COUNT] = {"default", "4k", "thp", "2m", "1g"};
+const char* placement_names[PLACEMENT_COUNT] = {"default", "first-touch", "bind"};
+
+
+size_t Workspace::PageBytes(int pages)
+{
+    switch (pages) {
+        case PAGES_THP:
+        case PAGES_2M:  return size_t(2) << 20;
+        case PAGES_1G:  return size_t(1) << 30;
+        default:        return 4096;
+    }
+}
+
+
+Workspace::~Workspace()
+{
+#ifdef __linux__
+    if (Mapping)
+        munmap(Mapping, MappingBytes);
+#else
+    delete[] Mapping;
+#endif
+}
+
+
+#ifdef __linux__
+// NUMA node of the CPU core running the current thread
+static int current_numa_node()
+{
+    unsigned cpu = 0, node = 0;
+    if (syscall(__NR_getcpu, &cpu, &node, nullptr) != 0)
+        return -1;
+    return int(node);
+}
+
+// Bind the memory area to the NUMA node, moving pages that are already there
+static bool bind_to_numa_node(void* data, size_t bytes, int node)
+{
+    static const int MAX_NODES = 1024;
+    unsigned long nodemask[MAX_NODES / (8 * sizeof(unsigned long))] = {};
+    if (node < 0  ||  node >= MAX_NODES)
+        return false;
+    nodemask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    return syscall(__NR_mbind, data, bytes, MPOL_BIND, nodemask, MAX_NODES + 1, MPOL_MF_MOVE) == 0;
+}
+#endif
+
+
+bool Workspace::Allocate(size_t bytes, int threads, int pages, int placement, std::function<void(int,uint8_t*)> init)
+{
+    size_t page = PageBytes(pages);
+    size_t total = round_up(bytes * threads, page);
+    Bytes = total;
+    Nodes.assign(threads, -1);
+
+#ifdef __linux__
+    if (pages == PAGES_2M  ||  pages == PAGES_1G) {
+        // Preallocated huge pages, e.g. by `echo 256 > /sys/kernel/mm/hugepages/hugepages-2048kB/nr_hugepages`
+        int size_flag = (pages == PAGES_2M? MAP_HUGE_2MB : MAP_HUGE_1GB);
+        void* mapping = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | size_flag, -1, 0);
+        if (mapping == MAP_FAILED) {
+            printf("%s pages: skipped, %lu MB of huge pages aren't available (see /sys/kernel/mm/hugepages)\n",
+                page_names[pages], (unsigned long)(total >> 20));
+            return false;
+        }
+        Mapping = Data = (uint8_t*) mapping;
+        MappingBytes = total;
+    } else {
+        // Transparent huge pages need 2 MB aligned areas, so the mapping is extended and aligned
+        MappingBytes = total + (pages == PAGES_THP? page : 0);
+        void* mapping = mmap(NULL, MappingBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) {
+            printf("%s pages: skipped, can't allocate %lu MB\n", page_names[pages], (unsigned long)(total >> 20));
+            return false;
+        }
+        Mapping = (uint8_t*) mapping;
+        Data = (uint8_t*) round_up(uintptr_t(Mapping), page);
+        if (pages == PAGES_THP  &&  madvise(Data, total, MADV_HUGEPAGE) != 0)
+            printf("%s pages: madvise(MADV_HUGEPAGE) failed, transparent huge pages are disabled\n", page_names[pages]);
+        if (pages == PAGES_4K)
+            madvise(Data, total, MADV_NOHUGEPAGE);
+    }
+#else
+    if (pages != PAGES_DEFAULT) {
+        printf("%s pages: skipped, supported on Linux only\n", page_names[pages]);
+        return false;
+    }
+    Mapping = new uint8_t[total + page];
+    Data = (uint8_t*) round_up(uintptr_t(Mapping), page);
+#endif
+
+    // Pages are allocated on the NUMA node of the core that touches them first,
+    // so the workspace of each thread is filled on the core where run_on_threads() runs that thread
+    int bind_error = 0;
+    for (int thread = 0; thread < threads; ++thread)
+    {
+        uint8_t* workspace = Data + thread * bytes;
+        auto place = [&]() {
+#ifdef __linux__
+            Nodes[thread] = current_numa_node();
+            if (placement == PLACEMENT_BIND  &&  ! bind_to_numa_node(workspace, bytes, Nodes[thread]))
+                bind_error = errno;
+#endif
+            // Fault in all pages, so benchmarks don't pay for page faults and zeroing of huge pages
+            memset(workspace, 0, bytes);
+            init(thread, workspace);
+        };
+
+        if (placement == PLACEMENT_DEFAULT)
+            place();
+        else
+            std::thread([&]() {
+                pin_thread_to_core(thread);
+                place();
+            }).join();
+    }
+    if (bind_error)
+        printf("numa: mbind failed (%s), pages are placed by first touch only\n", strerror(bind_error));
+    return true;
+}
+
+
+size_t Workspace::HugePageBytes()
+{
+    size_t huge = 0;
+#ifdef __linux__
+    // Sum huge pages of all mappings overlapping the workspace: transparent ones are AnonHugePages,
+    // and preallocated ones are Private_Hugetlb
+    FILE* f = fopen("/proc/self/smaps", "r");
+    if (! Data  ||  ! f) {
+        if (f)  fclose(f);
+        return 0;
+    }
+    char line[256];
+    bool ours = false;
+    while (fgets(line, sizeof(line), f))
+    {
+        unsigned long start, end, kb;
+        char perms;
+        if (sscanf(line, "%lx-%lx %c", &start, &end, &perms) == 3)   // header of the next mapping
+            ours = start < uintptr_t(Data) + Bytes  &&  end > uintptr_t(Data);
+        else if (ours  &&  (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1  ||  sscanf(line, "Private_Hugetlb: %lu kB", &kb) == 1))
+            huge += size_t(kb) << 10;
+    }
+    fclose(f);
+#endif
+    return std::min(huge, Bytes);
+}